@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "decoder.h"
+
+/**
+ * @file bench_batch.c
+ * @brief Compares the batch I/O backends on many small payload files.
+ *
+ * Usage: bench_batch [files] [queue_depth]. Run from the bench build
+ * directory. Every backend writes into a fresh output directory, so all of
+ * them pay for creating the JSON files.
+ */
+
+/**
+ * @brief Reads a file into a dynamically allocated buffer.
+ */
+static uint8_t *ReadFile(const char *filename, size_t *size) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    fprintf(stderr, "Error: cannot open %s\n", filename);
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  if (sz < 0) {
+    fclose(f);
+    return NULL;
+  }
+  *size = (size_t)sz;
+  uint8_t *buf = malloc(*size);
+  if (buf && fread(buf, 1, *size, f) != *size) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  return buf;
+}
+
+/**
+ * @brief Creates `count` paths of the form `dir/prefix<i>.ext`.
+ */
+static char **MakePaths(const char *dir, const char *prefix, const char *ext,
+                        size_t count) {
+  char **paths = calloc(count, sizeof(*paths));
+  for (size_t i = 0; paths && i < count; ++i) {
+    paths[i] = malloc(strlen(dir) + 64);
+    if (paths[i]) sprintf(paths[i], "%s/%s%zu.%s", dir, prefix, i, ext);
+  }
+  return paths;
+}
+
+static void FreePaths(char **paths, size_t count, bool remove) {
+  for (size_t i = 0; i < count; ++i) {
+    if (remove) unlink(paths[i]);
+    free(paths[i]);
+  }
+  free(paths);
+}
+
+/**
+ * @brief Main function of the batch I/O benchmark.
+ */
+int main(int argc, char **argv) {
+  size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20000;
+  size_t depth = (argc > 2) ? strtoul(argv[2], NULL, 10)
+                            : BEJ_BATCH_DEFAULT_QUEUE_DEPTH;
+  size_t dict_size, payload_size;
+  uint8_t *dict = ReadFile("dummy_dictionaries/Memory_v1.bin", &dict_size);
+  uint8_t *payload = ReadFile("dummy_data/memory_bej.bin", &payload_size);
+  BejDecoder *decoder = dict ? BejDecoderCreate(dict, dict_size) : NULL;
+  char input_dir[] = "/tmp/bej_bench_in_XXXXXX";
+  if (!decoder || !payload || count == 0 || !mkdtemp(input_dir)) return 1;
+
+  char **inputs = MakePaths(input_dir, "payload", "bin", count);
+  for (size_t i = 0; i < count; ++i) {
+    FILE *f = fopen(inputs[i], "wb");
+    if (!f) return 1;
+    fwrite(payload, 1, payload_size, f);
+    fclose(f);
+  }
+
+  printf("%zu files, queue depth %zu, io_uring %s\n", count, depth,
+         BejBatchUringAvailable() ? "available" : "unavailable");
+  const BejBatchBackend backends[] = {BEJ_BATCH_SYNC, BEJ_BATCH_PREAD,
+                                      BEJ_BATCH_URING};
+  bool ok = true;
+  for (size_t b = 0; b < 3; ++b) {
+    char output_dir[] = "/tmp/bej_bench_out_XXXXXX";
+    if (!mkdtemp(output_dir)) return 1;
+    char **outputs = MakePaths(output_dir, "payload", "json", count);
+    sync();
+
+    BejBatchOptions options = {backends[b], depth};
+    BejBatchStats stats;
+    ok = BejBatchDecodeFiles(decoder, inputs, outputs, count, &options,
+                             &stats) &&
+         ok;
+    printf("%-9s %10.0f files/s %8.3f s (%zu failed)\n",
+           BejBatchBackendName(stats.backend),
+           (double)stats.files / stats.seconds, stats.seconds, stats.failed);
+
+    FreePaths(outputs, count, true);
+    rmdir(output_dir);
+  }
+
+  FreePaths(inputs, count, true);
+  rmdir(input_dir);
+  BejDecoderDestroy(decoder);
+  free(dict);
+  free(payload);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bej_decode_memory.h"
+#include "bej_decode_message.h"
+#include "decoder.h"
+#include "stream_utils.h"
+
+/**
+ * @file bench_codegen.c
+ * @brief Compares the throughput of generated decoders with BejDecode() and
+ * a reusable BejDecoder.
+ *
+ * Usage: bench_codegen [iterations]. Run from the bench build directory so
+ * the dummy dictionaries and payloads are found.
+ */
+
+typedef bool (*GeneratedDecodeFn)(OutputStream *out, InputStream *bej_input);
+
+static OutputStream output;
+
+/**
+ * @brief Reads a file into a dynamically allocated buffer.
+ */
+static uint8_t *ReadFile(const char *filename, size_t *size) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    fprintf(stderr, "Error: cannot open %s\n", filename);
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  if (sz < 0) {
+    fclose(f);
+    return NULL;
+  }
+  *size = (size_t)sz;
+  uint8_t *buf = malloc(*size);
+  if (buf && fread(buf, 1, *size, f) != *size) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  return buf;
+}
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ */
+static double NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Prints one result line.
+ */
+static void Report(const char *name, const char *path, long iterations,
+                   double elapsed_ns, size_t input_size, size_t output_size) {
+  double per_op = elapsed_ns / (double)iterations;
+  double seconds = elapsed_ns / 1e9;
+  printf("%-8s %-9s %10.1f ns/op %9.1f MB/s in %9.1f MB/s out\n", name, path,
+         per_op, (double)input_size * iterations / seconds / 1e6,
+         (double)output_size * iterations / seconds / 1e6);
+}
+
+/**
+ * @brief Benchmarks the generic and the generated decoder on one payload.
+ */
+static bool BenchSchema(const char *name, const char *dict_path,
+                        const char *payload_path, GeneratedDecodeFn generated,
+                        long iterations) {
+  size_t dict_size, payload_size;
+  uint8_t *dict = ReadFile(dict_path, &dict_size);
+  uint8_t *payload = ReadFile(payload_path, &payload_size);
+  if (!dict || !payload) {
+    free(dict);
+    free(payload);
+    return false;
+  }
+
+  InputStream dict_is = {dict, dict_size, 0};
+  bool ok = true;
+
+  double start = NowNs();
+  for (long i = 0; i < iterations && ok; ++i) {
+    InputStream payload_is = {payload, payload_size, 0};
+    dict_is.pos = 0;
+    OutputStreamInit(&output);
+    ok = BejDecode(&output, &payload_is, &dict_is);
+  }
+  Report(name, "generic", iterations, NowNs() - start, payload_size,
+         output.pos);
+
+  BejDecoder *decoder = BejDecoderCreate(dict, dict_size);
+  const char *json = NULL;
+  size_t json_size = 0;
+  ok = ok && decoder;
+  start = NowNs();
+  for (long i = 0; i < iterations && ok; ++i) {
+    ok = BejDecoderDecode(decoder, payload, payload_size, &json, &json_size);
+  }
+  Report(name, "context", iterations, NowNs() - start, payload_size,
+         json_size);
+  BejDecoderDestroy(decoder);
+
+  start = NowNs();
+  for (long i = 0; i < iterations && ok; ++i) {
+    InputStream payload_is = {payload, payload_size, 0};
+    OutputStreamInit(&output);
+    ok = generated(&output, &payload_is);
+  }
+  Report(name, "generated", iterations, NowNs() - start, payload_size,
+         output.pos);
+
+  free(dict);
+  free(payload);
+  return ok;
+}
+
+/**
+ * @brief Main function of the codegen benchmark.
+ */
+int main(int argc, char **argv) {
+  long iterations = (argc > 1) ? strtol(argv[1], NULL, 10) : 200000;
+  if (iterations <= 0) {
+    fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  bool ok = BenchSchema("Memory", "dummy_dictionaries/Memory_v1.bin",
+                        "dummy_data/memory_bej.bin", BejDecodeMemory,
+                        iterations);
+  ok = BenchSchema("Message", "dummy_dictionaries/Message_v1.bin",
+                   "dummy_data/message_bej.bin", BejDecodeMessage,
+                   iterations) &&
+       ok;
+  return ok ? 0 : 1;
+}
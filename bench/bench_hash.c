@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "decoder.h"
+#include "hash.h"
+#include "stream_utils.h"
+
+/**
+ * @file bench_hash.c
+ * @brief Measures BejHash() against decoding and against plain memory
+ * bandwidth.
+ *
+ * Usage: bench_hash [iterations]. Run from the bench build directory so the
+ * dummy dictionaries and payloads are found. The first line hashes the
+ * memory payload (many small tuples) and decodes it for comparison; the
+ * second hashes a 16 MiB payload of long strings and compares with memcpy
+ * of the same size.
+ */
+
+#define BENCH_STRINGS 64
+#define BENCH_STRING_SIZE (256 * 1024)
+
+/**
+ * @brief Reads a file into a dynamically allocated buffer.
+ */
+static uint8_t *ReadFile(const char *filename, size_t *size) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    fprintf(stderr, "Error: cannot open %s\n", filename);
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  if (sz < 0) {
+    fclose(f);
+    return NULL;
+  }
+  *size = (size_t)sz;
+  uint8_t *buf = malloc(*size);
+  if (buf && fread(buf, 1, *size, f) != *size) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  return buf;
+}
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ */
+static double NowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Appends an NNInt with a fixed width of `width` bytes.
+ */
+static size_t PutNNInt(uint8_t *buf, uint64_t value, size_t width) {
+  buf[0] = (uint8_t)width;
+  for (size_t i = 0; i < width; ++i) {
+    buf[1 + i] = (uint8_t)(value >> (8 * i));
+  }
+  return width + 1;
+}
+
+/**
+ * @brief Builds a payload whose root holds an array of long strings.
+ */
+static uint8_t *BuildStringPayload(size_t *size) {
+  size_t element = 2 + 1 + 5 + BENCH_STRING_SIZE;
+  size_t array_value = 5 + BENCH_STRINGS * element;
+  size_t root_value = 2 + 2 + 1 + 5 + array_value;
+  uint8_t *buf = malloc(7 + 2 + 1 + 5 + root_value);
+  if (!buf) return NULL;
+
+  static const uint8_t header[7] = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00};
+  memcpy(buf, header, sizeof(header));
+  size_t pos = sizeof(header);
+  pos += PutNNInt(buf + pos, 0, 1);
+  buf[pos++] = 0x00;
+  pos += PutNNInt(buf + pos, root_value, 4);
+  pos += PutNNInt(buf + pos, 1, 1);
+  pos += PutNNInt(buf + pos, 0, 1);
+  buf[pos++] = 0x10;
+  pos += PutNNInt(buf + pos, array_value, 4);
+  pos += PutNNInt(buf + pos, BENCH_STRINGS, 4);
+  for (int i = 0; i < BENCH_STRINGS; ++i) {
+    pos += PutNNInt(buf + pos, (uint64_t)i << 1, 1);
+    buf[pos++] = 0x50;
+    pos += PutNNInt(buf + pos, BENCH_STRING_SIZE, 4);
+    for (size_t j = 0; j + 1 < BENCH_STRING_SIZE; ++j) {
+      buf[pos + j] = (uint8_t)('a' + (i + j) % 26);
+    }
+    buf[pos + BENCH_STRING_SIZE - 1] = '\0';
+    pos += BENCH_STRING_SIZE;
+  }
+  *size = pos;
+  return buf;
+}
+
+/**
+ * @brief Main function of the hash benchmark.
+ */
+int main(int argc, char **argv) {
+  long iterations = argc > 1 ? atol(argv[1]) : 200000;
+  if (iterations <= 0) iterations = 200000;
+
+  size_t dict_size, payload_size;
+  uint8_t *dict = ReadFile("dummy_dictionaries/Memory_v1.bin", &dict_size);
+  uint8_t *payload = ReadFile("dummy_data/memory_bej.bin", &payload_size);
+  BejDecoder *decoder = dict ? BejDecoderCreate(dict, dict_size) : NULL;
+  if (!payload || !decoder) {
+    free(dict);
+    free(payload);
+    BejDecoderDestroy(decoder);
+    return 1;
+  }
+
+  BejHashValue hash;
+  double start = NowNs();
+  for (long i = 0; i < iterations; ++i) BejHash(payload, payload_size, &hash);
+  double hash_ns = (NowNs() - start) / (double)iterations;
+
+  const char *json;
+  size_t json_size;
+  start = NowNs();
+  for (long i = 0; i < iterations; ++i) {
+    BejDecoderDecodeCompact(decoder, payload, payload_size, &json,
+                            &json_size);
+  }
+  double decode_ns = (NowNs() - start) / (double)iterations;
+  printf("memory   hash %8.1f ns/op   decode %8.1f ns/op   (%zu bytes)\n",
+         hash_ns, decode_ns, payload_size);
+
+  size_t big_size = 0;
+  uint8_t *big = BuildStringPayload(&big_size);
+  uint8_t *copy = malloc(big_size);
+  long rounds = iterations / 10000 > 0 ? iterations / 10000 : 1;
+  if (big && copy) {
+    start = NowNs();
+    for (long i = 0; i < rounds; ++i) BejHash(big, big_size, &hash);
+    double hash_s = (NowNs() - start) / 1e9;
+    volatile uint8_t sink = 0;
+    start = NowNs();
+    for (long i = 0; i < rounds; ++i) {
+      memcpy(copy, big, big_size);
+      sink ^= copy[(size_t)i % big_size];
+    }
+    double copy_s = (NowNs() - start) / 1e9;
+    (void)sink;
+    double bytes = (double)big_size * (double)rounds;
+    printf("strings  hash %8.2f GB/s   memcpy %8.2f GB/s   (%zu bytes)\n",
+           bytes / hash_s / 1e9, bytes / copy_s / 1e9, big_size);
+  }
+
+  free(copy);
+  free(big);
+  free(dict);
+  free(payload);
+  BejDecoderDestroy(decoder);
+  return 0;
+}
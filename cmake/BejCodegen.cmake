@@ -0,0 +1,17 @@
+# bej_generate_decoder(<dictionary> <symbol> <out_var>)
+#
+# Runs bej-codegen on <dictionary> at build time and stores the generated
+# source file in <out_var>. The generated header is placed next to it in
+# CMAKE_CURRENT_BINARY_DIR, which callers should add to their include path.
+function(bej_generate_decoder dictionary symbol out_var)
+  string(TOLOWER ${symbol} lower)
+  set(source ${CMAKE_CURRENT_BINARY_DIR}/bej_decode_${lower}.c)
+  set(header ${CMAKE_CURRENT_BINARY_DIR}/bej_decode_${lower}.h)
+  add_custom_command(
+    OUTPUT ${source} ${header}
+    COMMAND bej-codegen ${dictionary} ${symbol} ${source} ${header}
+    DEPENDS bej-codegen ${dictionary}
+    COMMENT "Generating BEJ decoder for ${symbol}"
+  )
+  set(${out_var} ${source} PARENT_SCOPE)
+endfunction()
@@ -0,0 +1,155 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "stream_utils.h"
+
+/**
+ * @file archive.h
+ * @brief Append-only container for raw BEJ payloads.
+ *
+ * Layout (all integers little-endian):
+ * - File header: "BEJA", uint16 version, uint16 flags.
+ * - Records: uint32 payload length, uint16 dictionary id, uint16 record
+ *   marker (BEJ_ARCHIVE_RECORD_MARKER), uint64 timestamp, payload bytes.
+ * - Index: one uint64 file offset per record.
+ * - Footer: uint64 index offset, uint64 record count, "BEJX", uint32
+ *   reserved.
+ *
+ * Appending truncates the index, writes the new records and rewrites the
+ * index on close. If an archive lost its index (e.g. after a crash while
+ * appending), opening it for appending rebuilds the index by scanning the
+ * records.
+ */
+
+#define BEJ_ARCHIVE_VERSION 1
+#define BEJ_ARCHIVE_HEADER_SIZE 8
+#define BEJ_ARCHIVE_RECORD_HEADER_SIZE 16
+#define BEJ_ARCHIVE_FOOTER_SIZE 24
+#define BEJ_ARCHIVE_RECORD_MARKER 0xB3A1
+
+/**
+ * @struct BejArchiveRecord
+ * @brief A single archived payload.
+ */
+typedef struct {
+  const uint8_t *payload;
+  uint32_t size;
+  uint16_t dictionary_id;
+  uint64_t timestamp;
+} BejArchiveRecord;
+
+/**
+ * @struct BejArchiveWriter
+ * @brief Appends records to an archive file.
+ */
+typedef struct {
+  FILE *file;
+  uint64_t *offsets;
+  size_t record_count;
+  size_t capacity;
+  uint64_t end_offset;
+} BejArchiveWriter;
+
+/**
+ * @struct BejArchive
+ * @brief A read-only, memory-mapped archive.
+ */
+typedef struct {
+  const uint8_t *map;
+  size_t size;
+  const uint8_t *index;
+  size_t record_count;
+} BejArchive;
+
+/**
+ * @struct BejArchiveDecodeStats
+ * @brief Counters reported by BejArchiveDecodeAll().
+ */
+typedef struct {
+  size_t records;
+  size_t failed;
+} BejArchiveDecodeStats;
+
+/**
+ * @brief Opens an archive for appending, creating it if it does not exist.
+ *
+ * @param writer Pointer to the writer to initialize.
+ * @param path Path of the archive file.
+ * @return true on success, false otherwise.
+ */
+bool BejArchiveWriterOpen(BejArchiveWriter *writer, const char *path);
+
+/**
+ * @brief Appends one payload to the archive.
+ *
+ * @param writer Pointer to an open writer.
+ * @param dictionary_id Caller-defined id of the dictionary for the payload.
+ * @param timestamp Caller-defined timestamp (e.g. Unix time in milliseconds).
+ * @param payload Pointer to the raw BEJ payload.
+ * @param size Size of the payload in bytes.
+ * @return true on success, false otherwise.
+ */
+bool BejArchiveAppend(BejArchiveWriter *writer, uint16_t dictionary_id,
+                      uint64_t timestamp, const uint8_t *payload, size_t size);
+
+/**
+ * @brief Writes the index and closes the archive.
+ *
+ * @param writer Pointer to an open writer.
+ * @return true if the index was written successfully, false otherwise.
+ */
+bool BejArchiveWriterClose(BejArchiveWriter *writer);
+
+/**
+ * @brief Memory-maps an archive for reading.
+ *
+ * @param archive Pointer to the archive to initialize.
+ * @param path Path of the archive file.
+ * @return true on success, false if the file is missing or malformed.
+ */
+bool BejArchiveOpen(BejArchive *archive, const char *path);
+
+/**
+ * @brief Returns record `index` in O(1) via the trailing index.
+ *
+ * @param archive Pointer to an open archive.
+ * @param index Index of the record, in [0, archive->record_count).
+ * @param record Pointer receiving the record; `payload` points into the map.
+ * @return true on success, false if the index or the record is invalid.
+ */
+bool BejArchiveGetRecord(const BejArchive *archive, size_t index,
+                         BejArchiveRecord *record);
+
+/**
+ * @brief Unmaps the archive.
+ *
+ * @param archive Pointer to an open archive.
+ */
+void BejArchiveClose(BejArchive *archive);
+
+/**
+ * @brief Decodes every record in order into NDJSON.
+ *
+ * Records are read sequentially with kernel readahead and decoded in
+ * parallel; output lines keep record order. Records that cannot be decoded
+ * produce a `null` line.
+ *
+ * @param archive Pointer to an open archive.
+ * @param dictionaries Schema dictionaries indexed by dictionary id.
+ * @param dictionary_count Number of entries in `dictionaries`.
+ * @param thread_count Number of decoding threads.
+ * @param out Stream receiving the NDJSON output.
+ * @param stats Optional pointer receiving record counters.
+ * @return true if every line was written, false on an I/O or memory error.
+ */
+bool BejArchiveDecodeAll(const BejArchive *archive,
+                         const InputStream *dictionaries,
+                         size_t dictionary_count, size_t thread_count,
+                         FILE *out, BejArchiveDecodeStats *stats);
+
+#endif
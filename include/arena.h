@@ -0,0 +1,87 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file arena.h
+ * @brief Bump allocator whose allocations are all freed at once.
+ *
+ * Memory is handed out from a chain of blocks. ArenaReset() makes every
+ * block available again in O(1) without returning it to the system, so a
+ * long-running process that decodes one document after another reaches a
+ * steady state with no malloc() calls at all. Only built with
+ * USE_ARENA_ALLOCATOR.
+ */
+
+/// @brief Block size used when ArenaInit() is given 0.
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+/**
+ * @struct ArenaBlock
+ * @brief One chunk of arena memory.
+ */
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t size;
+  size_t used;
+  uint8_t data[];
+} ArenaBlock;
+
+/**
+ * @struct Arena
+ * @brief Chain of blocks; allocations are served from `current`.
+ */
+typedef struct {
+  ArenaBlock *first;
+  ArenaBlock *current;
+  size_t block_size;
+} Arena;
+
+/**
+ * @brief Initializes an empty arena. No memory is allocated until the first
+ * ArenaAlloc().
+ *
+ * @param arena Pointer to the Arena.
+ * @param block_size Size of each block, or 0 for ARENA_DEFAULT_BLOCK_SIZE.
+ */
+void ArenaInit(Arena *arena, size_t block_size);
+
+/**
+ * @brief Allocates `size` bytes aligned to 8 bytes.
+ *
+ * Requests larger than the block size get a block of their own.
+ *
+ * @return Pointer to the memory, or NULL if it could not be allocated.
+ */
+void *ArenaAlloc(Arena *arena, size_t size);
+
+/**
+ * @brief Resizes the allocation at `ptr`.
+ *
+ * The allocation is extended in place when it is the most recent one and
+ * its block has room; otherwise it is copied into a new allocation and the
+ * old bytes stay unused until the next reset.
+ *
+ * @return Pointer to the resized memory, or NULL if it could not be
+ * allocated (the old allocation stays valid).
+ */
+void *ArenaGrow(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Frees every allocation in O(1), keeping the blocks for reuse.
+ */
+void ArenaReset(Arena *arena);
+
+/**
+ * @brief Returns the number of bytes held in blocks.
+ */
+size_t ArenaReserved(const Arena *arena);
+
+/**
+ * @brief Returns all blocks to the system.
+ */
+void ArenaRelease(Arena *arena);
+
+#endif
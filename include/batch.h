@@ -0,0 +1,90 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "decoder.h"
+
+/**
+ * @file batch.h
+ * @brief Decoding of many small payload files, one JSON file per payload.
+ *
+ * Three I/O backends are available:
+ * - BEJ_BATCH_SYNC: fopen/fread/fwrite per file, like the single-file CLI.
+ * - BEJ_BATCH_PREAD: pread/write, with posix_fadvise() readahead hints for
+ *   the next `queue_depth` inputs so the kernel reads them while the current
+ *   one is decoded.
+ * - BEJ_BATCH_URING: keeps up to `queue_depth` reads of upcoming payloads and
+ *   writes of finished JSON in flight through io_uring, and decodes whatever
+ *   completes in the meantime. Only available when the library was built
+ *   with io_uring support and the kernel allows it; otherwise the batch
+ *   falls back to BEJ_BATCH_PREAD.
+ *
+ * Files are opened and closed synchronously; only the data transfers are
+ * asynchronous.
+ */
+
+#define BEJ_BATCH_DEFAULT_QUEUE_DEPTH 32
+
+/**
+ * @enum BejBatchBackend
+ * @brief I/O backend used by BejBatchDecodeFiles().
+ */
+typedef enum {
+  BEJ_BATCH_SYNC,
+  BEJ_BATCH_PREAD,
+  BEJ_BATCH_URING
+} BejBatchBackend;
+
+/**
+ * @struct BejBatchOptions
+ * @brief Options of a batch run.
+ */
+typedef struct {
+  BejBatchBackend backend;
+  /// Number of files with I/O in flight (or hinted ahead) at a time.
+  size_t queue_depth;
+} BejBatchOptions;
+
+/**
+ * @struct BejBatchStats
+ * @brief Counters reported by BejBatchDecodeFiles().
+ */
+typedef struct {
+  BejBatchBackend backend;
+  size_t files;
+  size_t failed;
+  size_t bytes_read;
+  size_t bytes_written;
+  double seconds;
+} BejBatchStats;
+
+/**
+ * @brief Returns true if the io_uring backend can be used on this system.
+ */
+bool BejBatchUringAvailable(void);
+
+/**
+ * @brief Returns the name of a backend ("sync", "pread" or "io_uring").
+ */
+const char *BejBatchBackendName(BejBatchBackend backend);
+
+/**
+ * @brief Decodes `inputs[i]` into the JSON file `outputs[i]` for every i.
+ *
+ * @param decoder Decoder for the dictionary shared by all payloads.
+ * @param inputs Paths of the payload files.
+ * @param outputs Paths of the JSON files to create.
+ * @param count Number of files.
+ * @param options Batch options.
+ * @param stats Optional pointer receiving counters, the backend actually
+ * used and the elapsed time.
+ * @return true if every file was decoded and written, false otherwise.
+ */
+bool BejBatchDecodeFiles(BejDecoder *decoder, char *const *inputs,
+                         char *const *outputs, size_t count,
+                         const BejBatchOptions *options,
+                         BejBatchStats *stats);
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef DECODE_CACHE_H
+#define DECODE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file decode_cache.h
+ * @brief Cache of rendered JSON for objects and arrays seen before.
+ *
+ * Successive polls of the same resource usually repeat large parts of the
+ * payload byte for byte. A BejDecodeCache remembers, for every object or
+ * array it has rendered, the raw BEJ bytes of its value and the JSON that was
+ * produced for them. When a decoder with an attached cache meets the same
+ * bytes again at the same place, it copies the stored JSON and skips the
+ * subtree instead of decoding it.
+ *
+ * Entries are keyed by the dictionary, the sequence-number path of the
+ * subtree, the output style (indentation level, format, compact) and a hash
+ * of the raw bytes. The raw bytes themselves are compared on every hit, so
+ * colliding byte hashes are harmless. The dictionary and the path are only
+ * 64-bit hashes, though: if two of them collide, identical bytes may be
+ * served the JSON rendered for the other one. The least recently used
+ * entries are evicted when the cache would grow past its memory bound.
+ *
+ * A cache is not thread-safe. It may be shared by several decoders, with
+ * the same or different dictionaries, that run on one thread.
+ */
+
+/// @brief Subtrees with fewer value bytes than this are decoded directly.
+#define BEJ_DECODE_CACHE_DEFAULT_MIN_SUBTREE 32
+
+typedef struct BejDecodeCache BejDecodeCache;
+
+/**
+ * @struct BejDecodeCacheKey
+ * @brief Everything besides the raw bytes that a rendered subtree depends
+ * on.
+ */
+typedef struct {
+  uint64_t dictionary;
+  uint64_t path;
+  /// Rendering of the subtree: its indentation level, its BEJ format (a SET
+  /// and an ARRAY with the same bytes render differently) and compact mode.
+  uint32_t style;
+} BejDecodeCacheKey;
+
+/**
+ * @struct BejDecodeCacheStats
+ * @brief Counters reported by BejDecodeCacheGetStats().
+ */
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t insertions;
+  uint64_t evictions;
+  size_t entries;
+  /// Memory charged to the cached entries, including their bookkeeping.
+  size_t bytes;
+  size_t max_bytes;
+} BejDecodeCacheStats;
+
+/**
+ * @brief Hashes a byte range with a seed.
+ *
+ * Used for the raw subtree bytes and to identify dictionaries.
+ */
+uint64_t BejDecodeCacheHash(const void *data, size_t size, uint64_t seed);
+
+/**
+ * @brief Creates an empty cache.
+ *
+ * @param max_bytes Memory bound for the cached entries.
+ * @param min_subtree_size Smallest subtree, in value bytes, worth caching.
+ * @return The new cache, or NULL if memory could not be allocated.
+ */
+BejDecodeCache *BejDecodeCacheCreate(size_t max_bytes,
+                                     size_t min_subtree_size);
+
+/**
+ * @brief Returns the smallest subtree size the cache accepts.
+ */
+size_t BejDecodeCacheMinSubtree(const BejDecodeCache *cache);
+
+/**
+ * @brief Looks up the JSON rendered for `raw` under `key`.
+ *
+ * Counts a hit or a miss. A hit also marks the entry as recently used.
+ *
+ * @param cache Pointer to the cache.
+ * @param key Key of the subtree.
+ * @param raw Raw BEJ bytes of the subtree's value.
+ * @param raw_size Number of raw bytes.
+ * @param fragment_size Receives the length of the returned JSON.
+ * @return The cached JSON, valid until the next insertion, or NULL.
+ */
+const char *BejDecodeCacheLookup(BejDecodeCache *cache,
+                                 const BejDecodeCacheKey *key,
+                                 const uint8_t *raw, size_t raw_size,
+                                 size_t *fragment_size);
+
+/**
+ * @brief Stores the JSON rendered for `raw` under `key`.
+ *
+ * Evicts least recently used entries until the new one fits. Entries larger
+ * than an eighth of the memory bound are not stored.
+ *
+ * @return true if the entry was stored, false otherwise.
+ */
+bool BejDecodeCacheInsert(BejDecodeCache *cache, const BejDecodeCacheKey *key,
+                          const uint8_t *raw, size_t raw_size,
+                          const char *fragment, size_t fragment_size);
+
+/**
+ * @brief Reports hit, miss and memory counters.
+ */
+void BejDecodeCacheGetStats(const BejDecodeCache *cache,
+                            BejDecodeCacheStats *stats);
+
+/**
+ * @brief Drops every entry and resets the counters.
+ */
+void BejDecodeCacheClear(BejDecodeCache *cache);
+
+/**
+ * @brief Frees a cache. Passing NULL is allowed.
+ */
+void BejDecodeCacheDestroy(BejDecodeCache *cache);
+
+#endif
@@ -3,19 +3,138 @@
 
 #include <stdbool.h>
 
+#include "decode_cache.h"
 #include "dictionary.h"
+#include "iovec_stream.h"
 #include "json_writer.h"
 #include "stream_utils.h"
 
+/**
+ * @brief Unpacks a BEJ NNInt (Non-Negative Integer) from the input stream.
+ *
+ * @param stream Pointer to the InputStream.
+ * @return The unpacked integer value.
+ */
+uint64_t BejUnpackNNInt(InputStream *stream);
+
+/**
+ * @brief Validates and consumes the BEJ payload header (version, flags and
+ * schema class).
+ *
+ * @param bej_input Pointer to the input stream positioned at the start of the
+ * payload.
+ * @return true if the header is acceptable, false otherwise.
+ */
+bool BejReadHeader(InputStream *bej_input);
+
 /**
  * @brief Decodes a BEJ (Binary Encoded JSON) stream into a JSON output stream.
  * @param out Pointer to the output stream where the decoded JSON will be
  * written.
  * @param bej_input Pointer to the input stream containing the BEJ data.
  * @param schema_dict Pointer to the input stream for the schema dictionary.
- * @return true if decoding was successful, false otherwise.
+ * @return true if decoding was successful, false otherwise (including when
+ * the output did not fit into the stream).
  */
 bool BejDecode(OutputStream *out, InputStream *bej_input,
                 InputStream *schema_dict);
 
+/**
+ * @brief Decodes a BEJ stream into compact JSON without newlines or
+ * indentation, suitable for one-document-per-line output.
+ *
+ * @param out Pointer to the output stream where the decoded JSON will be
+ * written.
+ * @param bej_input Pointer to the input stream containing the BEJ data.
+ * @param schema_dict Pointer to the input stream for the schema dictionary.
+ * @return true if decoding was successful, false otherwise.
+ */
+bool BejDecodeCompact(OutputStream *out, InputStream *bej_input,
+                      InputStream *schema_dict);
+
+/**
+ * @brief Decodes a BEJ stream into a gather list without copying strings.
+ *
+ * String values and property/enum names are referenced directly in the
+ * payload and dictionary buffers, which must stay valid until the stream is
+ * flushed. The produced bytes are identical to BejDecode().
+ *
+ * @param out Pointer to the gather stream receiving the JSON fragments.
+ * @param bej_input Pointer to the input stream containing the BEJ data.
+ * @param schema_dict Pointer to the input stream for the schema dictionary.
+ * @return true if decoding was successful, false otherwise.
+ */
+bool BejDecodeGather(IovecStream *out, InputStream *bej_input,
+                     InputStream *schema_dict);
+
+/**
+ * @brief Opaque, reusable decoder bound to one schema dictionary.
+ *
+ * A BejDecoder owns a compiled copy of its dictionary and a 256 KiB output
+ * buffer, so decoding allocates nothing. Create one decoder per thread:
+ * a decoder must not be used by two threads at the same time, while
+ * different decoders are fully independent and may run concurrently.
+ */
+typedef struct BejDecoder BejDecoder;
+
+/**
+ * @brief Creates a decoder for the given schema dictionary.
+ *
+ * The dictionary bytes are copied, so the caller may free them afterwards.
+ *
+ * @param dictionary Pointer to the raw schema dictionary.
+ * @param size The size of the dictionary in bytes.
+ * @return The new decoder, or NULL if the dictionary is malformed or memory
+ * could not be allocated.
+ */
+BejDecoder *BejDecoderCreate(const uint8_t *dictionary, size_t size);
+
+/**
+ * @brief Attaches a subtree cache to a decoder, or detaches it with NULL.
+ *
+ * The cache is not owned by the decoder and must outlive it or be detached
+ * first. Output is byte-identical with and without a cache.
+ *
+ * @param decoder Pointer to the decoder.
+ * @param cache Pointer to the cache, or NULL.
+ */
+void BejDecoderSetCache(BejDecoder *decoder, BejDecodeCache *cache);
+
+/**
+ * @brief Decodes a payload into pretty-printed JSON.
+ *
+ * @param decoder Pointer to the decoder.
+ * @param payload Pointer to the BEJ payload.
+ * @param size The size of the payload in bytes.
+ * @param json Receives a pointer to the NUL-terminated JSON, owned by the
+ * decoder and valid until the next decode or reset.
+ * @param json_size Receives the length of the JSON in bytes.
+ * @return true if decoding was successful, false otherwise.
+ */
+bool BejDecoderDecode(BejDecoder *decoder, const uint8_t *payload,
+                      size_t size, const char **json, size_t *json_size);
+
+/**
+ * @brief Decodes a payload into compact single-line JSON.
+ *
+ * Same contract as BejDecoderDecode().
+ */
+bool BejDecoderDecodeCompact(BejDecoder *decoder, const uint8_t *payload,
+                             size_t size, const char **json,
+                             size_t *json_size);
+
+/**
+ * @brief Discards the output of the previous decode without freeing memory.
+ *
+ * @param decoder Pointer to the decoder.
+ */
+void BejDecoderReset(BejDecoder *decoder);
+
+/**
+ * @brief Frees a decoder. Passing NULL is allowed.
+ *
+ * @param decoder Pointer to the decoder.
+ */
+void BejDecoderDestroy(BejDecoder *decoder);
+
 #endif
\ No newline at end of file
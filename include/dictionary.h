@@ -5,7 +5,25 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#define MAX_DICT_ENTRIES 512
+/// @brief Size of the dictionary header that precedes the root entry.
+#define DICTIONARY_HEADER_SIZE 12
+
+/// @brief Size of an entry in the standard layout.
+#define DICTIONARY_ENTRY_SIZE 10
+
+/// @brief Size of an entry in the wide layout.
+#define DICTIONARY_WIDE_ENTRY_SIZE 18
+
+/**
+ * @brief DictionaryFlags bit (header byte 1) selecting the wide layout.
+ *
+ * The standard layout stores sequence numbers, child offsets, child counts
+ * and name offsets in 16 bits, which limits a dictionary to 64 KiB. Large
+ * merged dictionaries set this flag and use 18-byte entries instead: format
+ * and flags (1 byte), sequence number (4), child offset (4), child count (4),
+ * name length (1) and name offset (4). The header is unchanged.
+ */
+#define DICTIONARY_FLAG_WIDE 0x80
 
 /**
  * @struct DictionaryEntry
@@ -14,9 +32,9 @@
 typedef struct {
   uint8_t format;
   uint8_t flags;
-  uint16_t sequence_number;
-  uint16_t offset;
-  uint16_t child_count;
+  uint32_t sequence_number;
+  uint32_t offset;
+  uint32_t child_count;
   const char *name;
 } DictionaryEntry;
 
@@ -39,6 +57,38 @@ typedef struct {
   uint8_t selector;
 } DecodedSeq;
 
+/**
+ * @struct DictionarySubset
+ * @brief Location of one parsed subset inside a CompiledDictionary.
+ */
+typedef struct {
+  uint32_t offset;
+  uint32_t first;
+  uint32_t count;
+} DictionarySubset;
+
+/**
+ * @struct CompiledDictionary
+ * @brief A dictionary with every reachable subset parsed once up front.
+ *
+ * The decoder normally re-parses a subset from the dictionary bytes each time
+ * it enters a SET, ARRAY or ENUM. A compiled dictionary stores all subsets in
+ * one entry array, looked up by their byte offset and entry count (the root
+ * subset uses offset 0 and count 1). Entries that share an offset with
+ * different counts get a subset each. The entries of every subset are
+ * ordered by sequence number, so DictionaryFindEntry() can search them.
+ * Entry names point into `data`. A compiled dictionary is never modified
+ * after DictionaryCompile(), so it may be shared between threads.
+ */
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  DictionaryEntry *entries;
+  size_t entry_count;
+  DictionarySubset *subsets;
+  size_t subset_count;
+} CompiledDictionary;
+
 /**
  * @brief Reads an integer from a dictionary stream.
  *
@@ -48,6 +98,47 @@ typedef struct {
  */
 uint64_t DictStreamReadInt(DictionaryStream *stream, size_t size);
 
+/**
+ * @brief Returns true if the dictionary uses the wide entry layout.
+ */
+bool DictionaryIsWide(const uint8_t *data, size_t size);
+
+/**
+ * @brief Parses the entry at position `index` of the subset at `offset`.
+ *
+ * @param data Pointer to the raw dictionary byte array.
+ * @param size The size of the dictionary byte array.
+ * @param offset The byte offset of the subset.
+ * @param index Position of the entry within the subset.
+ * @param out Receives the entry.
+ * @return true if the entry lies inside the dictionary, false otherwise.
+ */
+bool DictionaryReadEntry(const uint8_t *data, size_t size, uint32_t offset,
+                         uint32_t index, DictionaryEntry *out);
+
+/**
+ * @brief Finds an entry by sequence number directly in the dictionary bytes.
+ *
+ * The entry at position `seq` is tried first, since subsets are usually
+ * numbered by position, and then the subset is binary searched, which finds
+ * the entry in O(log n) when the subset is stored in sequence number order.
+ * Only subsets stored out of order (and sequence numbers that are missing)
+ * fall back to an O(n) scan; DictionaryCompile() sorts subsets, so
+ * BejDecoder has no such case. Nothing is buffered, so subsets of any size
+ * can be searched.
+ *
+ * @param data Pointer to the raw dictionary byte array.
+ * @param size The size of the dictionary byte array.
+ * @param offset The byte offset of the subset.
+ * @param child_count The number of entries in the subset.
+ * @param seq The sequence number to search for.
+ * @param out Receives the entry.
+ * @return true if the entry was found, false otherwise.
+ */
+bool DictionaryFindRawEntry(const uint8_t *data, size_t size, uint32_t offset,
+                            uint32_t child_count, uint64_t seq,
+                            DictionaryEntry *out);
+
 /**
  * @brief Loads a subset of a dictionary into a provided buffer.
  *
@@ -60,14 +151,66 @@ uint64_t DictStreamReadInt(DictionaryStream *stream, size_t size);
  * @param offset The starting byte offset for the dictionary subset.
  * @param child_count The number of dictionary entries to load. A value of -1
  * indicates the root entry.
- * @param out_entries A pre-allocated array where the loaded entries will be
- * stored.
+ * @param out_entries A pre-allocated array with room for `child_count`
+ * entries (one for the root).
  * @param out_count Pointer to a variable to store the number of loaded entries.
  * @return true if the subset was loaded successfully, false otherwise.
  */
 bool LoadDictionarySubsetIntoBuffer(const uint8_t *data, size_t size,
-                                        uint16_t offset, int16_t child_count,
-                                        DictionaryEntry *out_entries,
-                                        size_t *out_count);
+                                    uint32_t offset, int64_t child_count,
+                                    DictionaryEntry *out_entries,
+                                    size_t *out_count);
+
+/**
+ * @brief Parses every subset reachable from the root of a dictionary.
+ *
+ * The dictionary bytes are copied, so `data` may be freed afterwards.
+ *
+ * @param dict Pointer to the CompiledDictionary to initialize.
+ * @param data Pointer to the raw dictionary byte array.
+ * @param size The size of the dictionary byte array.
+ * @return true on success, false if the dictionary is malformed or memory
+ * could not be allocated.
+ */
+bool DictionaryCompile(CompiledDictionary *dict, const uint8_t *data,
+                       size_t size);
+
+/**
+ * @brief Looks up a parsed subset by the offset and child count stored in
+ * its parent entry.
+ *
+ * @param dict Pointer to the CompiledDictionary.
+ * @param offset The subset offset (0 for the root subset).
+ * @param child_count The number of entries in the subset (1 for the root).
+ * @param out_entries Receives a pointer to the subset's first entry.
+ * @param out_count Receives the number of entries in the subset.
+ * @return true if the subset exists, false otherwise.
+ */
+bool DictionaryFindSubset(const CompiledDictionary *dict, uint32_t offset,
+                          uint32_t child_count,
+                          const DictionaryEntry **out_entries,
+                          size_t *out_count);
+
+/**
+ * @brief Finds an entry by sequence number in a subset of a
+ * CompiledDictionary.
+ *
+ * Takes O(1) when the subset is numbered by position and O(log n) otherwise,
+ * which keeps lookups in enums with thousands of values cheap.
+ *
+ * @param entries Entries of the subset, ordered by sequence number.
+ * @param count The number of entries.
+ * @param seq The sequence number to search for.
+ * @return Pointer to the first entry with that sequence number, or NULL.
+ */
+const DictionaryEntry *DictionaryFindEntry(const DictionaryEntry *entries,
+                                           size_t count, uint64_t seq);
+
+/**
+ * @brief Frees the memory held by a compiled dictionary.
+ *
+ * @param dict Pointer to the CompiledDictionary.
+ */
+void DictionaryRelease(CompiledDictionary *dict);
 
 #endif
\ No newline at end of file
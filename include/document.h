@@ -0,0 +1,192 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "dictionary.h"
+#include "stream_utils.h"
+
+/**
+ * @file document.h
+ * @brief Decoded BEJ payload as an editable in-memory document (tape).
+ *
+ * BejDocumentParse() turns a payload into one contiguous array of BejNode,
+ * in document order: every object or array is followed by its members, and
+ * `end` gives the index just past its subtree, so a subtree is skipped in
+ * O(1). String values are views into the payload, property and enum names
+ * are views into the compiled dictionary, and every leaf keeps a view of
+ * its encoded value bytes, so parsing copies nothing.
+ *
+ * All memory of a document (the node array and the values written by the
+ * setters) comes from an Arena. The payload and the dictionary must outlive
+ * the document. ArenaReset() frees every document parsed into the arena at
+ * once. Only built with USE_ARENA_ALLOCATOR.
+ */
+
+/// @brief Returned by the lookup functions when nothing matches.
+#define BEJ_NODE_NONE UINT32_MAX
+
+/**
+ * @enum BejNodeType
+ * @brief Type of a document node.
+ */
+typedef enum {
+  BEJ_NODE_OBJECT,
+  BEJ_NODE_ARRAY,
+  BEJ_NODE_NULL,
+  BEJ_NODE_INTEGER,
+  BEJ_NODE_ENUM,
+  BEJ_NODE_STRING,
+  BEJ_NODE_BOOLEAN
+} BejNodeType;
+
+/// @brief Node flag: the node is an array element and has no name.
+#define BEJ_NODE_ARRAY_ITEM 0x01
+/// @brief Node flag: the node was removed and is skipped on output.
+#define BEJ_NODE_REMOVED 0x02
+
+/**
+ * @struct BejStringView
+ * @brief Non-owning reference to bytes that are not NUL-terminated in
+ * general.
+ */
+typedef struct {
+  const char *data;
+  size_t size;
+} BejStringView;
+
+/**
+ * @struct BejNode
+ * @brief One entry of the document tape.
+ */
+typedef struct {
+  uint8_t type;
+  /// BEJ format byte of the tuple, including its flag bits.
+  uint8_t format;
+  uint16_t flags;
+  /// Encoded sequence number, including the dictionary selector bit.
+  uint32_t seq;
+  /// Index just past this node's subtree (index + 1 for leaves).
+  uint32_t end;
+  /// Number of members of an object or array, including removed ones.
+  uint32_t count;
+  /// Dictionary entry of the property; gives its name and child subset.
+  const DictionaryEntry *entry;
+  /// Leaves: the encoded value, in the payload or in the arena.
+  const uint8_t *raw;
+  size_t raw_size;
+  /// Decoded value: `integer` for integers, `boolean` for booleans, `string`
+  /// for strings and enums (NULL data for an unknown enum value).
+  union {
+    int64_t integer;
+    bool boolean;
+    BejStringView string;
+  } value;
+} BejNode;
+
+/**
+ * @struct BejDocument
+ * @brief Tape of one payload.
+ */
+typedef struct {
+  Arena *arena;
+  const CompiledDictionary *dictionary;
+  uint8_t header[7];
+  BejNode *nodes;
+  uint32_t node_count;
+} BejDocument;
+
+/**
+ * @brief Parses a payload into a document.
+ *
+ * @param doc Pointer to the BejDocument to initialize.
+ * @param arena Arena providing the document's memory.
+ * @param dictionary Compiled schema dictionary of the payload.
+ * @param payload Pointer to the BEJ payload.
+ * @param size The size of the payload in bytes.
+ * @return true on success, false if the payload is malformed or memory
+ * could not be allocated.
+ */
+bool BejDocumentParse(BejDocument *doc, Arena *arena,
+                      const CompiledDictionary *dictionary,
+                      const uint8_t *payload, size_t size);
+
+/**
+ * @brief Returns the name of a node ("" for array elements).
+ */
+const char *BejNodeName(const BejNode *node);
+
+/**
+ * @brief Finds the member called `name` of an object node.
+ *
+ * @return Index of the member, or BEJ_NODE_NONE.
+ */
+uint32_t BejDocumentFind(const BejDocument *doc, uint32_t parent,
+                         const char *name);
+
+/**
+ * @brief Finds a node by a dotted path from the root, e.g.
+ * "MemoryLocation.Slot". Array elements are addressed by their position,
+ * e.g. "AllowedSpeedsMHz.1".
+ *
+ * @return Index of the node, or BEJ_NODE_NONE.
+ */
+uint32_t BejDocumentFindPath(const BejDocument *doc, const char *path);
+
+/**
+ * @brief Replaces the value of an integer node.
+ */
+bool BejDocumentSetInteger(BejDocument *doc, uint32_t index, int64_t value);
+
+/**
+ * @brief Replaces the value of a boolean node.
+ */
+bool BejDocumentSetBoolean(BejDocument *doc, uint32_t index, bool value);
+
+/**
+ * @brief Replaces the value of a string node. The string is copied into the
+ * arena.
+ */
+bool BejDocumentSetString(BejDocument *doc, uint32_t index,
+                          const char *value);
+
+/**
+ * @brief Replaces the value of an enum node by the name of another value of
+ * the same enum.
+ *
+ * @return false if the node is not an enum or `name` is not one of its
+ * values.
+ */
+bool BejDocumentSetEnum(BejDocument *doc, uint32_t index, const char *name);
+
+/**
+ * @brief Removes a node and its subtree. The root cannot be removed.
+ */
+bool BejDocumentRemove(BejDocument *doc, uint32_t index);
+
+/**
+ * @brief Writes the document as JSON.
+ *
+ * An unmodified document produces the same bytes as BejDecode() or, with
+ * `compact`, BejDecodeCompact().
+ *
+ * @return true on success, false if the output did not fit.
+ */
+bool BejDocumentWriteJson(const BejDocument *doc, OutputStream *out,
+                          bool compact);
+
+/**
+ * @brief Encodes the document back into a BEJ payload.
+ *
+ * Unmodified leaves are copied verbatim, so an unmodified document that was
+ * encoded with minimal container lengths reproduces its payload byte for
+ * byte.
+ *
+ * @return true on success, false if the output did not fit.
+ */
+bool BejDocumentWriteBej(const BejDocument *doc, OutputStream *out);
+
+#endif
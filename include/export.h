@@ -0,0 +1,131 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dictionary.h"
+
+/**
+ * @file export.h
+ * @brief Columnar export of payloads that share one schema dictionary.
+ *
+ * Every leaf property of the dictionary becomes one column named by its
+ * dot-separated path below the root (e.g. `MemoryLocation.Slot`). Payloads
+ * are scanned directly into per-column buffers and become one row each;
+ * a payload that cannot be scanned becomes a row of nulls so rows stay
+ * aligned with the input. Arrays of scalars become one string column with
+ * the elements separated by `;`; objects inside arrays are not exported.
+ *
+ * The binary layout (all integers little-endian) is:
+ * - Header: "BEJC", uint16 version, uint32 column count, then per
+ *   column: uint8 type (BejColumnType), uint8 reserved, uint16 name
+ *   length, name.
+ *   Enum columns follow with uint32 value count and, per value, uint32
+ *   enum sequence number, uint16 name length, name.
+ * - Chunks of up to BEJ_EXPORT_CHUNK_ROWS rows: uint32 row count, then per
+ *   column: uint32 byte size of the column data, one validity byte per row
+ *   (1 when the value is present) and the values: int64 for integers,
+ *   uint32 enum sequence numbers for enums, uint8 for booleans, and for
+ *   strings (row count + 1) uint32 offsets followed by the bytes.
+ * - A terminating uint32 row count of 0.
+ */
+
+#define BEJ_EXPORT_VERSION 2
+#define BEJ_EXPORT_CHUNK_ROWS 4096
+#define BEJ_EXPORT_MAX_DEPTH 8
+#define BEJ_EXPORT_MAX_NAME 256
+
+/**
+ * @enum BejColumnType
+ * @brief Storage type of an exported column.
+ */
+typedef enum {
+  BEJ_COLUMN_INT64 = 1,
+  BEJ_COLUMN_ENUM = 2,
+  BEJ_COLUMN_BOOL = 3,
+  BEJ_COLUMN_STRING = 4
+} BejColumnType;
+
+/**
+ * @enum BejExportFormat
+ * @brief Output format of a BejExporter.
+ */
+typedef enum { BEJ_EXPORT_CSV, BEJ_EXPORT_BINARY } BejExportFormat;
+
+/**
+ * @struct BejExportColumn
+ * @brief One leaf property and the values of the current chunk.
+ */
+typedef struct {
+  char name[BEJ_EXPORT_MAX_NAME];
+  uint32_t path[BEJ_EXPORT_MAX_DEPTH];
+  size_t depth;
+  BejColumnType type;
+  uint8_t format;
+  const DictionaryEntry *enum_entries;
+  size_t enum_count;
+  uint8_t *valid;
+  int64_t *values;
+  uint32_t *offsets;
+  char *bytes;
+  size_t bytes_len;
+  size_t bytes_capacity;
+} BejExportColumn;
+
+/**
+ * @struct BejExporter
+ * @brief Collects rows and writes them out chunk by chunk.
+ */
+typedef struct {
+  CompiledDictionary dictionary;
+  BejExportColumn *columns;
+  size_t column_count;
+  BejExportFormat format;
+  FILE *out;
+  size_t chunk_rows;
+  size_t rows;
+  size_t failed;
+  bool error;
+} BejExporter;
+
+/**
+ * @brief Derives the columns from a dictionary and writes the header (the
+ * CSV header line or the binary column descriptors).
+ *
+ * The dictionary bytes are copied, so the caller may free them afterwards.
+ *
+ * @param exporter Pointer to the exporter to initialize.
+ * @param dictionary Pointer to the raw schema dictionary.
+ * @param size The size of the dictionary in bytes.
+ * @param format Output format.
+ * @param out Stream receiving the output.
+ * @return true on success, false if the dictionary is malformed or memory
+ * could not be allocated.
+ */
+bool BejExporterOpen(BejExporter *exporter, const uint8_t *dictionary,
+                     size_t size, BejExportFormat format, FILE *out);
+
+/**
+ * @brief Adds one payload as a row.
+ *
+ * @param exporter Pointer to an open exporter.
+ * @param payload Pointer to the BEJ payload.
+ * @param size The size of the payload in bytes.
+ * @return true if the payload was exported, false if it was malformed (a row
+ * of nulls is added instead) or the output could not be written.
+ */
+bool BejExporterAdd(BejExporter *exporter, const uint8_t *payload,
+                    size_t size);
+
+/**
+ * @brief Writes the pending rows and the trailer, and frees the exporter.
+ *
+ * @param exporter Pointer to an open exporter.
+ * @return true if everything was written, false otherwise.
+ */
+bool BejExporterClose(BejExporter *exporter);
+
+#endif
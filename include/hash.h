@@ -0,0 +1,76 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file hash.h
+ * @brief Canonical 128-bit content hash of BEJ payloads.
+ *
+ * BejHash() walks the tuples of a payload once, without a dictionary and
+ * without producing JSON, and hashes what they mean rather than how they are
+ * encoded:
+ * - SET members are combined independently of their order, so payloads
+ *   that differ only in member order hash equally; each member's hash
+ *   includes its sequence number.
+ * - ARRAY elements are combined in order.
+ * - Leaves are hashed by format and value. Integers are sign-extended,
+ *   strings lose their NUL terminator, NNInts (sequence numbers, lengths,
+ *   counts, enum values) are hashed by value whatever their width, and the
+ *   flag bits of the format byte are ignored.
+ *
+ * The hash is stable across runs, builds and hosts. It is meant for
+ * deduplication, not as a cryptographic digest.
+ */
+
+/// @brief Length of the hex form written by BejHashFormat(), including the
+/// NUL terminator.
+#define BEJ_HASH_HEX_SIZE 33
+
+/**
+ * @struct BejHashValue
+ * @brief A 128-bit hash.
+ */
+typedef struct {
+  uint64_t lo;
+  uint64_t hi;
+} BejHashValue;
+
+/**
+ * @brief Computes the content hash of a payload.
+ *
+ * @param payload Pointer to the BEJ payload.
+ * @param size The size of the payload in bytes.
+ * @param out Receives the hash.
+ * @return true on success, false if the payload is malformed.
+ */
+bool BejHash(const uint8_t *payload, size_t size, BejHashValue *out);
+
+/**
+ * @brief Hashes raw bytes with the function BejHash() uses for string
+ * values.
+ *
+ * @param data Pointer to the bytes.
+ * @param size The number of bytes.
+ * @param seed Seed of the hash.
+ * @return The 128-bit hash.
+ */
+BejHashValue BejHashBytes(const void *data, size_t size, uint64_t seed);
+
+/**
+ * @brief Returns true if two hashes are equal.
+ */
+bool BejHashEqual(const BejHashValue *a, const BejHashValue *b);
+
+/**
+ * @brief Writes a hash as 32 lowercase hex digits, most significant first.
+ *
+ * @param hash Pointer to the hash.
+ * @param out Buffer of BEJ_HASH_HEX_SIZE bytes receiving the NUL-terminated
+ * text.
+ */
+void BejHashFormat(const BejHashValue *hash, char *out);
+
+#endif
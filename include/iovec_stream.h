@@ -0,0 +1,73 @@
+#ifndef IOVEC_STREAM_H
+#define IOVEC_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#define IOVEC_STREAM_MAX_IOV 1024
+#define IOVEC_STREAM_SCRATCH_SIZE (16 * 1024)
+
+/**
+ * References shorter than this are copied into the scratch buffer instead,
+ * since an extra iovec costs more than copying a few bytes.
+ */
+#define IOVEC_STREAM_MIN_REF 16
+
+/**
+ * @struct IovecStream
+ * @brief A gather list of output fragments flushed with writev().
+ *
+ * Fragments added with IovecStreamWriteRef() are referenced in place, so the
+ * buffers they point to (BEJ payload, dictionary) must stay valid until the
+ * stream is flushed. Only small fragments such as JSON punctuation and
+ * formatted numbers are copied into the scratch buffer. When either the iovec
+ * array or the scratch buffer fills up, the stream is flushed to `fd`.
+ */
+typedef struct {
+  struct iovec iov[IOVEC_STREAM_MAX_IOV];
+  size_t iov_count;
+  char scratch[IOVEC_STREAM_SCRATCH_SIZE];
+  size_t scratch_pos;
+  size_t total;
+  int fd;
+  bool error;
+} IovecStream;
+
+/**
+ * @brief Initializes an IovecStream.
+ *
+ * @param stream Pointer to the IovecStream.
+ * @param fd File or socket descriptor to flush to, or -1 to only collect
+ * fragments (writing more than fits is then an error).
+ */
+void IovecStreamInit(IovecStream *stream, int fd);
+
+/**
+ * @brief Copies a buffer into the stream.
+ *
+ * @param stream Pointer to the IovecStream.
+ * @param buf Pointer to the data to write.
+ * @param len The number of bytes to write.
+ */
+void IovecStreamWrite(IovecStream *stream, const char *buf, size_t len);
+
+/**
+ * @brief Adds a reference to a buffer without copying it.
+ *
+ * @param stream Pointer to the IovecStream.
+ * @param buf Pointer to the data; must remain valid until the next flush.
+ * @param len The number of bytes to write.
+ */
+void IovecStreamWriteRef(IovecStream *stream, const char *buf, size_t len);
+
+/**
+ * @brief Writes all pending fragments to the stream's descriptor with
+ * writev() and resets the gather list.
+ *
+ * @param stream Pointer to the IovecStream.
+ * @return true if everything was written and no earlier error occurred.
+ */
+bool IovecStreamFlush(IovecStream *stream);
+
+#endif
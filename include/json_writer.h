@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 
+#include "iovec_stream.h"
 #include "stream_utils.h"
 
 /**
@@ -13,6 +14,39 @@
  */
 void JsonWriteIndent(OutputStream *stream, int indent_level);
 
+/**
+ * @brief Writes indentation to a gather stream by referencing a static
+ * whitespace buffer instead of copying it.
+ *
+ * @param stream Pointer to the IovecStream.
+ * @param indent_level The current indentation level.
+ */
+void JsonGatherWriteIndent(IovecStream *stream, int indent_level);
+
+/**
+ * @brief Writes a JSON string literal: the text between quotes, with `"`,
+ * `\` and control characters escaped.
+ *
+ * Escaping keeps the output valid JSON and keeps compact documents on one
+ * line, whatever bytes the string holds.
+ *
+ * @param stream Pointer to the output stream.
+ * @param text Pointer to the unescaped text (need not be NUL-terminated).
+ * @param len The length of the text in bytes.
+ */
+void JsonWriteString(OutputStream *stream, const char *text, size_t len);
+
+/**
+ * @brief Writes a JSON string literal to a gather stream. Runs that need no
+ * escaping are referenced, so `text` must stay valid until the stream is
+ * flushed.
+ *
+ * @param stream Pointer to the IovecStream.
+ * @param text Pointer to the unescaped text (need not be NUL-terminated).
+ * @param len The length of the text in bytes.
+ */
+void JsonGatherWriteString(IovecStream *stream, const char *text, size_t len);
+
 /**
  * @brief Flushes the contents of the output stream to a file.
  *
@@ -0,0 +1,38 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Work function run by ParallelFor().
+ *
+ * @param ctx Caller context passed to ParallelFor().
+ * @param task Index of the task to run, in [0, task_count).
+ * @param worker Index of the calling worker, in [0, thread_count). Tasks run
+ * by the same worker never overlap, so per-worker scratch state is safe.
+ */
+typedef void (*ParallelTaskFn)(void *ctx, size_t task, size_t worker);
+
+/**
+ * @brief Runs `task_count` tasks on up to `thread_count` threads.
+ *
+ * Tasks are handed out dynamically, so uneven task costs balance out. The
+ * call returns when every task has finished. With one thread (or one task)
+ * the tasks run on the calling thread.
+ *
+ * @param task_count Number of tasks.
+ * @param thread_count Maximum number of threads to use (0 is treated as 1).
+ * @param fn Work function.
+ * @param ctx Context passed to every invocation of `fn`.
+ * @return true on success, false if the worker threads could not be started.
+ */
+bool ParallelFor(size_t task_count, size_t thread_count, ParallelTaskFn fn,
+                 void *ctx);
+
+/**
+ * @brief Returns the number of online CPUs, at least 1.
+ */
+size_t ParallelDefaultThreadCount(void);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "decode_cache.h"
+#include "stream_utils.h"
+
+/// @brief Recommended stdio buffer size for the pipeline input and output.
+#define PIPELINE_IO_BUFFER_SIZE (1024 * 1024)
+
+/// @brief Largest record accepted from the input stream.
+#define PIPELINE_MAX_RECORD_SIZE (64u * 1024 * 1024)
+
+/**
+ * @struct PipelineOptions
+ * @brief Options controlling the framed pipeline.
+ */
+typedef struct {
+  /// Records carry a 16-bit dictionary id after the length prefix.
+  bool tagged;
+  /// Flush the output after every record instead of when the buffer fills.
+  bool flush_each_record;
+  /// Memory bound of a subtree cache shared by all records; 0 disables it.
+  size_t cache_bytes;
+} PipelineOptions;
+
+/**
+ * @struct PipelineStats
+ * @brief Counters reported by PipelineRun().
+ */
+typedef struct {
+  size_t records;
+  size_t failed;
+  /// Subtree cache counters; all zero when the cache is disabled.
+  BejDecodeCacheStats cache;
+} PipelineStats;
+
+/**
+ * @brief Decodes a stream of length-prefixed BEJ records into NDJSON.
+ *
+ * Every record is a 32-bit little-endian payload length, followed by a 16-bit
+ * little-endian dictionary id when `options->tagged` is set, followed by the
+ * payload. Untagged records use dictionary 0. Each record produces exactly
+ * one line of compact JSON; records that cannot be decoded produce a `null`
+ * line so output lines stay aligned with input records.
+ *
+ * With `options->cache_bytes` set, objects and arrays that repeat byte for
+ * byte between records are rendered once and copied afterwards (see
+ * decode_cache.h). The output does not change.
+ *
+ * @param in Stream to read records from until end of file.
+ * @param out Stream to write NDJSON to.
+ * @param dictionaries Array of schema dictionaries indexed by dictionary id.
+ * @param dictionary_count Number of entries in `dictionaries`.
+ * @param options Pipeline options.
+ * @param stats Optional pointer receiving record counters.
+ * @return true if the whole input was consumed and written, false on a
+ * truncated frame or an I/O error.
+ */
+bool PipelineRun(FILE *in, FILE *out, const InputStream *dictionaries,
+                 size_t dictionary_count, const PipelineOptions *options,
+                 PipelineStats *stats);
+
+#endif
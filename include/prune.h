@@ -0,0 +1,79 @@
+#ifndef PRUNE_H
+#define PRUNE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dictionary.h"
+
+/**
+ * @file prune.h
+ * @brief Shrinking a schema dictionary to the entries a corpus uses.
+ *
+ * A BejPruner walks payloads the way BejDecode() does and records every
+ * property and enum value that decoding them looks up. BejPruneWrite() then
+ * writes a dictionary in the same binary format that keeps only those
+ * entries, with their sequence numbers unchanged, so every scanned payload
+ * decodes to identical JSON with the smaller dictionary. Subsets shared by
+ * several properties stay shared. The standard layout is used whenever the
+ * result fits into it, the wide layout otherwise.
+ */
+
+/**
+ * @struct BejPruner
+ * @brief Usage of one dictionary over a corpus.
+ *
+ * `used[i]` is set once `dictionary.entries[i]` has been looked up.
+ */
+typedef struct {
+  CompiledDictionary dictionary;
+  uint8_t *used;
+  size_t payloads;
+  size_t failed;
+} BejPruner;
+
+/**
+ * @brief Prepares a pruner for a dictionary.
+ *
+ * The dictionary bytes are copied, so the caller may free them afterwards.
+ *
+ * @param pruner Pointer to the pruner to initialize.
+ * @param dictionary Pointer to the raw schema dictionary.
+ * @param size The size of the dictionary in bytes.
+ * @return true on success, false if the dictionary is malformed or memory
+ * could not be allocated.
+ */
+bool BejPruneInit(BejPruner *pruner, const uint8_t *dictionary, size_t size);
+
+/**
+ * @brief Records the entries used by one payload.
+ *
+ * @param pruner Pointer to the pruner.
+ * @param payload Pointer to the BEJ payload.
+ * @param size The size of the payload in bytes.
+ * @return true if the whole payload was scanned, false if it cannot be
+ * decoded (it is counted in `failed`; entries it used so far stay recorded).
+ */
+bool BejPruneAdd(BejPruner *pruner, const uint8_t *payload, size_t size);
+
+/**
+ * @brief Writes the pruned dictionary.
+ *
+ * @param pruner Pointer to the pruner.
+ * @param out Receives the dictionary, allocated with malloc().
+ * @param out_size Receives the size of the dictionary in bytes.
+ * @param entry_count Optional pointer receiving the number of entries kept.
+ * @return true on success, false if memory could not be allocated.
+ */
+bool BejPruneWrite(const BejPruner *pruner, uint8_t **out, size_t *out_size,
+                   size_t *entry_count);
+
+/**
+ * @brief Frees the memory held by a pruner.
+ *
+ * @param pruner Pointer to the pruner.
+ */
+void BejPruneRelease(BejPruner *pruner);
+
+#endif
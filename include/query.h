@@ -0,0 +1,182 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dictionary.h"
+#include "stream_utils.h"
+
+/**
+ * @file query.h
+ * @brief Predicate queries evaluated directly on BEJ payloads.
+ *
+ * An expression such as
+ *
+ *     CapacityMiB < 32768 || ErrorCorrection == NoECC
+ *
+ * is compiled once against a schema dictionary: every property path becomes
+ * a list of sequence numbers, and enum names become enum sequence numbers.
+ * Payloads are then scanned tuple by tuple without producing JSON; subtrees
+ * no predicate refers to are skipped by their length, and the scan stops as
+ * soon as every referenced property has been seen.
+ *
+ * Grammar: terms `Path op value` joined by `&&` and `||`, where `&&` binds
+ * tighter. `Path` is a dot-separated list of property names below the root
+ * (arrays cannot be traversed), `op` is one of `== != < <= > >=` and `value`
+ * is an integer, a quoted string, `true`, `false`, `null` or an enum name.
+ * Enums and booleans only support `==` and `!=`. A term whose property is
+ * absent from a payload is false.
+ */
+
+#define BEJ_QUERY_MAX_TERMS 32
+#define BEJ_QUERY_MAX_DEPTH 8
+#define BEJ_QUERY_MAX_FIELD 128
+#define BEJ_QUERY_MAX_LITERAL 64
+
+/**
+ * @enum BejQueryOp
+ * @brief Comparison operators.
+ */
+typedef enum {
+  BEJ_QUERY_EQ,
+  BEJ_QUERY_NE,
+  BEJ_QUERY_LT,
+  BEJ_QUERY_LE,
+  BEJ_QUERY_GT,
+  BEJ_QUERY_GE
+} BejQueryOp;
+
+/**
+ * @struct BejQueryTerm
+ * @brief One compiled comparison.
+ *
+ * Terms with the same `group` are combined with `&&`; the query matches when
+ * all terms of any group hold.
+ */
+typedef struct {
+  char field[BEJ_QUERY_MAX_FIELD];
+  uint32_t path[BEJ_QUERY_MAX_DEPTH];
+  size_t depth;
+  uint8_t format;
+  const DictionaryEntry *enum_entries;
+  size_t enum_count;
+  BejQueryOp op;
+  bool null_literal;
+  int64_t integer;
+  char string[BEJ_QUERY_MAX_LITERAL];
+  size_t string_len;
+  size_t group;
+} BejQueryTerm;
+
+/**
+ * @struct BejQuery
+ * @brief A compiled query. Read-only after BejQueryCompile(), so it may be
+ * shared between threads.
+ */
+typedef struct {
+  CompiledDictionary dictionary;
+  BejQueryTerm terms[BEJ_QUERY_MAX_TERMS];
+  size_t term_count;
+} BejQuery;
+
+/**
+ * @struct BejQueryValue
+ * @brief The raw value of a queried property in one payload.
+ *
+ * `string` points into the payload.
+ */
+typedef struct {
+  bool found;
+  uint8_t format;
+  int64_t integer;
+  const uint8_t *string;
+  size_t string_len;
+} BejQueryValue;
+
+/**
+ * @struct BejQueryResult
+ * @brief Values of every term's property, indexed like BejQuery::terms.
+ */
+typedef struct {
+  BejQueryValue values[BEJ_QUERY_MAX_TERMS];
+} BejQueryResult;
+
+/**
+ * @struct BejQueryStats
+ * @brief Counters reported by BejQueryRunFiles().
+ */
+typedef struct {
+  size_t payloads;
+  size_t matched;
+  size_t failed;
+} BejQueryStats;
+
+/**
+ * @brief Compiles an expression against a schema dictionary.
+ *
+ * The dictionary bytes are copied, so the caller may free them afterwards.
+ * Errors are reported on stderr.
+ *
+ * @param query Pointer to the query to initialize.
+ * @param dictionary Pointer to the raw schema dictionary.
+ * @param size The size of the dictionary in bytes.
+ * @param expression The query expression.
+ * @return true on success, false if the expression is invalid, refers to an
+ * unknown property or enum value, or the dictionary is malformed.
+ */
+bool BejQueryCompile(BejQuery *query, const uint8_t *dictionary, size_t size,
+                     const char *expression);
+
+/**
+ * @brief Evaluates a compiled query on one payload.
+ *
+ * @param query Pointer to the compiled query.
+ * @param payload Pointer to the BEJ payload.
+ * @param size The size of the payload in bytes.
+ * @param result Receives the values of the queried properties.
+ * @param matched Receives whether the payload matches.
+ * @return true if the payload could be scanned, false if it is malformed.
+ */
+bool BejQueryMatch(const BejQuery *query, const uint8_t *payload, size_t size,
+                   BejQueryResult *result, bool *matched);
+
+/**
+ * @brief Writes a match as one line of compact JSON: the payload id followed
+ * by every queried field, e.g. `{"id":"a.bin","CapacityMiB":16384}`.
+ *
+ * @param query Pointer to the compiled query.
+ * @param result Values returned by BejQueryMatch().
+ * @param id Identifier of the payload, escaped as a JSON string.
+ * @param out Output stream receiving the line.
+ */
+void BejQueryWriteMatch(const BejQuery *query, const BejQueryResult *result,
+                        const char *id, OutputStream *out);
+
+/**
+ * @brief Evaluates a query on many payload files in parallel and writes the
+ * matches, in input order, as NDJSON with the file paths as ids.
+ *
+ * @param query Pointer to the compiled query.
+ * @param paths Paths of the payload files.
+ * @param count Number of entries in `paths`.
+ * @param thread_count Number of worker threads.
+ * @param out Stream receiving the matches.
+ * @param stats Optional pointer receiving payload counters.
+ * @return true if every match was written, false on an output or memory
+ * error. Unreadable or malformed payloads are only counted as failed.
+ */
+bool BejQueryRunFiles(const BejQuery *query, char *const *paths,
+                      size_t count, size_t thread_count, FILE *out,
+                      BejQueryStats *stats);
+
+/**
+ * @brief Frees the memory held by a compiled query.
+ *
+ * @param query Pointer to the query.
+ */
+void BejQueryRelease(BejQuery *query);
+
+#endif
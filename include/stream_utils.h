@@ -1,6 +1,7 @@
 #ifndef STREAM_UTILS_H
 #define STREAM_UTILS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
@@ -20,10 +21,13 @@ typedef struct {
 /**
  * @struct OutputStream
  * @brief A utility structure for writing data to a fixed-size buffer.
+ *
+ * Writes that do not fit are dropped and `overflow` is set.
  */
 typedef struct {
   char data[OUTBUF_SIZE];
   size_t pos;
+  bool overflow;
 } OutputStream;
 
 /**
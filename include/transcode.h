@@ -0,0 +1,80 @@
+#ifndef TRANSCODE_H
+#define TRANSCODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dictionary.h"
+#include "stream_utils.h"
+
+/**
+ * @file transcode.h
+ * @brief Binary-to-binary rewriting of BEJ payloads between two versions of a
+ * schema dictionary.
+ *
+ * Properties and enum values are matched by name once, when the translation
+ * table is built. Transcoding then renumbers every tuple, copies leaf values
+ * verbatim and only re-encodes the NNInt lengths and counts of SETs and
+ * ARRAYs. Properties (or enum values) that have no counterpart of the same
+ * format in the target dictionary are dropped.
+ */
+
+#define BEJ_TRANSLATION_UNMAPPED UINT32_MAX
+
+/**
+ * @struct BejTranslation
+ * @brief Translation table between a source and a target dictionary.
+ *
+ * `map[i]` is the index in `target.entries` of the counterpart of
+ * `source.entries[i]`, or BEJ_TRANSLATION_UNMAPPED. A translation is never
+ * modified after BejTranslationCreate(), so it may be shared between threads.
+ */
+typedef struct {
+  CompiledDictionary source;
+  CompiledDictionary target;
+  uint32_t *map;
+  size_t unmapped;
+} BejTranslation;
+
+/**
+ * @brief Builds the translation table between two dictionaries.
+ *
+ * The dictionary bytes are copied, so the caller may free them afterwards.
+ *
+ * @param translation Pointer to the translation to initialize.
+ * @param source Pointer to the raw dictionary the payloads are encoded with.
+ * @param source_size The size of the source dictionary in bytes.
+ * @param target Pointer to the raw dictionary to transcode to.
+ * @param target_size The size of the target dictionary in bytes.
+ * @return true on success, false if a dictionary is malformed or memory
+ * could not be allocated.
+ */
+bool BejTranslationCreate(BejTranslation *translation, const uint8_t *source,
+                          size_t source_size, const uint8_t *target,
+                          size_t target_size);
+
+/**
+ * @brief Rewrites a payload encoded with the source dictionary into a
+ * payload for the target dictionary.
+ *
+ * @param translation Pointer to the translation table.
+ * @param payload Pointer to the source BEJ payload.
+ * @param size The size of the payload in bytes.
+ * @param out Output stream receiving the target payload.
+ * @param dropped Optional pointer receiving the number of properties and
+ * enum values that had no counterpart and were dropped.
+ * @return true on success, false if the payload is malformed or the output
+ * did not fit into the stream.
+ */
+bool BejTranscode(const BejTranslation *translation, const uint8_t *payload,
+                  size_t size, OutputStream *out, size_t *dropped);
+
+/**
+ * @brief Frees the memory held by a translation table.
+ *
+ * @param translation Pointer to the translation.
+ */
+void BejTranslationRelease(BejTranslation *translation);
+
+#endif
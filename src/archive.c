@@ -0,0 +1,440 @@
+#include "archive.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "decoder.h"
+#include "parallel.h"
+
+#define BEJ_ARCHIVE_DECODE_CHUNK 64
+#define BEJ_ARCHIVE_DECODE_CHUNKS_PER_THREAD 16
+
+static const char kArchiveMagic[4] = {'B', 'E', 'J', 'A'};
+static const char kIndexMagic[4] = {'B', 'E', 'J', 'X'};
+
+/**
+ * @brief Stores `value` as a little-endian integer of `size` bytes.
+ */
+static void ArchivePutInt(uint8_t *dst, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    dst[i] = (uint8_t)(value >> (i * 8));
+  }
+}
+
+/**
+ * @brief Loads a little-endian integer of `size` bytes.
+ */
+static uint64_t ArchiveGetInt(const uint8_t *src, size_t size) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; ++i) {
+    value |= (uint64_t)src[i] << (i * 8);
+  }
+  return value;
+}
+
+/**
+ * @brief Records the offset of a record in the writer's in-memory index.
+ */
+static bool ArchiveWriterPushOffset(BejArchiveWriter *writer,
+                                    uint64_t offset) {
+  if (writer->record_count == writer->capacity) {
+    size_t capacity = writer->capacity ? writer->capacity * 2 : 1024;
+    uint64_t *offsets = realloc(writer->offsets, capacity * sizeof(*offsets));
+    if (!offsets) return false;
+    writer->offsets = offsets;
+    writer->capacity = capacity;
+  }
+  writer->offsets[writer->record_count++] = offset;
+  return true;
+}
+
+/**
+ * @brief Checks that a footer's index exactly fills the space between the
+ * records and the footer of a `size`-byte archive.
+ *
+ * The bound is computed by subtraction so that no footer value can wrap.
+ */
+static bool ArchiveIndexFits(uint64_t size, uint64_t index_offset,
+                             uint64_t count) {
+  uint64_t space = size - BEJ_ARCHIVE_HEADER_SIZE - BEJ_ARCHIVE_FOOTER_SIZE;
+  return count <= space / 8 &&
+         index_offset == size - BEJ_ARCHIVE_FOOTER_SIZE - count * 8;
+}
+
+/**
+ * @brief Loads the index of an existing archive from its footer.
+ *
+ * @return true if a valid footer and index were found.
+ */
+static bool ArchiveWriterLoadIndex(BejArchiveWriter *writer, uint64_t size) {
+  uint8_t footer[BEJ_ARCHIVE_FOOTER_SIZE];
+  if (size < BEJ_ARCHIVE_HEADER_SIZE + BEJ_ARCHIVE_FOOTER_SIZE) return false;
+  if (fseeko(writer->file, (off_t)(size - BEJ_ARCHIVE_FOOTER_SIZE),
+             SEEK_SET) != 0 ||
+      fread(footer, 1, sizeof(footer), writer->file) != sizeof(footer) ||
+      memcmp(footer + 16, kIndexMagic, 4) != 0) {
+    return false;
+  }
+
+  uint64_t index_offset = ArchiveGetInt(footer, 8);
+  uint64_t count = ArchiveGetInt(footer + 8, 8);
+  if (!ArchiveIndexFits(size, index_offset, count) ||
+      fseeko(writer->file, (off_t)index_offset, SEEK_SET) != 0) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < count; ++i) {
+    uint8_t entry[8];
+    if (fread(entry, 1, sizeof(entry), writer->file) != sizeof(entry) ||
+        !ArchiveWriterPushOffset(writer, ArchiveGetInt(entry, 8))) {
+      writer->record_count = 0;
+      return false;
+    }
+  }
+  writer->end_offset = index_offset;
+  return true;
+}
+
+/**
+ * @brief Rebuilds the index of an archive without a valid footer by walking
+ * the records from the start. A trailing partial record is discarded.
+ */
+static bool ArchiveWriterScanRecords(BejArchiveWriter *writer,
+                                     uint64_t size) {
+  uint64_t pos = BEJ_ARCHIVE_HEADER_SIZE;
+  writer->record_count = 0;
+  while (pos + BEJ_ARCHIVE_RECORD_HEADER_SIZE <= size) {
+    uint8_t header[BEJ_ARCHIVE_RECORD_HEADER_SIZE];
+    if (fseeko(writer->file, (off_t)pos, SEEK_SET) != 0 ||
+        fread(header, 1, sizeof(header), writer->file) != sizeof(header)) {
+      return false;
+    }
+    uint64_t next = pos + BEJ_ARCHIVE_RECORD_HEADER_SIZE +
+                    ArchiveGetInt(header, 4);
+    if (next > size ||
+        ArchiveGetInt(header + 6, 2) != BEJ_ARCHIVE_RECORD_MARKER) {
+      break;
+    }
+    if (!ArchiveWriterPushOffset(writer, pos)) return false;
+    pos = next;
+  }
+  fprintf(stderr, "Warning: archive index missing, recovered %zu records\n",
+          writer->record_count);
+  writer->end_offset = pos;
+  return true;
+}
+
+bool BejArchiveWriterOpen(BejArchiveWriter *writer, const char *path) {
+  memset(writer, 0, sizeof(*writer));
+
+  writer->file = fopen(path, "r+b");
+  if (!writer->file && errno == ENOENT) {
+    writer->file = fopen(path, "w+b");
+    if (!writer->file) return false;
+
+    uint8_t header[BEJ_ARCHIVE_HEADER_SIZE];
+    memcpy(header, kArchiveMagic, 4);
+    ArchivePutInt(header + 4, BEJ_ARCHIVE_VERSION, 2);
+    ArchivePutInt(header + 6, 0, 2);
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) {
+      fclose(writer->file);
+      return false;
+    }
+    writer->end_offset = BEJ_ARCHIVE_HEADER_SIZE;
+    return true;
+  }
+  if (!writer->file) return false;
+
+  uint8_t header[BEJ_ARCHIVE_HEADER_SIZE];
+  struct stat st;
+  if (fread(header, 1, sizeof(header), writer->file) != sizeof(header) ||
+      memcmp(header, kArchiveMagic, 4) != 0 ||
+      ArchiveGetInt(header + 4, 2) != BEJ_ARCHIVE_VERSION ||
+      fstat(fileno(writer->file), &st) != 0) {
+    fprintf(stderr, "Error: %s is not a BEJ archive\n", path);
+    fclose(writer->file);
+    return false;
+  }
+
+  uint64_t size = (uint64_t)st.st_size;
+  if (!ArchiveWriterLoadIndex(writer, size) &&
+      !ArchiveWriterScanRecords(writer, size)) {
+    fclose(writer->file);
+    free(writer->offsets);
+    return false;
+  }
+
+  if (fflush(writer->file) != 0 ||
+      ftruncate(fileno(writer->file), (off_t)writer->end_offset) != 0 ||
+      fseeko(writer->file, (off_t)writer->end_offset, SEEK_SET) != 0) {
+    fclose(writer->file);
+    free(writer->offsets);
+    return false;
+  }
+  return true;
+}
+
+bool BejArchiveAppend(BejArchiveWriter *writer, uint16_t dictionary_id,
+                      uint64_t timestamp, const uint8_t *payload,
+                      size_t size) {
+  if (size > UINT32_MAX) return false;
+
+  uint8_t header[BEJ_ARCHIVE_RECORD_HEADER_SIZE];
+  ArchivePutInt(header, size, 4);
+  ArchivePutInt(header + 4, dictionary_id, 2);
+  ArchivePutInt(header + 6, BEJ_ARCHIVE_RECORD_MARKER, 2);
+  ArchivePutInt(header + 8, timestamp, 8);
+
+  if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header) ||
+      fwrite(payload, 1, size, writer->file) != size ||
+      !ArchiveWriterPushOffset(writer, writer->end_offset)) {
+    return false;
+  }
+  writer->end_offset += sizeof(header) + size;
+  return true;
+}
+
+bool BejArchiveWriterClose(BejArchiveWriter *writer) {
+  bool ok = true;
+  for (size_t i = 0; i < writer->record_count && ok; ++i) {
+    uint8_t entry[8];
+    ArchivePutInt(entry, writer->offsets[i], 8);
+    ok = fwrite(entry, 1, sizeof(entry), writer->file) == sizeof(entry);
+  }
+
+  uint8_t footer[BEJ_ARCHIVE_FOOTER_SIZE];
+  ArchivePutInt(footer, writer->end_offset, 8);
+  ArchivePutInt(footer + 8, writer->record_count, 8);
+  memcpy(footer + 16, kIndexMagic, 4);
+  ArchivePutInt(footer + 20, 0, 4);
+  ok = ok && fwrite(footer, 1, sizeof(footer), writer->file) == sizeof(footer);
+
+  ok = (fclose(writer->file) == 0) && ok;
+  free(writer->offsets);
+  memset(writer, 0, sizeof(*writer));
+  return ok;
+}
+
+bool BejArchiveOpen(BejArchive *archive, const char *path) {
+  memset(archive, 0, sizeof(*archive));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Error: cannot open %s\n", path);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < BEJ_ARCHIVE_HEADER_SIZE +
+                                                         BEJ_ARCHIVE_FOOTER_SIZE) {
+    fprintf(stderr, "Error: %s is not a BEJ archive\n", path);
+    close(fd);
+    return false;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+
+  const uint8_t *bytes = map;
+  const uint8_t *footer = bytes + size - BEJ_ARCHIVE_FOOTER_SIZE;
+  uint64_t index_offset = ArchiveGetInt(footer, 8);
+  uint64_t count = ArchiveGetInt(footer + 8, 8);
+  if (memcmp(bytes, kArchiveMagic, 4) != 0 ||
+      ArchiveGetInt(bytes + 4, 2) != BEJ_ARCHIVE_VERSION ||
+      memcmp(footer + 16, kIndexMagic, 4) != 0 ||
+      !ArchiveIndexFits(size, index_offset, count)) {
+    fprintf(stderr, "Error: %s has no valid index\n", path);
+    munmap(map, size);
+    return false;
+  }
+
+  archive->map = bytes;
+  archive->size = size;
+  archive->index = bytes + index_offset;
+  archive->record_count = (size_t)count;
+  return true;
+}
+
+bool BejArchiveGetRecord(const BejArchive *archive, size_t index,
+                         BejArchiveRecord *record) {
+  if (index >= archive->record_count) return false;
+
+  size_t index_offset = (size_t)(archive->index - archive->map);
+  uint64_t offset = ArchiveGetInt(archive->index + index * 8, 8);
+  if (offset < BEJ_ARCHIVE_HEADER_SIZE ||
+      offset + BEJ_ARCHIVE_RECORD_HEADER_SIZE > index_offset) {
+    return false;
+  }
+
+  const uint8_t *header = archive->map + offset;
+  uint32_t size = (uint32_t)ArchiveGetInt(header, 4);
+  if (offset + BEJ_ARCHIVE_RECORD_HEADER_SIZE + size > index_offset ||
+      ArchiveGetInt(header + 6, 2) != BEJ_ARCHIVE_RECORD_MARKER) {
+    return false;
+  }
+
+  record->payload = header + BEJ_ARCHIVE_RECORD_HEADER_SIZE;
+  record->size = size;
+  record->dictionary_id = (uint16_t)ArchiveGetInt(header + 4, 2);
+  record->timestamp = ArchiveGetInt(header + 8, 8);
+  return true;
+}
+
+void BejArchiveClose(BejArchive *archive) {
+  if (archive->map) munmap((void *)archive->map, archive->size);
+  memset(archive, 0, sizeof(*archive));
+}
+
+/**
+ * @struct ArchiveChunkOutput
+ * @brief NDJSON produced by one chunk of records.
+ */
+typedef struct {
+  char *data;
+  size_t len;
+  size_t capacity;
+  size_t failed;
+  bool error;
+} ArchiveChunkOutput;
+
+/**
+ * @struct ArchiveDecodeJob
+ * @brief State shared by the workers of BejArchiveDecodeAll().
+ */
+typedef struct {
+  const BejArchive *archive;
+  const InputStream *dictionaries;
+  size_t dictionary_count;
+  size_t first_record;
+  size_t end_record;
+  OutputStream *scratch;
+  ArchiveChunkOutput *chunks;
+} ArchiveDecodeJob;
+
+/**
+ * @brief Appends bytes to a chunk's output buffer.
+ */
+static void ArchiveChunkAppend(ArchiveChunkOutput *chunk, const char *buf,
+                               size_t len) {
+  if (chunk->error) return;
+  if (chunk->len + len > chunk->capacity) {
+    size_t capacity = chunk->capacity ? chunk->capacity : 4096;
+    while (capacity < chunk->len + len) capacity *= 2;
+    char *data = realloc(chunk->data, capacity);
+    if (!data) {
+      chunk->error = true;
+      return;
+    }
+    chunk->data = data;
+    chunk->capacity = capacity;
+  }
+  memcpy(chunk->data + chunk->len, buf, len);
+  chunk->len += len;
+}
+
+static void ArchiveDecodeChunk(void *ctx, size_t task, size_t worker) {
+  ArchiveDecodeJob *job = ctx;
+  ArchiveChunkOutput *chunk = &job->chunks[task];
+  OutputStream *json = &job->scratch[worker];
+  size_t first = job->first_record + task * BEJ_ARCHIVE_DECODE_CHUNK;
+  size_t end = first + BEJ_ARCHIVE_DECODE_CHUNK;
+  if (end > job->end_record) end = job->end_record;
+
+  chunk->len = 0;
+  chunk->failed = 0;
+  for (size_t i = first; i < end; ++i) {
+    BejArchiveRecord record;
+    bool decoded = false;
+    OutputStreamInit(json);
+    if (BejArchiveGetRecord(job->archive, i, &record) &&
+        record.dictionary_id < job->dictionary_count) {
+      InputStream payload = {record.payload, record.size, 0};
+      InputStream dict = job->dictionaries[record.dictionary_id];
+      dict.pos = 0;
+      decoded = BejDecodeCompact(json, &payload, &dict);
+    }
+    if (decoded) {
+      ArchiveChunkAppend(chunk, json->data, json->pos);
+    } else {
+      fprintf(stderr, "Error: archive record %zu could not be decoded\n", i);
+      ArchiveChunkAppend(chunk, "null", 4);
+      chunk->failed++;
+    }
+    ArchiveChunkAppend(chunk, "\n", 1);
+  }
+}
+
+/**
+ * @brief Asks the kernel to read ahead the records in [first, end).
+ */
+static void ArchiveReadAhead(const BejArchive *archive, size_t first,
+                             size_t end) {
+  if (first >= end) return;
+  uint64_t start = ArchiveGetInt(archive->index + first * 8, 8);
+  uint64_t stop = (end < archive->record_count)
+                      ? ArchiveGetInt(archive->index + end * 8, 8)
+                      : (uint64_t)(archive->index - archive->map);
+  if (start >= stop || stop > archive->size) return;
+
+  uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uintptr_t begin = (uintptr_t)(archive->map + start) & ~(page - 1);
+  madvise((void *)begin, (uintptr_t)(archive->map + stop) - begin,
+          MADV_WILLNEED);
+}
+
+bool BejArchiveDecodeAll(const BejArchive *archive,
+                         const InputStream *dictionaries,
+                         size_t dictionary_count, size_t thread_count,
+                         FILE *out, BejArchiveDecodeStats *stats) {
+  if (thread_count == 0) thread_count = 1;
+  size_t chunk_count = thread_count * BEJ_ARCHIVE_DECODE_CHUNKS_PER_THREAD;
+  size_t round_size = chunk_count * BEJ_ARCHIVE_DECODE_CHUNK;
+
+  ArchiveDecodeJob job = {archive, dictionaries, dictionary_count, 0, 0,
+                          NULL, NULL};
+  job.scratch = malloc(thread_count * sizeof(*job.scratch));
+  job.chunks = calloc(chunk_count, sizeof(*job.chunks));
+  bool ok = job.scratch && job.chunks;
+
+  BejArchiveDecodeStats local_stats = {0, 0};
+  madvise((void *)archive->map, archive->size, MADV_SEQUENTIAL);
+
+  for (size_t first = 0; ok && first < archive->record_count;
+       first += round_size) {
+    size_t end = first + round_size;
+    if (end > archive->record_count) end = archive->record_count;
+    size_t next_end = end + round_size;
+    if (next_end > archive->record_count) next_end = archive->record_count;
+    ArchiveReadAhead(archive, end, next_end);
+
+    job.first_record = first;
+    job.end_record = end;
+    size_t tasks =
+        (end - first + BEJ_ARCHIVE_DECODE_CHUNK - 1) / BEJ_ARCHIVE_DECODE_CHUNK;
+    ok = ParallelFor(tasks, thread_count, ArchiveDecodeChunk, &job);
+
+    for (size_t t = 0; ok && t < tasks; ++t) {
+      ArchiveChunkOutput *chunk = &job.chunks[t];
+      ok = !chunk->error &&
+           fwrite(chunk->data, 1, chunk->len, out) == chunk->len;
+      local_stats.failed += chunk->failed;
+    }
+    if (ok) local_stats.records = end;
+  }
+
+  if (job.chunks) {
+    for (size_t t = 0; t < chunk_count; ++t) free(job.chunks[t].data);
+  }
+  free(job.chunks);
+  free(job.scratch);
+
+  ok = (fflush(out) == 0) && ok;
+  if (stats) *stats = local_stats;
+  return ok;
+}
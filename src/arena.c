@@ -0,0 +1,93 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+void ArenaInit(Arena *arena, size_t block_size) {
+  arena->first = NULL;
+  arena->current = NULL;
+  arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+}
+
+/**
+ * @brief Makes `current` a block with at least `size` free bytes, reusing
+ * the blocks kept by the last reset when they are large enough.
+ */
+static ArenaBlock *ArenaNextBlock(Arena *arena, size_t size) {
+  ArenaBlock *next = arena->current ? arena->current->next : arena->first;
+  if (next && next->size >= size) {
+    next->used = 0;
+    arena->current = next;
+    return next;
+  }
+
+  size_t block_size = size > arena->block_size ? size : arena->block_size;
+  ArenaBlock *block = malloc(sizeof(*block) + block_size);
+  if (!block) return NULL;
+  block->size = block_size;
+  block->used = 0;
+  block->next = next;
+  if (arena->current) {
+    arena->current->next = block;
+  } else {
+    arena->first = block;
+  }
+  arena->current = block;
+  return block;
+}
+
+void *ArenaAlloc(Arena *arena, size_t size) {
+  size = ARENA_ALIGN(size ? size : 1);
+  ArenaBlock *block = arena->current;
+  if (!block || block->size - block->used < size) {
+    block = ArenaNextBlock(arena, size);
+    if (!block) return NULL;
+  }
+  void *ptr = block->data + block->used;
+  block->used += size;
+  return ptr;
+}
+
+void *ArenaGrow(Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+  ArenaBlock *block = arena->current;
+  size_t old_aligned = ARENA_ALIGN(old_size ? old_size : 1);
+  size_t new_aligned = ARENA_ALIGN(new_size ? new_size : 1);
+  if (ptr && block && new_aligned >= old_aligned &&
+      (uint8_t *)ptr + old_aligned == block->data + block->used &&
+      new_aligned - old_aligned <= block->size - block->used) {
+    block->used += new_aligned - old_aligned;
+    return ptr;
+  }
+
+  void *grown = ArenaAlloc(arena, new_size);
+  if (grown && ptr) {
+    memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+  }
+  return grown;
+}
+
+void ArenaReset(Arena *arena) {
+  arena->current = arena->first;
+  if (arena->first) arena->first->used = 0;
+}
+
+size_t ArenaReserved(const Arena *arena) {
+  size_t total = 0;
+  for (const ArenaBlock *block = arena->first; block; block = block->next) {
+    total += block->size;
+  }
+  return total;
+}
+
+void ArenaRelease(Arena *arena) {
+  ArenaBlock *block = arena->first;
+  while (block) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->first = NULL;
+  arena->current = NULL;
+}
@@ -0,0 +1,498 @@
+#include "batch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef BEJ_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * @brief Returns a monotonic timestamp in seconds.
+ */
+static double BatchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Grows a buffer to at least `size` bytes.
+ */
+static bool BatchReserve(uint8_t **data, size_t *capacity, size_t size) {
+  if (size <= *capacity) return true;
+  uint8_t *grown = realloc(*data, size);
+  if (!grown) return false;
+  *data = grown;
+  *capacity = size;
+  return true;
+}
+
+/**
+ * @brief Writes a whole buffer to a descriptor.
+ */
+static bool BatchWriteAll(int fd, const void *data, size_t size) {
+  const char *p = data;
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+/**
+ * @brief Decodes files with blocking stdio calls, one file at a time.
+ */
+static void BatchRunSync(BejDecoder *decoder, char *const *inputs,
+                         char *const *outputs, size_t count,
+                         BejBatchStats *stats) {
+  uint8_t *payload = NULL;
+  size_t capacity = 0;
+  for (size_t i = 0; i < count; ++i) {
+    bool ok = false;
+    FILE *in = fopen(inputs[i], "rb");
+    if (in && fseek(in, 0, SEEK_END) == 0) {
+      long size = ftell(in);
+      rewind(in);
+      const char *json;
+      size_t json_size;
+      ok = size >= 0 && BatchReserve(&payload, &capacity, (size_t)size) &&
+           fread(payload, 1, (size_t)size, in) == (size_t)size &&
+           BejDecoderDecode(decoder, payload, (size_t)size, &json,
+                            &json_size);
+      if (ok) {
+        stats->bytes_read += (size_t)size;
+        FILE *out = fopen(outputs[i], "w");
+        ok = out && fwrite(json, 1, json_size, out) == json_size;
+        if (out && fclose(out) != 0) ok = false;
+        if (ok) stats->bytes_written += json_size;
+      }
+    }
+    if (in) fclose(in);
+    if (!ok) {
+      fprintf(stderr, "Error: %s could not be decoded\n", inputs[i]);
+      stats->failed++;
+    }
+    stats->files++;
+  }
+  free(payload);
+}
+
+/**
+ * @brief Decodes files with pread/write, hinting the kernel to read the next
+ * `depth` inputs ahead.
+ */
+static void BatchRunPread(BejDecoder *decoder, char *const *inputs,
+                          char *const *outputs, size_t count, size_t depth,
+                          BejBatchStats *stats) {
+  size_t window = depth + 1;
+  int *fds = malloc(window * sizeof(*fds));
+  uint8_t *payload = NULL;
+  size_t capacity = 0;
+  size_t opened = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    if (!fds) {
+      stats->failed += count - i;
+      stats->files = count;
+      break;
+    }
+    while (opened < count && opened <= i + depth) {
+      int fd = open(inputs[opened], O_RDONLY);
+      if (fd >= 0) posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+      fds[opened % window] = fd;
+      opened++;
+    }
+
+    int fd = fds[i % window];
+    struct stat st;
+    size_t size = 0;
+    bool ok = fd >= 0 && fstat(fd, &st) == 0 && st.st_size >= 0;
+    if (ok) {
+      size = (size_t)st.st_size;
+      ok = BatchReserve(&payload, &capacity, size);
+    }
+    for (size_t done = 0; ok && done < size;) {
+      ssize_t n = pread(fd, payload + done, size - done, (off_t)done);
+      if (n < 0 && errno == EINTR) continue;
+      ok = n > 0;
+      if (ok) done += (size_t)n;
+    }
+    if (fd >= 0) close(fd);
+
+    const char *json;
+    size_t json_size;
+    ok = ok && BejDecoderDecode(decoder, payload, size, &json, &json_size);
+    if (ok) {
+      stats->bytes_read += size;
+      int out = open(outputs[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      ok = out >= 0 && BatchWriteAll(out, json, json_size);
+      if (out >= 0 && close(out) != 0) ok = false;
+      if (ok) stats->bytes_written += json_size;
+    }
+    if (!ok) {
+      fprintf(stderr, "Error: %s could not be decoded\n", inputs[i]);
+      stats->failed++;
+    }
+    stats->files++;
+  }
+
+  free(payload);
+  free(fds);
+}
+
+#ifdef BEJ_HAVE_IO_URING
+
+/**
+ * @struct BatchRing
+ * @brief A minimal io_uring instance driven through raw system calls.
+ */
+typedef struct {
+  int fd;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sq_map;
+  size_t sq_map_size;
+  void *cq_map;
+  size_t cq_map_size;
+  size_t sqes_size;
+  unsigned to_submit;
+} BatchRing;
+
+static void BatchRingExit(BatchRing *ring) {
+  if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_map && ring->cq_map != ring->sq_map) {
+    munmap(ring->cq_map, ring->cq_map_size);
+  }
+  if (ring->sq_map) munmap(ring->sq_map, ring->sq_map_size);
+  if (ring->fd >= 0) close(ring->fd);
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+static bool BatchRingInit(BatchRing *ring, unsigned entries) {
+  struct io_uring_params params;
+  memset(ring, 0, sizeof(*ring));
+  memset(&params, 0, sizeof(params));
+  ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0) return false;
+
+  ring->sq_map_size =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_map_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_map && ring->cq_map_size > ring->sq_map_size) {
+    ring->sq_map_size = ring->cq_map_size;
+  }
+
+  ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_map == MAP_FAILED) {
+    ring->sq_map = NULL;
+    BatchRingExit(ring);
+    return false;
+  }
+  ring->cq_map = single_map
+                     ? ring->sq_map
+                     : mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_CQ_RING);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->cq_map == MAP_FAILED || ring->sqes == MAP_FAILED) {
+    if (ring->cq_map == MAP_FAILED) ring->cq_map = NULL;
+    if (ring->sqes == MAP_FAILED) ring->sqes = NULL;
+    BatchRingExit(ring);
+    return false;
+  }
+
+  uint8_t *sq = ring->sq_map;
+  uint8_t *cq = ring->cq_map;
+  ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+  ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+  return true;
+}
+
+/**
+ * @brief Queues a read or write of `len` bytes at file offset `offset`.
+ *
+ * The caller guarantees a free submission slot: every batch slot has at
+ * most one operation in flight and there are no more slots than entries.
+ */
+static void BatchRingQueue(BatchRing *ring, uint8_t opcode, int fd,
+                           void *buf, size_t len, uint64_t offset,
+                           uint64_t user_data) {
+  unsigned tail = *ring->sq_tail;
+  unsigned index = tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)buf;
+  sqe->len = (uint32_t)len;
+  sqe->off = offset;
+  sqe->user_data = user_data;
+  ring->sq_array[index] = index;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring->to_submit++;
+}
+
+/**
+ * @brief Submits queued operations and waits for at least one completion.
+ */
+static bool BatchRingSubmitAndWait(BatchRing *ring) {
+  while (true) {
+    long rc = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, 1,
+                      IORING_ENTER_GETEVENTS, NULL, 0);
+    if (rc >= 0) {
+      ring->to_submit -= (unsigned)rc;
+      return true;
+    }
+    if (errno != EINTR) return false;
+  }
+}
+
+/**
+ * @enum BatchSlotState
+ * @brief Stage of the file owned by a BatchSlot.
+ */
+typedef enum { SLOT_FREE, SLOT_READING, SLOT_WRITING } BatchSlotState;
+
+/**
+ * @struct BatchSlot
+ * @brief One file with I/O in flight. The buffer holds the payload while
+ * reading and the JSON while writing.
+ */
+typedef struct {
+  BatchSlotState state;
+  size_t file;
+  int fd;
+  uint8_t *data;
+  size_t capacity;
+  size_t size;
+  size_t done;
+} BatchSlot;
+
+/**
+ * @brief Queues the next transfer of a slot.
+ */
+static void BatchSlotQueue(BatchRing *ring, BatchSlot *slot, size_t index) {
+  uint8_t opcode =
+      slot->state == SLOT_READING ? IORING_OP_READ : IORING_OP_WRITE;
+  BatchRingQueue(ring, opcode, slot->fd, slot->data + slot->done,
+                 slot->size - slot->done, slot->done, index);
+}
+
+/**
+ * @brief Ends the work on a slot's file and frees the slot.
+ */
+static void BatchSlotFinish(BatchSlot *slot, bool ok, char *const *inputs,
+                            BejBatchStats *stats) {
+  if (slot->fd >= 0) close(slot->fd);
+  slot->fd = -1;
+  if (!ok) {
+    fprintf(stderr, "Error: %s could not be decoded\n", inputs[slot->file]);
+    stats->failed++;
+  } else {
+    stats->bytes_written += slot->size;
+  }
+  stats->files++;
+  slot->state = SLOT_FREE;
+}
+
+/**
+ * @brief Opens the next input in a free slot and queues its read.
+ */
+static bool BatchSlotStartRead(BatchRing *ring, BatchSlot *slot, size_t index,
+                               size_t file, char *const *inputs) {
+  struct stat st;
+  slot->file = file;
+  slot->fd = open(inputs[file], O_RDONLY);
+  if (slot->fd < 0 || fstat(slot->fd, &st) != 0 || st.st_size <= 0 ||
+      !BatchReserve(&slot->data, &slot->capacity, (size_t)st.st_size)) {
+    return false;
+  }
+  slot->state = SLOT_READING;
+  slot->size = (size_t)st.st_size;
+  slot->done = 0;
+  BatchSlotQueue(ring, slot, index);
+  return true;
+}
+
+/**
+ * @brief Decodes a fully read payload and queues the write of its JSON.
+ */
+static bool BatchSlotStartWrite(BatchRing *ring, BatchSlot *slot,
+                                size_t index, BejDecoder *decoder,
+                                char *const *outputs, BejBatchStats *stats) {
+  close(slot->fd);
+  slot->fd = -1;
+  stats->bytes_read += slot->size;
+
+  const char *json;
+  size_t json_size;
+  if (!BejDecoderDecode(decoder, slot->data, slot->size, &json, &json_size) ||
+      !BatchReserve(&slot->data, &slot->capacity, json_size)) {
+    return false;
+  }
+  memcpy(slot->data, json, json_size);
+  slot->fd = open(outputs[slot->file], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (slot->fd < 0) return false;
+  slot->state = SLOT_WRITING;
+  slot->size = json_size;
+  slot->done = 0;
+  BatchSlotQueue(ring, slot, index);
+  return true;
+}
+
+/**
+ * @brief Decodes files while up to `depth` reads and writes are in flight.
+ *
+ * @return false if io_uring could not be set up, in which case nothing was
+ * processed.
+ */
+static bool BatchRunUring(BejDecoder *decoder, char *const *inputs,
+                          char *const *outputs, size_t count, size_t depth,
+                          BejBatchStats *stats) {
+  BatchRing ring;
+  if (!BatchRingInit(&ring, (unsigned)depth)) return false;
+  BatchSlot *slots = calloc(depth, sizeof(*slots));
+  if (!slots) {
+    BatchRingExit(&ring);
+    return false;
+  }
+  for (size_t s = 0; s < depth; ++s) slots[s].fd = -1;
+
+  size_t next = 0;
+  size_t in_flight = 0;
+  while (stats->files < count) {
+    for (size_t s = 0; s < depth && next < count; ++s) {
+      if (slots[s].state != SLOT_FREE) continue;
+      if (BatchSlotStartRead(&ring, &slots[s], s, next++, inputs)) {
+        in_flight++;
+      } else {
+        BatchSlotFinish(&slots[s], false, inputs, stats);
+      }
+    }
+    if (in_flight == 0) continue;
+    if (!BatchRingSubmitAndWait(&ring)) break;
+
+    unsigned head = *ring.cq_head;
+    unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+      size_t index = (size_t)cqe->user_data;
+      BatchSlot *slot = &slots[index];
+      bool ok = cqe->res > 0;
+      if (ok) slot->done += (size_t)cqe->res;
+
+      if (ok && slot->done < slot->size) {
+        BatchSlotQueue(&ring, slot, index);
+        continue;
+      }
+      if (ok && slot->state == SLOT_READING) {
+        ok = BatchSlotStartWrite(&ring, slot, index, decoder, outputs,
+                                 stats);
+        if (ok) continue;
+      }
+      BatchSlotFinish(slot, ok, inputs, stats);
+      in_flight--;
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  // Only reached early if io_uring_enter() itself failed.
+  for (size_t s = 0; s < depth; ++s) {
+    if (slots[s].state != SLOT_FREE) {
+      BatchSlotFinish(&slots[s], false, inputs, stats);
+    }
+    free(slots[s].data);
+  }
+  stats->failed += count - stats->files;
+  stats->files = count;
+  free(slots);
+  BatchRingExit(&ring);
+  return true;
+}
+
+#endif
+
+bool BejBatchUringAvailable(void) {
+#ifdef BEJ_HAVE_IO_URING
+  BatchRing ring;
+  if (!BatchRingInit(&ring, 1)) return false;
+  BatchRingExit(&ring);
+  return true;
+#else
+  return false;
+#endif
+}
+
+const char *BejBatchBackendName(BejBatchBackend backend) {
+  switch (backend) {
+    case BEJ_BATCH_SYNC:
+      return "sync";
+    case BEJ_BATCH_PREAD:
+      return "pread";
+    case BEJ_BATCH_URING:
+      return "io_uring";
+  }
+  return "unknown";
+}
+
+bool BejBatchDecodeFiles(BejDecoder *decoder, char *const *inputs,
+                         char *const *outputs, size_t count,
+                         const BejBatchOptions *options,
+                         BejBatchStats *stats) {
+  BejBatchStats local_stats;
+  memset(&local_stats, 0, sizeof(local_stats));
+  local_stats.backend = options->backend;
+  size_t depth = options->queue_depth ? options->queue_depth
+                                      : BEJ_BATCH_DEFAULT_QUEUE_DEPTH;
+  double start = BatchNow();
+
+  bool done = false;
+#ifdef BEJ_HAVE_IO_URING
+  if (options->backend == BEJ_BATCH_URING) {
+    done = BatchRunUring(decoder, inputs, outputs, count, depth,
+                         &local_stats);
+  }
+#endif
+  if (!done && options->backend == BEJ_BATCH_SYNC) {
+    BatchRunSync(decoder, inputs, outputs, count, &local_stats);
+  } else if (!done) {
+    local_stats.backend = BEJ_BATCH_PREAD;
+    BatchRunPread(decoder, inputs, outputs, count, depth, &local_stats);
+  }
+
+  local_stats.seconds = BatchNow() - start;
+  if (stats) *stats = local_stats;
+  return local_stats.failed == 0;
+}
@@ -0,0 +1,235 @@
+#include "decode_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @struct CacheEntry
+ * @brief One cached subtree: its raw bytes followed by its JSON.
+ *
+ * Entries are chained per hash bucket and kept on a doubly linked list in
+ * order of use, most recent first.
+ */
+typedef struct CacheEntry {
+  struct CacheEntry *bucket_next;
+  struct CacheEntry *prev;
+  struct CacheEntry *next;
+  uint64_t hash;
+  BejDecodeCacheKey key;
+  size_t raw_size;
+  size_t fragment_size;
+  uint8_t data[];
+} CacheEntry;
+
+struct BejDecodeCache {
+  CacheEntry **buckets;
+  size_t bucket_count;
+  CacheEntry *head;
+  CacheEntry *tail;
+  size_t min_subtree_size;
+  BejDecodeCacheStats stats;
+};
+
+#define CACHE_INITIAL_BUCKETS 256
+
+static uint64_t CacheMix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+uint64_t BejDecodeCacheHash(const void *data, size_t size, uint64_t seed) {
+  const uint8_t *p = data;
+  uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ULL);
+  while (size >= 8) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    h = (h ^ CacheMix(word)) * 0x9e3779b97f4a7c15ULL;
+    p += 8;
+    size -= 8;
+  }
+  uint64_t tail = 0;
+  for (size_t i = 0; i < size; ++i) tail |= (uint64_t)p[i] << (i * 8);
+  return CacheMix(h ^ tail);
+}
+
+static uint64_t CacheKeyHash(const BejDecodeCacheKey *key,
+                             const uint8_t *raw, size_t raw_size) {
+  uint64_t h = CacheMix(key->dictionary ^ CacheMix(key->path + key->style));
+  return BejDecodeCacheHash(raw, raw_size, h);
+}
+
+static size_t CacheEntryCharge(const CacheEntry *entry) {
+  return sizeof(*entry) + entry->raw_size + entry->fragment_size +
+         sizeof(CacheEntry *);
+}
+
+BejDecodeCache *BejDecodeCacheCreate(size_t max_bytes,
+                                     size_t min_subtree_size) {
+  BejDecodeCache *cache = calloc(1, sizeof(*cache));
+  if (!cache) return NULL;
+  cache->buckets = calloc(CACHE_INITIAL_BUCKETS, sizeof(*cache->buckets));
+  if (!cache->buckets) {
+    free(cache);
+    return NULL;
+  }
+  cache->bucket_count = CACHE_INITIAL_BUCKETS;
+  cache->min_subtree_size = min_subtree_size;
+  cache->stats.max_bytes = max_bytes;
+  return cache;
+}
+
+size_t BejDecodeCacheMinSubtree(const BejDecodeCache *cache) {
+  return cache->min_subtree_size;
+}
+
+static void CacheUnlink(BejDecodeCache *cache, CacheEntry *entry) {
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+  } else {
+    cache->head = entry->next;
+  }
+  if (entry->next) {
+    entry->next->prev = entry->prev;
+  } else {
+    cache->tail = entry->prev;
+  }
+}
+
+static void CachePushFront(BejDecodeCache *cache, CacheEntry *entry) {
+  entry->prev = NULL;
+  entry->next = cache->head;
+  if (cache->head) cache->head->prev = entry;
+  cache->head = entry;
+  if (!cache->tail) cache->tail = entry;
+}
+
+/**
+ * @brief Removes the least recently used entry.
+ */
+static void CacheEvict(BejDecodeCache *cache) {
+  CacheEntry *victim = cache->tail;
+  CacheEntry **link = &cache->buckets[victim->hash & (cache->bucket_count - 1)];
+  while (*link != victim) link = &(*link)->bucket_next;
+  *link = victim->bucket_next;
+
+  CacheUnlink(cache, victim);
+  cache->stats.bytes -= CacheEntryCharge(victim);
+  cache->stats.entries--;
+  cache->stats.evictions++;
+  free(victim);
+}
+
+/**
+ * @brief Doubles the bucket array once the average chain gets longer than
+ * one entry.
+ */
+static void CacheGrow(BejDecodeCache *cache) {
+  size_t count = cache->bucket_count * 2;
+  CacheEntry **buckets = calloc(count, sizeof(*buckets));
+  if (!buckets) return;
+  for (size_t b = 0; b < cache->bucket_count; ++b) {
+    CacheEntry *entry = cache->buckets[b];
+    while (entry) {
+      CacheEntry *next = entry->bucket_next;
+      size_t slot = entry->hash & (count - 1);
+      entry->bucket_next = buckets[slot];
+      buckets[slot] = entry;
+      entry = next;
+    }
+  }
+  free(cache->buckets);
+  cache->buckets = buckets;
+  cache->bucket_count = count;
+}
+
+const char *BejDecodeCacheLookup(BejDecodeCache *cache,
+                                 const BejDecodeCacheKey *key,
+                                 const uint8_t *raw, size_t raw_size,
+                                 size_t *fragment_size) {
+  uint64_t hash = CacheKeyHash(key, raw, raw_size);
+  CacheEntry *entry = cache->buckets[hash & (cache->bucket_count - 1)];
+  for (; entry; entry = entry->bucket_next) {
+    if (entry->hash == hash && entry->raw_size == raw_size &&
+        entry->key.dictionary == key->dictionary &&
+        entry->key.path == key->path && entry->key.style == key->style &&
+        memcmp(entry->data, raw, raw_size) == 0) {
+      break;
+    }
+  }
+  if (!entry) {
+    cache->stats.misses++;
+    return NULL;
+  }
+
+  cache->stats.hits++;
+  if (cache->head != entry) {
+    CacheUnlink(cache, entry);
+    CachePushFront(cache, entry);
+  }
+  *fragment_size = entry->fragment_size;
+  return (const char *)entry->data + entry->raw_size;
+}
+
+bool BejDecodeCacheInsert(BejDecodeCache *cache, const BejDecodeCacheKey *key,
+                          const uint8_t *raw, size_t raw_size,
+                          const char *fragment, size_t fragment_size) {
+  CacheEntry *entry = malloc(sizeof(*entry) + raw_size + fragment_size);
+  if (!entry) return false;
+  entry->hash = CacheKeyHash(key, raw, raw_size);
+  entry->key = *key;
+  entry->raw_size = raw_size;
+  entry->fragment_size = fragment_size;
+
+  size_t charge = CacheEntryCharge(entry);
+  if (charge > cache->stats.max_bytes / 8) {
+    free(entry);
+    return false;
+  }
+  memcpy(entry->data, raw, raw_size);
+  memcpy(entry->data + raw_size, fragment, fragment_size);
+
+  while (cache->tail && cache->stats.bytes + charge > cache->stats.max_bytes) {
+    CacheEvict(cache);
+  }
+  if (cache->stats.entries >= cache->bucket_count) CacheGrow(cache);
+
+  size_t slot = entry->hash & (cache->bucket_count - 1);
+  entry->bucket_next = cache->buckets[slot];
+  cache->buckets[slot] = entry;
+  CachePushFront(cache, entry);
+  cache->stats.bytes += charge;
+  cache->stats.entries++;
+  cache->stats.insertions++;
+  return true;
+}
+
+void BejDecodeCacheGetStats(const BejDecodeCache *cache,
+                            BejDecodeCacheStats *stats) {
+  *stats = cache->stats;
+}
+
+void BejDecodeCacheClear(BejDecodeCache *cache) {
+  CacheEntry *entry = cache->head;
+  while (entry) {
+    CacheEntry *next = entry->next;
+    free(entry);
+    entry = next;
+  }
+  memset(cache->buckets, 0, cache->bucket_count * sizeof(*cache->buckets));
+  cache->head = NULL;
+  cache->tail = NULL;
+  size_t max_bytes = cache->stats.max_bytes;
+  memset(&cache->stats, 0, sizeof(cache->stats));
+  cache->stats.max_bytes = max_bytes;
+}
+
+void BejDecodeCacheDestroy(BejDecodeCache *cache) {
+  if (!cache) return;
+  BejDecodeCacheClear(cache);
+  free(cache->buckets);
+  free(cache);
+}
@@ -2,10 +2,13 @@
 
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "bej_types.h"
+#include "decode_cache.h"
 #include "dictionary.h"
+#include "iovec_stream.h"
 #include "json_writer.h"
 #include "stream_utils.h"
 
@@ -15,55 +18,239 @@
  * @param stream Pointer to the InputStream.
  * @return The unpacked integer value.
  */
-static uint64_t BejUnpackNNInt(InputStream *stream) {
+uint64_t BejUnpackNNInt(InputStream *stream) {
   uint8_t num_bytes = (uint8_t)StreamReadInt(stream, 1);
   return StreamReadInt(stream, num_bytes);
 }
 
 /**
- * @brief Finds a dictionary entry by its sequence number.
+ * @struct DecodeContext
+ * @brief State shared by every level of a single decode.
+ *
+ * Exactly one of `out` and `gather` is set. In gather mode strings that live
+ * in the payload or dictionary are referenced instead of copied. In compact
+ * mode no indentation is written, so a document fits on a single line. When
+ * `compiled` is set, subsets are looked up there instead of being parsed from
+ * `schema_dict`. When `cache` is set (only together with `out`), objects and
+ * arrays are looked up in it by `dictionary_id` and `path`, the hash of the
+ * sequence numbers leading to the element being decoded.
+ */
+typedef struct {
+  OutputStream *out;
+  IovecStream *gather;
+  InputStream *schema_dict;
+  const CompiledDictionary *compiled;
+  bool compact;
+  BejDecodeCache *cache;
+  uint64_t dictionary_id;
+  uint64_t path;
+} DecodeContext;
+
+/**
+ * @brief Copies bytes to the decode output.
+ */
+static void DecodeWrite(DecodeContext *ctx, const char *buf, size_t len) {
+  if (ctx->gather) {
+    IovecStreamWrite(ctx->gather, buf, len);
+  } else {
+    OutputStreamWrite(ctx->out, buf, len);
+  }
+}
+
+/**
+ * @brief Writes bytes that outlive the decode, referencing them in gather
+ * mode.
+ */
+static void DecodeWriteRef(DecodeContext *ctx, const char *buf, size_t len) {
+  if (ctx->gather) {
+    IovecStreamWriteRef(ctx->gather, buf, len);
+  } else {
+    OutputStreamWrite(ctx->out, buf, len);
+  }
+}
+
+/**
+ * @brief Writes an escaped JSON string literal, referencing the unescaped
+ * runs in gather mode.
+ */
+static void DecodeWriteString(DecodeContext *ctx, const char *text,
+                              size_t len) {
+  if (ctx->gather) {
+    JsonGatherWriteString(ctx->gather, text, len);
+  } else {
+    JsonWriteString(ctx->out, text, len);
+  }
+}
+
+/**
+ * @brief Writes indentation to the decode output.
+ */
+static void DecodeWriteIndent(DecodeContext *ctx, int indent_level) {
+  if (ctx->compact) return;
+  if (ctx->gather) {
+    JsonGatherWriteIndent(ctx->gather, indent_level);
+  } else {
+    JsonWriteIndent(ctx->out, indent_level);
+  }
+}
+
+/**
+ * @struct DecodeSubset
+ * @brief Children of a dictionary entry: a slice of the compiled dictionary
+ * when `entries` is set, otherwise the location of the subset in the raw
+ * dictionary, which is searched in place so subsets of any size decode
+ * without a buffer.
+ */
+typedef struct {
+  const DictionaryEntry *entries;
+  uint32_t offset;
+  size_t count;
+} DecodeSubset;
+
+/**
+ * @brief Returns the child subset of `entry`.
+ */
+static bool DecodeLoadSubset(DecodeContext *ctx, const DictionaryEntry *entry,
+                             DecodeSubset *subset) {
+  subset->entries = NULL;
+  subset->offset = entry->offset;
+  subset->count = entry->child_count;
+  if (!ctx->compiled || entry->child_count == 0) return true;
+  return DictionaryFindSubset(ctx->compiled, entry->offset,
+                              entry->child_count, &subset->entries,
+                              &subset->count);
+}
+
+/**
+ * @brief Finds the entry with sequence number `seq` in a subset. Entries of
+ * the raw dictionary are parsed into `scratch`.
  *
- * @param entries Pointer to the array of dictionary entries.
- * @param count The number of entries in the array.
- * @param seq The sequence number to search for.
  * @return Pointer to the found DictionaryEntry, or NULL if not found.
  */
-static DictionaryEntry *find_entry_by_seq(DictionaryEntry *entries,
-                                          size_t count, uint16_t seq) {
-  for (size_t i = 0; i < count; ++i) {
-    if (entries[i].sequence_number == seq) {
-      return &entries[i];
-    }
+static const DictionaryEntry *DecodeFindEntry(DecodeContext *ctx,
+                                              const DecodeSubset *subset,
+                                              uint64_t seq,
+                                              DictionaryEntry *scratch) {
+  if (ctx->compiled) {
+    return DictionaryFindEntry(subset->entries, subset->count, seq);
   }
-  return NULL;
+  return DictionaryFindRawEntry(ctx->schema_dict->data, ctx->schema_dict->size,
+                                subset->offset, (uint32_t)subset->count, seq,
+                                scratch)
+             ? scratch
+             : NULL;
 }
 
 /**
  * @brief Writes the JSON key for a given dictionary entry to the output stream.
  *
- * @param output_stream Pointer to the OutputStream.
+ * @param ctx Pointer to the DecodeContext.
  * @param entry Pointer to the DictionaryEntry.
  * @param is_array_item Flag indicating if the element is inside an array.
  */
-static void BejDecodeName(OutputStream *output_stream,
-                          const DictionaryEntry *entry, bool is_array_item,
-                          bool add_name) {
+static void BejDecodeName(DecodeContext *ctx, const DictionaryEntry *entry,
+                          bool is_array_item, bool add_name) {
   if (add_name && !is_array_item && entry && entry->name &&
       entry->name[0] != '\0') {
-    OutputStreamWrite(output_stream, "\"", 1);
-    OutputStreamWrite(output_stream, entry->name, strlen(entry->name));
-    OutputStreamWrite(output_stream, "\": ", 3);
+    DecodeWrite(ctx, "\"", 1);
+    DecodeWriteRef(ctx, entry->name, strlen(entry->name));
+    if (ctx->compact) {
+      DecodeWrite(ctx, "\":", 2);
+    } else {
+      DecodeWrite(ctx, "\": ", 3);
+    }
   }
 }
 
+static bool BejDecode_element(DecodeContext *ctx, InputStream *input_stream,
+                              const DecodeSubset *subset, int indent_level,
+                              bool is_array_item, bool add_name);
+
+/**
+ * @brief Decodes the value of a SET or ARRAY element, after its length.
+ */
+static bool BejDecodeContainer(DecodeContext *ctx, InputStream *input_stream,
+                               const DictionaryEntry *entry, uint8_t format,
+                               int indent_level) {
+  bool is_set = format == BEJ_FORMAT_SET;
+  uint64_t count = BejUnpackNNInt(input_stream);
+  DecodeWrite(ctx, is_set ? "{" : "[", 1);
+
+  DecodeSubset children;
+  if (!DecodeLoadSubset(ctx, entry, &children)) return false;
+
+  for (uint64_t i = 0; i < count; ++i) {
+    if (i > 0) DecodeWrite(ctx, ",", 1);
+
+    if (!is_set) DecodeWriteIndent(ctx, indent_level + 1);
+
+    if (!BejDecode_element(ctx, input_stream, &children, indent_level + 1,
+                           !is_set, is_set)) {
+      return false;
+    }
+  }
+
+  if (count > 0) DecodeWriteIndent(ctx, indent_level);
+
+  DecodeWrite(ctx, is_set ? "}" : "]", 1);
+  return true;
+}
+
+/**
+ * @brief Decodes a SET or ARRAY value through the decode cache.
+ *
+ * On a hit the cached JSON is copied and the `length` value bytes are
+ * skipped. On a miss the value is decoded normally and, if it consumed
+ * exactly `length` bytes, the produced JSON is stored.
+ */
+static bool BejDecodeCachedContainer(DecodeContext *ctx,
+                                     InputStream *input_stream,
+                                     const DictionaryEntry *entry,
+                                     uint8_t format, uint32_t seq_num,
+                                     uint64_t length, int indent_level) {
+  uint64_t parent_path = ctx->path;
+  uint64_t path = BejDecodeCacheHash(&seq_num, sizeof(seq_num), parent_path);
+  const uint8_t *raw = input_stream->data + input_stream->pos;
+  size_t start = input_stream->pos;
+  if (length < BejDecodeCacheMinSubtree(ctx->cache) ||
+      length > input_stream->size - start) {
+    ctx->path = path;
+    bool ok = BejDecodeContainer(ctx, input_stream, entry, format,
+                                 indent_level);
+    ctx->path = parent_path;
+    return ok;
+  }
+
+  BejDecodeCacheKey key = {
+      ctx->dictionary_id, path,
+      (uint32_t)indent_level << 5 | (uint32_t)format << 1 | ctx->compact};
+  size_t fragment_size;
+  const char *fragment =
+      BejDecodeCacheLookup(ctx->cache, &key, raw, length, &fragment_size);
+  if (fragment) {
+    OutputStreamWrite(ctx->out, fragment, fragment_size);
+    input_stream->pos += length;
+    return true;
+  }
+
+  size_t out_start = ctx->out->pos;
+  ctx->path = path;
+  bool ok = BejDecodeContainer(ctx, input_stream, entry, format,
+                               indent_level);
+  ctx->path = parent_path;
+  if (ok && !ctx->out->overflow && input_stream->pos - start == length) {
+    BejDecodeCacheInsert(ctx->cache, &key, raw, length,
+                         ctx->out->data + out_start,
+                         ctx->out->pos - out_start);
+  }
+  return ok;
+}
+
 /**
  * @brief Decodes a single BEJ element (property) from the stream.
  */
-static bool BejDecode_element(OutputStream *output_stream,
-                              InputStream *input_stream,
-                              InputStream *schema_dict,
-                              DictionaryEntry *current_entries,
-                              size_t entry_count, int indent_level,
+static bool BejDecode_element(DecodeContext *ctx, InputStream *input_stream,
+                              const DecodeSubset *subset, int indent_level,
                               bool is_array_item, bool add_name) {
   if (input_stream->pos >= input_stream->size) return true;
 
@@ -75,8 +262,9 @@ static bool BejDecode_element(OutputStream *output_stream,
 
   uint64_t length = BejUnpackNNInt(input_stream);
 
-  DictionaryEntry *entry = find_entry_by_seq(current_entries, entry_count,
-                                             is_array_item ? 0 : seq_num);
+  DictionaryEntry scratch;
+  const DictionaryEntry *entry =
+      DecodeFindEntry(ctx, subset, is_array_item ? 0 : seq_num, &scratch);
 
   if (!entry) {
     fprintf(stderr, "Error: Dictionary entry not found for seq %u\n",
@@ -85,115 +273,61 @@ static bool BejDecode_element(OutputStream *output_stream,
   }
 
   if (add_name && !is_array_item) {
-    JsonWriteIndent(output_stream, indent_level);
-    BejDecodeName(output_stream, entry, is_array_item, add_name);
+    DecodeWriteIndent(ctx, indent_level);
+    BejDecodeName(ctx, entry, is_array_item, add_name);
   }
 
   switch (format) {
-    case BEJ_FORMAT_SET: {
-      uint64_t count = BejUnpackNNInt(input_stream);
-      OutputStreamWrite(output_stream, "{", 1);
-
-      DictionaryEntry child_entries[MAX_DICT_ENTRIES];
-      size_t child_entry_count;
-      if (!LoadDictionarySubsetIntoBuffer(schema_dict->data, schema_dict->size,
-                                          entry->offset, entry->child_count,
-                                          child_entries, &child_entry_count)) {
-        return false;
-      }
-
-      for (uint64_t i = 0; i < count; ++i) {
-        if (i > 0) OutputStreamWrite(output_stream, ",", 1);
-
-        if (!BejDecode_element(output_stream, input_stream, schema_dict,
-                               child_entries, child_entry_count,
-                               indent_level + 1, false, true)) {
-          return false;
-        }
-      }
-
-      if (count > 0) {
-        JsonWriteIndent(output_stream, indent_level);
+    case BEJ_FORMAT_SET:
+    case BEJ_FORMAT_ARRAY:
+      if (ctx->cache) {
+        return BejDecodeCachedContainer(ctx, input_stream, entry, format,
+                                        is_array_item ? 0 : seq_num, length,
+                                        indent_level);
       }
-      OutputStreamWrite(output_stream, "}", 1);
-      return true;
-    }
-    case BEJ_FORMAT_ARRAY: {
-      uint64_t array_member_count = BejUnpackNNInt(input_stream);
-      OutputStreamWrite(output_stream, "[", 1);
-
-      DictionaryEntry child_entries[MAX_DICT_ENTRIES];
-      size_t child_entry_count;
-      if (!LoadDictionarySubsetIntoBuffer(schema_dict->data, schema_dict->size,
-                                          entry->offset, entry->child_count,
-                                          child_entries, &child_entry_count)) {
-        return false;
-      }
-
-      for (uint64_t i = 0; i < array_member_count; ++i) {
-        if (i > 0) OutputStreamWrite(output_stream, ",", 1);
-
-        JsonWriteIndent(output_stream, indent_level + 1);
-
-        if (!BejDecode_element(output_stream, input_stream, schema_dict,
-                               child_entries, child_entry_count,
-                               indent_level + 1, true, false)) {
-          return false;
-        }
-      }
-
-      if (array_member_count > 0) JsonWriteIndent(output_stream, indent_level);
-
-      OutputStreamWrite(output_stream, "]", 1);
-      return true;
-    }
+      return BejDecodeContainer(ctx, input_stream, entry, format,
+                                indent_level);
     case BEJ_FORMAT_STRING: {
       const uint8_t *val = StreamReadBytes(input_stream, length);
-      OutputStreamWrite(output_stream, "\"", 1);
-      OutputStreamWrite(output_stream, (const char *)val,
-                        length > 0 ? length - 1 : 0);
-      OutputStreamWrite(output_stream, "\"", 1);
+      if (!val) return false;
+      DecodeWriteString(ctx, (const char *)val, length > 0 ? length - 1 : 0);
       return true;
     }
     case BEJ_FORMAT_INTEGER: {
       int64_t value = stream_read_sint(input_stream, length);
       char buffer[32];
       int n = snprintf(buffer, sizeof(buffer), "%" PRId64, value);
-      OutputStreamWrite(output_stream, buffer, n);
+      DecodeWrite(ctx, buffer, n);
       return true;
     }
     case BEJ_FORMAT_BOOLEAN: {
       uint8_t value = (uint8_t)StreamReadInt(input_stream, length);
       if (value == 0x01)
-        OutputStreamWrite(output_stream, "true", 4);
+        DecodeWrite(ctx, "true", 4);
       else
-        OutputStreamWrite(output_stream, "false", 5);
+        DecodeWrite(ctx, "false", 5);
       return true;
     }
     case BEJ_FORMAT_NULL: {
-      OutputStreamWrite(output_stream, "null", 4);
+      DecodeWrite(ctx, "null", 4);
       return true;
     }
     case BEJ_FORMAT_ENUM: {
       uint64_t enum_seq = BejUnpackNNInt(input_stream);
-      DictionaryEntry enum_entries[MAX_DICT_ENTRIES];
-      size_t enum_entry_count;
-      if (!LoadDictionarySubsetIntoBuffer(schema_dict->data, schema_dict->size,
-                                          entry->offset, entry->child_count,
-                                          enum_entries, &enum_entry_count)) {
-        return false;
-      }
+      DecodeSubset values;
+      if (!DecodeLoadSubset(ctx, entry, &values)) return false;
 
-      DictionaryEntry *enum_val_entry =
-          find_entry_by_seq(enum_entries, enum_entry_count, enum_seq);
+      DictionaryEntry enum_scratch;
+      const DictionaryEntry *enum_val_entry =
+          DecodeFindEntry(ctx, &values, enum_seq, &enum_scratch);
 
       if (enum_val_entry && enum_val_entry->name) {
-        OutputStreamWrite(output_stream, "\"", 1);
-        OutputStreamWrite(output_stream, enum_val_entry->name,
-                          strlen(enum_val_entry->name));
-        OutputStreamWrite(output_stream, "\"", 1);
+        DecodeWrite(ctx, "\"", 1);
+        DecodeWriteRef(ctx, enum_val_entry->name,
+                       strlen(enum_val_entry->name));
+        DecodeWrite(ctx, "\"", 1);
       } else {
-        OutputStreamWrite(output_stream, "null", 4);
+        DecodeWrite(ctx, "null", 4);
       }
       return true;
     }
@@ -201,7 +335,7 @@ static bool BejDecode_element(OutputStream *output_stream,
       StreamReadBytes(input_stream, length);
       fprintf(stderr, "Warning: Unsupported BEJ format %02X skipped.\n",
               format);
-      OutputStreamWrite(output_stream, "null", 4);
+      DecodeWrite(ctx, "null", 4);
       return false;
   }
 }
@@ -209,18 +343,14 @@ static bool BejDecode_element(OutputStream *output_stream,
 /**
  * @brief Decodes a stream of BEJ elements (e.g., properties of a SET).
  */
-static bool BejDecode_stream(OutputStream *output_stream,
-                             InputStream *input_stream,
-                             InputStream *schema_dict,
-                             DictionaryEntry *current_entries,
-                             size_t entry_count, int prop_count,
+static bool BejDecode_stream(DecodeContext *ctx, InputStream *input_stream,
+                             const DecodeSubset *subset, int prop_count,
                              int indent_level, bool add_name) {
   for (int i = 0; i < prop_count; ++i) {
     if (i > 0) {
-      OutputStreamWrite(output_stream, ", ", 2);
+      DecodeWrite(ctx, ", ", 2);
     }
-    if (!BejDecode_element(output_stream, input_stream, schema_dict,
-                           current_entries, entry_count, indent_level, false,
+    if (!BejDecode_element(ctx, input_stream, subset, indent_level, false,
                            add_name)) {
       return false;
     }
@@ -229,10 +359,9 @@ static bool BejDecode_stream(OutputStream *output_stream,
 }
 
 /**
- * @brief Main function to decode a BEJ stream.
+ * @brief Validates and consumes the BEJ payload header.
  */
-bool BejDecode(OutputStream *output_stream, InputStream *input_stream,
-               InputStream *schema_dictionary) {
+bool BejReadHeader(InputStream *input_stream) {
   if (input_stream->size < 7) return false;
 
   uint32_t version = (uint32_t)StreamReadInt(input_stream, 4);
@@ -259,15 +388,119 @@ bool BejDecode(OutputStream *output_stream, InputStream *input_stream,
             schema_class);
     return false;
   }
+  return true;
+}
 
-  DictionaryEntry root_entries[MAX_DICT_ENTRIES];
-  size_t root_entry_count;
-  if (!LoadDictionarySubsetIntoBuffer(schema_dictionary->data,
-                                      schema_dictionary->size, 0, -1,
-                                      root_entries, &root_entry_count)) {
+/**
+ * @brief Decodes a whole payload using an initialized context.
+ */
+static bool BejDecodeWithContext(DecodeContext *ctx,
+                                 InputStream *input_stream) {
+  if (!BejReadHeader(input_stream)) return false;
+
+  DecodeSubset root = {NULL, DICTIONARY_HEADER_SIZE, 1};
+  if (ctx->compiled &&
+      !DictionaryFindSubset(ctx->compiled, 0, 1, &root.entries, &root.count)) {
     return false;
   }
 
-  return BejDecode_stream(output_stream, input_stream, schema_dictionary,
-                          root_entries, root_entry_count, 1, 0, false);
-}
\ No newline at end of file
+  return BejDecode_stream(ctx, input_stream, &root, 1, 0, false);
+}
+
+/**
+ * @brief Main function to decode a BEJ stream.
+ */
+bool BejDecode(OutputStream *output_stream, InputStream *input_stream,
+               InputStream *schema_dictionary) {
+  DecodeContext ctx = {output_stream, NULL, schema_dictionary, NULL,
+                       false,         NULL, 0,                 0};
+  return BejDecodeWithContext(&ctx, input_stream) && !output_stream->overflow;
+}
+
+/**
+ * @brief Decodes a BEJ stream into single-line JSON.
+ */
+bool BejDecodeCompact(OutputStream *output_stream, InputStream *input_stream,
+                      InputStream *schema_dictionary) {
+  DecodeContext ctx = {output_stream, NULL, schema_dictionary, NULL,
+                       true,          NULL, 0,                 0};
+  return BejDecodeWithContext(&ctx, input_stream) && !output_stream->overflow;
+}
+
+/**
+ * @brief Decodes a BEJ stream into a gather list.
+ */
+bool BejDecodeGather(IovecStream *gather_stream, InputStream *input_stream,
+                     InputStream *schema_dictionary) {
+  DecodeContext ctx = {NULL,  gather_stream, schema_dictionary, NULL,
+                       false, NULL,          0,                 0};
+  return BejDecodeWithContext(&ctx, input_stream) && !gather_stream->error;
+}
+
+/**
+ * @struct BejDecoder
+ * @brief Reusable decoder state for one thread.
+ */
+struct BejDecoder {
+  CompiledDictionary dictionary;
+  uint64_t dictionary_id;
+  BejDecodeCache *cache;
+  OutputStream output;
+};
+
+BejDecoder *BejDecoderCreate(const uint8_t *dictionary, size_t size) {
+  BejDecoder *decoder = malloc(sizeof(*decoder));
+  if (!decoder) return NULL;
+  if (!DictionaryCompile(&decoder->dictionary, dictionary, size)) {
+    free(decoder);
+    return NULL;
+  }
+  decoder->dictionary_id = BejDecodeCacheHash(dictionary, size, 0);
+  decoder->cache = NULL;
+  OutputStreamInit(&decoder->output);
+  return decoder;
+}
+
+void BejDecoderSetCache(BejDecoder *decoder, BejDecodeCache *cache) {
+  decoder->cache = cache;
+}
+
+/**
+ * @brief Decodes a payload with a BejDecoder in the requested style.
+ */
+static bool BejDecoderRun(BejDecoder *decoder, const uint8_t *payload,
+                          size_t size, bool compact, const char **json,
+                          size_t *json_size) {
+  InputStream input_stream = {payload, size, 0};
+  DecodeContext ctx = {&decoder->output, NULL,           NULL,
+                       &decoder->dictionary, compact, decoder->cache,
+                       decoder->dictionary_id, 0};
+
+  OutputStreamInit(&decoder->output);
+  bool ok = BejDecodeWithContext(&ctx, &input_stream) &&
+            !decoder->output.overflow;
+  if (json) *json = decoder->output.data;
+  if (json_size) *json_size = decoder->output.pos;
+  return ok;
+}
+
+bool BejDecoderDecode(BejDecoder *decoder, const uint8_t *payload,
+                      size_t size, const char **json, size_t *json_size) {
+  return BejDecoderRun(decoder, payload, size, false, json, json_size);
+}
+
+bool BejDecoderDecodeCompact(BejDecoder *decoder, const uint8_t *payload,
+                             size_t size, const char **json,
+                             size_t *json_size) {
+  return BejDecoderRun(decoder, payload, size, true, json, json_size);
+}
+
+void BejDecoderReset(BejDecoder *decoder) {
+  OutputStreamInit(&decoder->output);
+}
+
+void BejDecoderDestroy(BejDecoder *decoder) {
+  if (!decoder) return;
+  DictionaryRelease(&decoder->dictionary);
+  free(decoder);
+}
@@ -1,6 +1,7 @@
 #include "dictionary.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /**
@@ -21,6 +22,73 @@ uint64_t DictStreamReadInt(DictionaryStream *stream, size_t size) {
   return value;
 }
 
+bool DictionaryIsWide(const uint8_t *data, size_t size) {
+  return size > 1 && (data[1] & DICTIONARY_FLAG_WIDE) != 0;
+}
+
+bool DictionaryReadEntry(const uint8_t *data, size_t size, uint32_t offset,
+                         uint32_t index, DictionaryEntry *out) {
+  bool wide = DictionaryIsWide(data, size);
+  size_t entry_size = wide ? DICTIONARY_WIDE_ENTRY_SIZE : DICTIONARY_ENTRY_SIZE;
+  size_t position = (size_t)offset + (size_t)index * entry_size;
+  if (position > size || size - position < entry_size) {
+    fprintf(stderr, "Error: Dictionary stream read out of bounds.\n");
+    return false;
+  }
+
+  DictionaryStream ds = {
+      .byte_array = data, .size = size, .current_index = position};
+  size_t field = wide ? 4 : 2;
+  uint8_t format_flags = (uint8_t)DictStreamReadInt(&ds, 1);
+  out->format = format_flags >> 4;
+  out->flags = format_flags & 0x0F;
+  out->sequence_number = (uint32_t)DictStreamReadInt(&ds, field);
+  out->offset = (uint32_t)DictStreamReadInt(&ds, field);
+  out->child_count = (uint32_t)DictStreamReadInt(&ds, field);
+
+  uint8_t name_len = (uint8_t)DictStreamReadInt(&ds, 1);
+  size_t name_offset = (size_t)DictStreamReadInt(&ds, field);
+
+  if (name_len > 0 && name_offset + name_len <= size) {
+    out->name = (const char *)(data + name_offset);
+  } else {
+    out->name = "";
+  }
+  return true;
+}
+
+bool DictionaryFindRawEntry(const uint8_t *data, size_t size, uint32_t offset,
+                            uint32_t child_count, uint64_t seq,
+                            DictionaryEntry *out) {
+  if (seq < child_count && DictionaryReadEntry(data, size, offset,
+                                               (uint32_t)seq, out) &&
+      out->sequence_number == seq) {
+    return true;
+  }
+
+  // Subsets stored in sequence number order are binary searched. When that
+  // misses, the subset may be unsorted, so it is scanned after all.
+  uint32_t lo = 0, hi = child_count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (!DictionaryReadEntry(data, size, offset, mid, out)) return false;
+    if (out->sequence_number < seq) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < child_count && DictionaryReadEntry(data, size, offset, lo, out) &&
+      out->sequence_number == seq) {
+    return true;
+  }
+  for (uint32_t i = 0; i < child_count; ++i) {
+    if (!DictionaryReadEntry(data, size, offset, i, out)) return false;
+    if (out->sequence_number == seq) return true;
+  }
+  return false;
+}
+
 /**
  * @brief Loads a subset of a dictionary into a provided buffer.
  *
@@ -33,61 +101,292 @@ uint64_t DictStreamReadInt(DictionaryStream *stream, size_t size) {
  * @param offset The starting byte offset for the dictionary subset.
  * @param child_count The number of dictionary entries to load. A value of -1
  * indicates the root entry.
- * @param out_entries A pre-allocated array where the loaded entries will be
- * stored.
+ * @param out_entries A pre-allocated array with room for `child_count`
+ * entries (one for the root).
  * @param out_count Pointer to a variable to store the number of loaded entries.
  * @return true if the subset was loaded successfully, false otherwise.
  */
 bool LoadDictionarySubsetIntoBuffer(const uint8_t *data, size_t size,
-                                        uint16_t offset, int16_t child_count,
-                                        DictionaryEntry *out_entries,
-                                        size_t *out_count) {
-  DictionaryStream ds = {
-      .byte_array = data, .size = size, .current_index = offset};
+                                    uint32_t offset, int64_t child_count,
+                                    DictionaryEntry *out_entries,
+                                    size_t *out_count) {
   *out_count = 0;
-
-  int16_t actual_child_count = child_count;
   if (child_count == -1) {
-    if (ds.current_index + 10 > ds.size) return false;
-    DictStreamReadInt(&ds, 1);
-    DictStreamReadInt(&ds, 1);
-    DictStreamReadInt(&ds, 4);
-    (void)DictStreamReadInt(&ds, 2);
-    DictStreamReadInt(&ds, 4);
-    actual_child_count = 1;
-  }
-
-  if (actual_child_count <= 0) return true;
-  if ((size_t)actual_child_count > MAX_DICT_ENTRIES) {
-    fprintf(stderr,
-            "Error: Dictionary subset exceeds max entries (%d vs %u).\n",
-            actual_child_count, MAX_DICT_ENTRIES);
+    offset += DICTIONARY_HEADER_SIZE;
+    child_count = 1;
+  }
+  if (child_count <= 0) return true;
+
+  for (int64_t i = 0; i < child_count; i++) {
+    if (!DictionaryReadEntry(data, size, offset, (uint32_t)i,
+                             &out_entries[i])) {
+      return false;
+    }
+  }
+  *out_count = (size_t)child_count;
+  return true;
+}
+
+/**
+ * @brief Stable merge sort of a subset by sequence number, so entries with
+ * equal numbers keep their dictionary order.
+ */
+static bool DictionarySortSubset(DictionaryEntry *entries, size_t count) {
+  size_t i = 1;
+  while (i < count &&
+         entries[i - 1].sequence_number <= entries[i].sequence_number) {
+    ++i;
+  }
+  if (i >= count) return true;
+
+  DictionaryEntry *scratch = malloc(count * sizeof(*scratch));
+  if (!scratch) return false;
+  DictionaryEntry *src = entries, *dst = scratch;
+  for (size_t width = 1; width < count; width *= 2) {
+    for (size_t lo = 0; lo < count; lo += 2 * width) {
+      size_t mid = lo + width < count ? lo + width : count;
+      size_t hi = lo + 2 * width < count ? lo + 2 * width : count;
+      size_t a = lo, b = mid, k = lo;
+      while (a < mid && b < hi) {
+        dst[k++] = src[b].sequence_number < src[a].sequence_number ? src[b++]
+                                                                    : src[a++];
+      }
+      while (a < mid) dst[k++] = src[a++];
+      while (b < hi) dst[k++] = src[b++];
+    }
+    DictionaryEntry *swap = src;
+    src = dst;
+    dst = swap;
+  }
+  if (src != entries) memcpy(entries, src, count * sizeof(*entries));
+  free(scratch);
+  return true;
+}
+
+/**
+ * @brief Appends a parsed subset to a compiled dictionary being built.
+ */
+static bool DictionaryAddSubset(CompiledDictionary *dict,
+                                size_t *entry_capacity,
+                                size_t *subset_capacity, uint32_t offset,
+                                int64_t child_count) {
+  size_t count = child_count == -1 ? 1 : (size_t)child_count;
+  size_t entry_size = DictionaryIsWide(dict->data, dict->size)
+                          ? DICTIONARY_WIDE_ENTRY_SIZE
+                          : DICTIONARY_ENTRY_SIZE;
+  // Rejects counts that cannot fit before allocating room for them.
+  if (count > dict->size / entry_size) {
+    fprintf(stderr, "Error: Dictionary stream read out of bounds.\n");
     return false;
   }
 
-  *out_count = actual_child_count;
+  if (dict->entry_count + count > *entry_capacity) {
+    size_t capacity = *entry_capacity ? *entry_capacity : 256;
+    while (capacity < dict->entry_count + count) capacity *= 2;
+    DictionaryEntry *entries =
+        realloc(dict->entries, capacity * sizeof(*entries));
+    if (!entries) return false;
+    dict->entries = entries;
+    *entry_capacity = capacity;
+  }
+  if (dict->subset_count == *subset_capacity) {
+    size_t capacity = *subset_capacity ? *subset_capacity * 2 : 64;
+    DictionarySubset *subsets =
+        realloc(dict->subsets, capacity * sizeof(*subsets));
+    if (!subsets) return false;
+    dict->subsets = subsets;
+    *subset_capacity = capacity;
+  }
 
-  for (int i = 0; i < actual_child_count; i++) {
-    if (ds.current_index + 8 > ds.size) {
-      fprintf(stderr, "Error: Dictionary stream read out of bounds.\n");
-      return false;
+  DictionaryEntry *entries = dict->entries + dict->entry_count;
+  if (!LoadDictionarySubsetIntoBuffer(dict->data, dict->size, offset,
+                                      child_count, entries, &count) ||
+      !DictionarySortSubset(entries, count)) {
+    return false;
+  }
+  dict->subsets[dict->subset_count].offset = offset;
+  dict->subsets[dict->subset_count].first = (uint32_t)dict->entry_count;
+  dict->subsets[dict->subset_count].count = (uint32_t)count;
+  dict->subset_count++;
+  dict->entry_count += count;
+  return true;
+}
+
+/**
+ * @brief Compares two subset keys: offset first, then entry count.
+ */
+static int DictionaryCompareKeys(uint32_t offset_a, uint32_t count_a,
+                                 uint32_t offset_b, uint32_t count_b) {
+  if (offset_a != offset_b) return offset_a < offset_b ? -1 : 1;
+  return (count_a > count_b) - (count_a < count_b);
+}
+
+/**
+ * @brief Orders subsets by offset and entry count for binary search.
+ */
+static int DictionaryCompareSubsets(const void *a, const void *b) {
+  const DictionarySubset *lhs = a;
+  const DictionarySubset *rhs = b;
+  return DictionaryCompareKeys(lhs->offset, lhs->count, rhs->offset,
+                               rhs->count);
+}
+
+/**
+ * @struct DictionarySubsetTable
+ * @brief Open-addressing set of the (offset, count) keys already compiled.
+ *
+ * Slots hold a subset index plus one, 0 meaning empty.
+ */
+typedef struct {
+  uint32_t *slots;
+  size_t mask;
+} DictionarySubsetTable;
+
+static size_t DictionarySubsetSlot(const DictionarySubsetTable *table,
+                                   uint32_t offset, uint32_t count) {
+  uint64_t key = ((uint64_t)offset << 32 | count) * 0x9E3779B97F4A7C15ULL;
+  return (size_t)(key >> 32) & table->mask;
+}
+
+/**
+ * @brief Returns true if the subset is already in the table, inserting it
+ * as `index` otherwise.
+ */
+static bool DictionarySubsetSeen(DictionarySubsetTable *table,
+                                 const CompiledDictionary *dict,
+                                 uint32_t offset, uint32_t count,
+                                 size_t index) {
+  size_t slot = DictionarySubsetSlot(table, offset, count);
+  while (table->slots[slot] != 0) {
+    const DictionarySubset *subset = &dict->subsets[table->slots[slot] - 1];
+    if (subset->offset == offset && subset->count == count) return true;
+    slot = (slot + 1) & table->mask;
+  }
+  table->slots[slot] = (uint32_t)index + 1;
+  return false;
+}
+
+/**
+ * @brief Doubles the table once it is half full.
+ */
+static bool DictionarySubsetTableGrow(DictionarySubsetTable *table,
+                                      const CompiledDictionary *dict) {
+  if (dict->subset_count < (table->mask + 1) / 2) return true;
+  DictionarySubsetTable grown = {NULL, table->mask * 2 + 1};
+  grown.slots = calloc(grown.mask + 1, sizeof(*grown.slots));
+  if (!grown.slots) return false;
+  for (size_t i = 0; i < dict->subset_count; ++i) {
+    DictionarySubsetSeen(&grown, dict, dict->subsets[i].offset,
+                         dict->subsets[i].count, i);
+  }
+  free(table->slots);
+  *table = grown;
+  return true;
+}
+
+bool DictionaryCompile(CompiledDictionary *dict, const uint8_t *data,
+                       size_t size) {
+  memset(dict, 0, sizeof(*dict));
+  dict->data = malloc(size ? size : 1);
+  DictionarySubsetTable table = {NULL, 63};
+  table.slots = calloc(table.mask + 1, sizeof(*table.slots));
+  if (!dict->data || !table.slots) {
+    free(dict->data);
+    free(table.slots);
+    return false;
+  }
+  memcpy(dict->data, data, size);
+  dict->size = size;
+
+  size_t entry_capacity = 0, subset_capacity = 0;
+  bool ok = DictionaryAddSubset(dict, &entry_capacity, &subset_capacity, 0,
+                                -1);
+  if (ok) DictionarySubsetSeen(&table, dict, 0, 1, 0);
+
+  // Subsets are appended while they are scanned, so this walks the whole
+  // dictionary breadth-first. Entries that point at the same offset with
+  // different counts get a subset each, holding exactly their children.
+  for (size_t s = 0; ok && s < dict->subset_count; ++s) {
+    DictionarySubset subset = dict->subsets[s];
+    for (uint32_t i = 0; ok && i < subset.count; ++i) {
+      DictionaryEntry entry = dict->entries[subset.first + i];
+      if (entry.child_count == 0) continue;
+      if (entry.offset >= size) {
+        fprintf(stderr, "Error: Dictionary stream read out of bounds.\n");
+        ok = false;
+        break;
+      }
+      ok = DictionarySubsetTableGrow(&table, dict);
+      if (!ok || DictionarySubsetSeen(&table, dict, entry.offset,
+                                      entry.child_count, dict->subset_count)) {
+        continue;
+      }
+      ok = DictionaryAddSubset(dict, &entry_capacity, &subset_capacity,
+                               entry.offset, entry.child_count);
     }
+  }
+  free(table.slots);
 
-    uint8_t format_flags = (uint8_t)DictStreamReadInt(&ds, 1);
-    out_entries[i].format = format_flags >> 4;
-    out_entries[i].flags = format_flags & 0x0F;
-    out_entries[i].sequence_number = (uint16_t)DictStreamReadInt(&ds, 2);
-    out_entries[i].offset = (uint16_t)DictStreamReadInt(&ds, 2);
-    out_entries[i].child_count = (uint16_t)DictStreamReadInt(&ds, 2);
+  if (!ok) {
+    DictionaryRelease(dict);
+    return false;
+  }
 
-    uint8_t name_len = (uint8_t)DictStreamReadInt(&ds, 1);
-    uint16_t name_offset = (uint16_t)DictStreamReadInt(&ds, 2);
+  qsort(dict->subsets, dict->subset_count, sizeof(*dict->subsets),
+        DictionaryCompareSubsets);
+  return true;
+}
 
-    if (name_len > 0 && name_offset + name_len <= size) {
-      out_entries[i].name = (const char *)(data + name_offset);
+bool DictionaryFindSubset(const CompiledDictionary *dict, uint32_t offset,
+                          uint32_t child_count,
+                          const DictionaryEntry **out_entries,
+                          size_t *out_count) {
+  size_t lo = 0, hi = dict->subset_count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    const DictionarySubset *subset = &dict->subsets[mid];
+    if (DictionaryCompareKeys(subset->offset, subset->count, offset,
+                              child_count) < 0) {
+      lo = mid + 1;
     } else {
-      out_entries[i].name = "";
+      hi = mid;
     }
   }
+  if (lo == dict->subset_count || dict->subsets[lo].offset != offset ||
+      dict->subsets[lo].count != child_count) {
+    return false;
+  }
+
+  const DictionarySubset *subset = &dict->subsets[lo];
+  *out_entries = dict->entries + subset->first;
+  *out_count = subset->count;
   return true;
-}
\ No newline at end of file
+}
+
+const DictionaryEntry *DictionaryFindEntry(const DictionaryEntry *entries,
+                                           size_t count, uint64_t seq) {
+  if (seq < count && entries[seq].sequence_number == seq) {
+    // Sorted and numbered by position: earlier entries cannot share it.
+    if (seq == 0 || entries[seq - 1].sequence_number != seq) {
+      return &entries[seq];
+    }
+  }
+  size_t lo = 0, hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (entries[mid].sequence_number < seq) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < count && entries[lo].sequence_number == seq ? &entries[lo]
+                                                          : NULL;
+}
+
+void DictionaryRelease(CompiledDictionary *dict) {
+  free(dict->data);
+  free(dict->entries);
+  free(dict->subsets);
+  memset(dict, 0, sizeof(*dict));
+}
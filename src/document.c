@@ -0,0 +1,503 @@
+#include "document.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_types.h"
+#include "decoder.h"
+#include "json_writer.h"
+
+/// @brief Nesting limit of objects and arrays, which bounds the recursion.
+#define DOCUMENT_MAX_DEPTH 64
+
+/// @brief Largest encoded NNInt: one length byte and eight value bytes.
+#define DOCUMENT_MAX_NNINT 9
+
+/**
+ * @brief Returns the child subset of `entry`.
+ */
+static bool DocumentChildren(const BejDocument *doc,
+                             const DictionaryEntry *entry,
+                             const DictionaryEntry **entries, size_t *count) {
+  if (entry->child_count == 0) {
+    *entries = NULL;
+    *count = 0;
+    return true;
+  }
+  return DictionaryFindSubset(doc->dictionary, entry->offset,
+                              entry->child_count, entries, count);
+}
+
+/**
+ * @struct DocumentParser
+ * @brief State of one BejDocumentParse() call.
+ */
+typedef struct {
+  BejDocument *doc;
+  uint32_t capacity;
+} DocumentParser;
+
+/**
+ * @brief Appends a zeroed node to the tape, growing it inside the arena.
+ *
+ * @return Index of the node, or BEJ_NODE_NONE if memory ran out.
+ */
+static uint32_t DocumentAppend(DocumentParser *parser) {
+  BejDocument *doc = parser->doc;
+  if (doc->node_count == parser->capacity) {
+    uint32_t capacity = parser->capacity * 2;
+    BejNode *nodes =
+        ArenaGrow(doc->arena, doc->nodes, parser->capacity * sizeof(*nodes),
+                  capacity * sizeof(*nodes));
+    if (!nodes) return BEJ_NODE_NONE;
+    doc->nodes = nodes;
+    parser->capacity = capacity;
+  }
+  uint32_t index = doc->node_count++;
+  memset(&doc->nodes[index], 0, sizeof(doc->nodes[index]));
+  return index;
+}
+
+/**
+ * @brief Parses one tuple and, recursively, its members.
+ */
+static bool DocumentParseTuple(DocumentParser *parser, InputStream *in,
+                               const DictionaryEntry *entries, size_t count,
+                               bool is_array_item, int depth) {
+  BejDocument *doc = parser->doc;
+  if (in->pos >= in->size || depth > DOCUMENT_MAX_DEPTH) return false;
+
+  uint64_t raw_seq = BejUnpackNNInt(in);
+  uint8_t format_byte = (uint8_t)StreamReadInt(in, 1);
+  uint8_t format = format_byte >> 4;
+  uint64_t length = BejUnpackNNInt(in);
+
+  const DictionaryEntry *entry =
+      DictionaryFindEntry(entries, count, is_array_item ? 0 : raw_seq >> 1);
+  if (!entry) {
+    fprintf(stderr, "Error: Dictionary entry not found for seq %u\n",
+            (unsigned int)(raw_seq >> 1));
+    return false;
+  }
+
+  uint32_t index = DocumentAppend(parser);
+  if (index == BEJ_NODE_NONE) return false;
+  BejNode *node = &doc->nodes[index];
+  node->format = format_byte;
+  node->flags = is_array_item ? BEJ_NODE_ARRAY_ITEM : 0;
+  node->seq = (uint32_t)raw_seq;
+  node->entry = entry;
+  node->end = index + 1;
+
+  if (format == BEJ_FORMAT_SET || format == BEJ_FORMAT_ARRAY) {
+    node->type = format == BEJ_FORMAT_SET ? BEJ_NODE_OBJECT : BEJ_NODE_ARRAY;
+    uint64_t member_count = BejUnpackNNInt(in);
+    const DictionaryEntry *children;
+    size_t child_count;
+    if (member_count > in->size - in->pos ||
+        !DocumentChildren(doc, entry, &children, &child_count)) {
+      return false;
+    }
+    for (uint64_t i = 0; i < member_count; ++i) {
+      if (!DocumentParseTuple(parser, in, children, child_count,
+                              format == BEJ_FORMAT_ARRAY, depth + 1)) {
+        return false;
+      }
+    }
+    // The tape may have moved while the members were appended.
+    node = &doc->nodes[index];
+    node->count = (uint32_t)member_count;
+    node->end = doc->node_count;
+    return true;
+  }
+
+  const uint8_t *raw = StreamReadBytes(in, length);
+  if (!raw) return false;
+  node->raw = raw;
+  node->raw_size = length;
+  InputStream value = {raw, length, 0};
+
+  switch (format) {
+    case BEJ_FORMAT_NULL:
+      node->type = BEJ_NODE_NULL;
+      return true;
+    case BEJ_FORMAT_INTEGER:
+      if (length > 8) return false;
+      node->type = BEJ_NODE_INTEGER;
+      node->value.integer = stream_read_sint(&value, length);
+      return true;
+    case BEJ_FORMAT_BOOLEAN:
+      node->type = BEJ_NODE_BOOLEAN;
+      node->value.boolean = StreamReadInt(&value, length) == 0x01;
+      return true;
+    case BEJ_FORMAT_STRING:
+      node->type = BEJ_NODE_STRING;
+      node->value.string.data = (const char *)raw;
+      node->value.string.size = length > 0 ? length - 1 : 0;
+      return true;
+    case BEJ_FORMAT_ENUM: {
+      node->type = BEJ_NODE_ENUM;
+      const DictionaryEntry *values;
+      size_t value_count;
+      if (!DocumentChildren(doc, entry, &values, &value_count)) return false;
+      const DictionaryEntry *name =
+          DictionaryFindEntry(values, value_count, BejUnpackNNInt(&value));
+      if (name && name->name) {
+        node->value.string.data = name->name;
+        node->value.string.size = strlen(name->name);
+      }
+      return true;
+    }
+    default:
+      fprintf(stderr, "Error: Unsupported BEJ format %02X in document.\n",
+              format);
+      return false;
+  }
+}
+
+bool BejDocumentParse(BejDocument *doc, Arena *arena,
+                      const CompiledDictionary *dictionary,
+                      const uint8_t *payload, size_t size) {
+  memset(doc, 0, sizeof(*doc));
+  doc->arena = arena;
+  doc->dictionary = dictionary;
+
+  InputStream in = {payload, size, 0};
+  if (!BejReadHeader(&in)) return false;
+  memcpy(doc->header, payload, sizeof(doc->header));
+
+  // Every tuple takes at least three bytes, but most are much larger.
+  DocumentParser parser = {doc, (uint32_t)(size / 16) + 16};
+  doc->nodes = ArenaAlloc(arena, parser.capacity * sizeof(*doc->nodes));
+  if (!doc->nodes) return false;
+
+  const DictionaryEntry *root;
+  size_t root_count;
+  return DictionaryFindSubset(dictionary, 0, 1, &root, &root_count) &&
+         DocumentParseTuple(&parser, &in, root, root_count, false, 0);
+}
+
+const char *BejNodeName(const BejNode *node) {
+  if ((node->flags & BEJ_NODE_ARRAY_ITEM) || !node->entry ||
+      !node->entry->name) {
+    return "";
+  }
+  return node->entry->name;
+}
+
+/**
+ * @brief Finds a member of an object by a name that is `len` bytes long.
+ */
+static uint32_t DocumentFindMember(const BejDocument *doc, uint32_t parent,
+                                   const char *name, size_t len) {
+  if (parent >= doc->node_count ||
+      doc->nodes[parent].type != BEJ_NODE_OBJECT) {
+    return BEJ_NODE_NONE;
+  }
+  for (uint32_t i = parent + 1; i < doc->nodes[parent].end;
+       i = doc->nodes[i].end) {
+    const char *member = BejNodeName(&doc->nodes[i]);
+    if (!(doc->nodes[i].flags & BEJ_NODE_REMOVED) &&
+        strncmp(member, name, len) == 0 && member[len] == '\0') {
+      return i;
+    }
+  }
+  return BEJ_NODE_NONE;
+}
+
+/**
+ * @brief Returns the element at `position` of an array, ignoring removed
+ * elements.
+ */
+static uint32_t DocumentFindElement(const BejDocument *doc, uint32_t parent,
+                                    size_t position) {
+  for (uint32_t i = parent + 1; i < doc->nodes[parent].end;
+       i = doc->nodes[i].end) {
+    if (doc->nodes[i].flags & BEJ_NODE_REMOVED) continue;
+    if (position-- == 0) return i;
+  }
+  return BEJ_NODE_NONE;
+}
+
+uint32_t BejDocumentFind(const BejDocument *doc, uint32_t parent,
+                         const char *name) {
+  return DocumentFindMember(doc, parent, name, strlen(name));
+}
+
+uint32_t BejDocumentFindPath(const BejDocument *doc, const char *path) {
+  uint32_t index = doc->node_count > 0 ? 0 : BEJ_NODE_NONE;
+  while (index != BEJ_NODE_NONE && *path) {
+    const char *dot = strchr(path, '.');
+    size_t len = dot ? (size_t)(dot - path) : strlen(path);
+    if (doc->nodes[index].type == BEJ_NODE_ARRAY) {
+      char *digits_end;
+      size_t position = strtoul(path, &digits_end, 10);
+      index = digits_end == path + len
+                  ? DocumentFindElement(doc, index, position)
+                  : BEJ_NODE_NONE;
+    } else {
+      index = DocumentFindMember(doc, index, path, len);
+    }
+    path += len + (dot ? 1 : 0);
+  }
+  return index;
+}
+
+/**
+ * @brief Returns node `index` if it exists and has the given type.
+ */
+static BejNode *DocumentLeaf(BejDocument *doc, uint32_t index,
+                             BejNodeType type) {
+  if (index >= doc->node_count || doc->nodes[index].type != type) return NULL;
+  return &doc->nodes[index];
+}
+
+/**
+ * @brief Encodes a BEJ NNInt and returns its size.
+ */
+static size_t DocumentPackNNInt(uint8_t *buf, uint64_t value) {
+  size_t n = 0;
+  do {
+    buf[1 + n++] = (uint8_t)value;
+    value >>= 8;
+  } while (value > 0);
+  buf[0] = (uint8_t)n;
+  return n + 1;
+}
+
+/**
+ * @brief Copies `size` encoded value bytes into the arena as the node's new
+ * value.
+ */
+static bool DocumentSetRaw(BejDocument *doc, BejNode *node,
+                           const uint8_t *raw, size_t size) {
+  uint8_t *copy = ArenaAlloc(doc->arena, size);
+  if (!copy) return false;
+  memcpy(copy, raw, size);
+  node->raw = copy;
+  node->raw_size = size;
+  return true;
+}
+
+bool BejDocumentSetInteger(BejDocument *doc, uint32_t index, int64_t value) {
+  BejNode *node = DocumentLeaf(doc, index, BEJ_NODE_INTEGER);
+  if (!node) return false;
+
+  // Shortest two's complement encoding that sign-extends back to `value`.
+  uint8_t raw[8];
+  size_t size = 0;
+  int64_t rest = value;
+  do {
+    raw[size++] = (uint8_t)rest;
+    rest >>= 8;
+  } while (size < 8 && !((rest == 0 && !(raw[size - 1] & 0x80)) ||
+                         (rest == -1 && (raw[size - 1] & 0x80))));
+  if (!DocumentSetRaw(doc, node, raw, size)) return false;
+  node->value.integer = value;
+  return true;
+}
+
+bool BejDocumentSetBoolean(BejDocument *doc, uint32_t index, bool value) {
+  BejNode *node = DocumentLeaf(doc, index, BEJ_NODE_BOOLEAN);
+  uint8_t raw = value ? 0x01 : 0x00;
+  if (!node || !DocumentSetRaw(doc, node, &raw, 1)) return false;
+  node->value.boolean = value;
+  return true;
+}
+
+bool BejDocumentSetString(BejDocument *doc, uint32_t index,
+                          const char *value) {
+  BejNode *node = DocumentLeaf(doc, index, BEJ_NODE_STRING);
+  size_t len = strlen(value);
+  if (!node || !DocumentSetRaw(doc, node, (const uint8_t *)value, len + 1)) {
+    return false;
+  }
+  node->value.string.data = (const char *)node->raw;
+  node->value.string.size = len;
+  return true;
+}
+
+bool BejDocumentSetEnum(BejDocument *doc, uint32_t index, const char *name) {
+  BejNode *node = DocumentLeaf(doc, index, BEJ_NODE_ENUM);
+  const DictionaryEntry *values;
+  size_t value_count;
+  if (!node || !DocumentChildren(doc, node->entry, &values, &value_count)) {
+    return false;
+  }
+  for (size_t i = 0; i < value_count; ++i) {
+    if (values[i].name && strcmp(values[i].name, name) == 0) {
+      uint8_t raw[DOCUMENT_MAX_NNINT];
+      size_t size = DocumentPackNNInt(raw, values[i].sequence_number);
+      if (!DocumentSetRaw(doc, node, raw, size)) return false;
+      node->value.string.data = values[i].name;
+      node->value.string.size = strlen(values[i].name);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool BejDocumentRemove(BejDocument *doc, uint32_t index) {
+  if (index == 0 || index >= doc->node_count) return false;
+  doc->nodes[index].flags |= BEJ_NODE_REMOVED;
+  return true;
+}
+
+/**
+ * @brief Writes indentation unless the output is compact.
+ */
+static void DocumentWriteIndent(OutputStream *out, int level, bool compact) {
+  if (!compact) JsonWriteIndent(out, level);
+}
+
+/**
+ * @brief Writes one node and its subtree as JSON, in the decoder's layout.
+ */
+static void DocumentWriteJsonNode(const BejDocument *doc, uint32_t index,
+                                  OutputStream *out, int level,
+                                  bool compact) {
+  const BejNode *node = &doc->nodes[index];
+  switch (node->type) {
+    case BEJ_NODE_OBJECT:
+    case BEJ_NODE_ARRAY: {
+      bool is_object = node->type == BEJ_NODE_OBJECT;
+      bool first = true;
+      OutputStreamWrite(out, is_object ? "{" : "[", 1);
+      for (uint32_t i = index + 1; i < node->end; i = doc->nodes[i].end) {
+        if (doc->nodes[i].flags & BEJ_NODE_REMOVED) continue;
+        if (!first) OutputStreamWrite(out, ",", 1);
+        first = false;
+        DocumentWriteIndent(out, level + 1, compact);
+        const char *name = BejNodeName(&doc->nodes[i]);
+        if (is_object && name[0] != '\0') {
+          OutputStreamWrite(out, "\"", 1);
+          OutputStreamWrite(out, name, strlen(name));
+          OutputStreamWrite(out, compact ? "\":" : "\": ", compact ? 2 : 3);
+        }
+        DocumentWriteJsonNode(doc, i, out, level + 1, compact);
+      }
+      if (!first) DocumentWriteIndent(out, level, compact);
+      OutputStreamWrite(out, is_object ? "}" : "]", 1);
+      return;
+    }
+    case BEJ_NODE_INTEGER: {
+      char buffer[32];
+      int n = snprintf(buffer, sizeof(buffer), "%" PRId64,
+                       node->value.integer);
+      OutputStreamWrite(out, buffer, n);
+      return;
+    }
+    case BEJ_NODE_BOOLEAN:
+      if (node->value.boolean) {
+        OutputStreamWrite(out, "true", 4);
+      } else {
+        OutputStreamWrite(out, "false", 5);
+      }
+      return;
+    case BEJ_NODE_STRING:
+    case BEJ_NODE_ENUM:
+      if (node->value.string.data) {
+        JsonWriteString(out, node->value.string.data,
+                        node->value.string.size);
+        return;
+      }
+      OutputStreamWrite(out, "null", 4);
+      return;
+    default:
+      OutputStreamWrite(out, "null", 4);
+      return;
+  }
+}
+
+bool BejDocumentWriteJson(const BejDocument *doc, OutputStream *out,
+                          bool compact) {
+  if (doc->node_count == 0) return false;
+  DocumentWriteJsonNode(doc, 0, out, 0, compact);
+  return !out->overflow;
+}
+
+/**
+ * @brief Returns the size of an encoded NNInt.
+ */
+static size_t DocumentNNIntSize(uint64_t value) {
+  size_t n = 1;
+  while (value >>= 8) ++n;
+  return n + 1;
+}
+
+/**
+ * @brief Computes the encoded value size of every node, members first.
+ *
+ * Containers come before their members on the tape, so walking it
+ * backwards sees every member before its container.
+ */
+static void DocumentValueSizes(const BejDocument *doc, size_t *sizes) {
+  for (uint32_t index = doc->node_count; index-- > 0;) {
+    const BejNode *node = &doc->nodes[index];
+    if (node->type != BEJ_NODE_OBJECT && node->type != BEJ_NODE_ARRAY) {
+      sizes[index] = node->raw_size;
+      continue;
+    }
+    size_t size = 0, live = 0;
+    for (uint32_t i = index + 1; i < node->end; i = doc->nodes[i].end) {
+      if (doc->nodes[i].flags & BEJ_NODE_REMOVED) continue;
+      uint32_t seq = node->type == BEJ_NODE_ARRAY
+                         ? (uint32_t)(live << 1) | (doc->nodes[i].seq & 1)
+                         : doc->nodes[i].seq;
+      size += DocumentNNIntSize(seq) + 1 + DocumentNNIntSize(sizes[i]) +
+              sizes[i];
+      live++;
+    }
+    sizes[index] = DocumentNNIntSize(live) + size;
+  }
+}
+
+/**
+ * @brief Writes one tuple with the given encoded sequence number.
+ */
+static void DocumentWriteTuple(const BejDocument *doc, uint32_t index,
+                               uint32_t seq, const size_t *sizes,
+                               OutputStream *out) {
+  const BejNode *node = &doc->nodes[index];
+  uint8_t buf[DOCUMENT_MAX_NNINT];
+  OutputStreamWrite(out, (const char *)buf, DocumentPackNNInt(buf, seq));
+  OutputStreamWrite(out, (const char *)&node->format, 1);
+  OutputStreamWrite(out, (const char *)buf,
+                    DocumentPackNNInt(buf, sizes[index]));
+
+  if (node->type != BEJ_NODE_OBJECT && node->type != BEJ_NODE_ARRAY) {
+    OutputStreamWrite(out, (const char *)node->raw, node->raw_size);
+    return;
+  }
+
+  size_t live = 0;
+  for (uint32_t i = index + 1; i < node->end; i = doc->nodes[i].end) {
+    live += !(doc->nodes[i].flags & BEJ_NODE_REMOVED);
+  }
+  OutputStreamWrite(out, (const char *)buf, DocumentPackNNInt(buf, live));
+
+  uint32_t position = 0;
+  for (uint32_t i = index + 1; i < node->end; i = doc->nodes[i].end) {
+    if (doc->nodes[i].flags & BEJ_NODE_REMOVED) continue;
+    // Array elements are numbered by their position.
+    uint32_t member_seq = node->type == BEJ_NODE_ARRAY
+                              ? (position << 1) | (doc->nodes[i].seq & 1)
+                              : doc->nodes[i].seq;
+    DocumentWriteTuple(doc, i, member_seq, sizes, out);
+    position++;
+  }
+}
+
+bool BejDocumentWriteBej(const BejDocument *doc, OutputStream *out) {
+  if (doc->node_count == 0) return false;
+  size_t *sizes = malloc(doc->node_count * sizeof(*sizes));
+  if (!sizes) return false;
+
+  DocumentValueSizes(doc, sizes);
+  OutputStreamWrite(out, (const char *)doc->header, sizeof(doc->header));
+  DocumentWriteTuple(doc, 0, doc->nodes[0].seq, sizes, out);
+  free(sizes);
+  return !out->overflow;
+}
@@ -0,0 +1,511 @@
+#include "export.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_types.h"
+#include "decoder.h"
+#include "stream_utils.h"
+
+/**
+ * @brief Appends a column for a leaf entry, or recurses into a SET.
+ */
+static bool ExportAddColumns(BejExporter *exporter, size_t *capacity,
+                             const DictionaryEntry *entries, size_t count,
+                             const char *prefix, const uint32_t *path,
+                             size_t depth) {
+  for (size_t i = 0; i < count; ++i) {
+    const DictionaryEntry *entry = &entries[i];
+    if (entry->name[0] == '\0') continue;
+
+    char name[BEJ_EXPORT_MAX_NAME];
+    int n = snprintf(name, sizeof(name), "%s%s%s", prefix,
+                     prefix[0] ? "." : "", entry->name);
+    if (n < 0 || (size_t)n >= sizeof(name)) continue;
+    uint32_t child_path[BEJ_EXPORT_MAX_DEPTH];
+    if (depth > 0) memcpy(child_path, path, depth * sizeof(*path));
+    child_path[depth] = entry->sequence_number;
+
+    BejColumnType type;
+    switch (entry->format) {
+      case BEJ_FORMAT_SET: {
+        const DictionaryEntry *children;
+        size_t child_count;
+        if (depth + 1 == BEJ_EXPORT_MAX_DEPTH || entry->child_count == 0 ||
+            !DictionaryFindSubset(&exporter->dictionary, entry->offset,
+                                  entry->child_count, &children,
+                                  &child_count)) {
+          continue;
+        }
+        if (!ExportAddColumns(exporter, capacity, children, child_count,
+                              name, child_path, depth + 1)) {
+          return false;
+        }
+        continue;
+      }
+      case BEJ_FORMAT_INTEGER:
+        type = BEJ_COLUMN_INT64;
+        break;
+      case BEJ_FORMAT_ENUM:
+        type = BEJ_COLUMN_ENUM;
+        break;
+      case BEJ_FORMAT_BOOLEAN:
+        type = BEJ_COLUMN_BOOL;
+        break;
+      case BEJ_FORMAT_STRING:
+      case BEJ_FORMAT_ARRAY:
+        type = BEJ_COLUMN_STRING;
+        break;
+      default:
+        continue;
+    }
+
+    if (exporter->column_count == *capacity) {
+      size_t new_capacity = *capacity ? *capacity * 2 : 32;
+      BejExportColumn *columns = realloc(
+          exporter->columns, new_capacity * sizeof(*exporter->columns));
+      if (!columns) return false;
+      exporter->columns = columns;
+      *capacity = new_capacity;
+    }
+    BejExportColumn *column = &exporter->columns[exporter->column_count++];
+    memset(column, 0, sizeof(*column));
+    memcpy(column->name, name, (size_t)n + 1);
+    memcpy(column->path, child_path, (depth + 1) * sizeof(*path));
+    column->depth = depth + 1;
+    column->type = type;
+    column->format = entry->format;
+
+    // Enum names of enum columns, or of the elements of an enum array.
+    const DictionaryEntry *enum_owner = entry;
+    if (entry->format == BEJ_FORMAT_ARRAY) {
+      const DictionaryEntry *elements;
+      size_t element_count;
+      enum_owner = NULL;
+      if (entry->child_count > 0 &&
+          DictionaryFindSubset(&exporter->dictionary, entry->offset,
+                               entry->child_count, &elements,
+                               &element_count) &&
+          element_count > 0 && elements[0].format == BEJ_FORMAT_ENUM) {
+        enum_owner = &elements[0];
+      }
+    }
+    if (enum_owner && enum_owner->format == BEJ_FORMAT_ENUM &&
+        enum_owner->child_count > 0) {
+      DictionaryFindSubset(&exporter->dictionary, enum_owner->offset,
+                           enum_owner->child_count, &column->enum_entries,
+                           &column->enum_count);
+    }
+
+    column->valid = calloc(BEJ_EXPORT_CHUNK_ROWS, sizeof(*column->valid));
+    column->values = calloc(BEJ_EXPORT_CHUNK_ROWS, sizeof(*column->values));
+    column->offsets =
+        calloc(BEJ_EXPORT_CHUNK_ROWS + 1, sizeof(*column->offsets));
+    if (!column->valid || !column->values || !column->offsets) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Returns the name of an enum value, or NULL if it is unknown.
+ */
+static const char *ExportEnumName(const BejExportColumn *column, int64_t seq) {
+  if (seq < 0) return NULL;
+  const DictionaryEntry *value = DictionaryFindEntry(
+      column->enum_entries, column->enum_count, (uint64_t)seq);
+  return value ? value->name : NULL;
+}
+
+/**
+ * @brief Writes a little-endian integer.
+ */
+static void ExportPutInt(BejExporter *exporter, uint64_t value, size_t size) {
+  uint8_t bytes[8];
+  for (size_t i = 0; i < size; ++i) bytes[i] = (uint8_t)(value >> (i * 8));
+  if (fwrite(bytes, 1, size, exporter->out) != size) exporter->error = true;
+}
+
+/**
+ * @brief Writes raw bytes.
+ */
+static void ExportPut(BejExporter *exporter, const void *data, size_t size) {
+  if (size > 0 && fwrite(data, 1, size, exporter->out) != size) {
+    exporter->error = true;
+  }
+}
+
+/**
+ * @brief Writes a CSV field, quoting it when needed.
+ */
+static void ExportPutCsv(BejExporter *exporter, const char *text,
+                         size_t len) {
+  // Column bytes are not NUL-terminated, so only `len` bytes are scanned.
+  if (!memchr(text, ',', len) && !memchr(text, '"', len) &&
+      !memchr(text, '\r', len) && !memchr(text, '\n', len)) {
+    ExportPut(exporter, text, len);
+    return;
+  }
+  ExportPut(exporter, "\"", 1);
+  for (size_t i = 0; i < len; ++i) {
+    if (text[i] == '"') ExportPut(exporter, "\"", 1);
+    ExportPut(exporter, &text[i], 1);
+  }
+  ExportPut(exporter, "\"", 1);
+}
+
+/**
+ * @brief Writes the CSV header or the binary column descriptors.
+ */
+static void ExportWriteHeader(BejExporter *exporter) {
+  if (exporter->format == BEJ_EXPORT_CSV) {
+    for (size_t c = 0; c < exporter->column_count; ++c) {
+      if (c > 0) ExportPut(exporter, ",", 1);
+      const char *name = exporter->columns[c].name;
+      ExportPutCsv(exporter, name, strlen(name));
+    }
+    ExportPut(exporter, "\n", 1);
+    return;
+  }
+
+  ExportPut(exporter, "BEJC", 4);
+  ExportPutInt(exporter, BEJ_EXPORT_VERSION, 2);
+  ExportPutInt(exporter, exporter->column_count, 4);
+  for (size_t c = 0; c < exporter->column_count; ++c) {
+    const BejExportColumn *column = &exporter->columns[c];
+    size_t name_len = strlen(column->name);
+    ExportPutInt(exporter, column->type, 1);
+    ExportPutInt(exporter, 0, 1);
+    ExportPutInt(exporter, name_len, 2);
+    ExportPut(exporter, column->name, name_len);
+    if (column->type != BEJ_COLUMN_ENUM) continue;
+    ExportPutInt(exporter, column->enum_count, 4);
+    for (size_t i = 0; i < column->enum_count; ++i) {
+      const DictionaryEntry *value = &column->enum_entries[i];
+      size_t value_len = strlen(value->name);
+      ExportPutInt(exporter, value->sequence_number, 4);
+      ExportPutInt(exporter, value_len, 2);
+      ExportPut(exporter, value->name, value_len);
+    }
+  }
+}
+
+bool BejExporterOpen(BejExporter *exporter, const uint8_t *dictionary,
+                     size_t size, BejExportFormat format, FILE *out) {
+  memset(exporter, 0, sizeof(*exporter));
+  exporter->format = format;
+  exporter->out = out;
+  if (!DictionaryCompile(&exporter->dictionary, dictionary, size)) {
+    return false;
+  }
+
+  const DictionaryEntry *root;
+  const DictionaryEntry *entries;
+  size_t count;
+  size_t capacity = 0;
+  bool ok = DictionaryFindSubset(&exporter->dictionary, 0, 1, &root,
+                                 &count) &&
+            root->format == BEJ_FORMAT_SET &&
+            DictionaryFindSubset(&exporter->dictionary, root->offset,
+                                 root->child_count, &entries, &count) &&
+            ExportAddColumns(exporter, &capacity, entries, count, "", NULL,
+                             0);
+  if (ok) ExportWriteHeader(exporter);
+  if (!ok || exporter->error) {
+    exporter->out = NULL;
+    BejExporterClose(exporter);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Appends bytes to a string column's current value.
+ */
+static bool ExportAppendBytes(BejExportColumn *column, const char *data,
+                              size_t len) {
+  if (column->bytes_len + len > UINT32_MAX) return false;
+  if (column->bytes_len + len > column->bytes_capacity) {
+    size_t capacity = column->bytes_capacity ? column->bytes_capacity : 4096;
+    while (capacity < column->bytes_len + len) capacity *= 2;
+    char *bytes = realloc(column->bytes, capacity);
+    if (!bytes) return false;
+    column->bytes = bytes;
+    column->bytes_capacity = capacity;
+  }
+  memcpy(column->bytes + column->bytes_len, data, len);
+  column->bytes_len += len;
+  return true;
+}
+
+/**
+ * @brief Joins the scalar elements of an array into a string column value.
+ */
+static bool ExportReadArray(BejExportColumn *column, InputStream *in) {
+  uint64_t count = BejUnpackNNInt(in);
+  if (count > in->size - in->pos) return false;
+  for (uint64_t i = 0; i < count; ++i) {
+    BejUnpackNNInt(in);
+    uint8_t format = (uint8_t)StreamReadInt(in, 1) >> 4;
+    uint64_t length = BejUnpackNNInt(in);
+    if (length > in->size - in->pos) return false;
+    InputStream value = {in->data, in->pos + length, in->pos};
+    in->pos += length;
+
+    char buffer[32];
+    const char *text = NULL;
+    size_t len = 0;
+    switch (format) {
+      case BEJ_FORMAT_INTEGER:
+        len = (size_t)snprintf(buffer, sizeof(buffer), "%" PRId64,
+                               stream_read_sint(&value, length));
+        text = buffer;
+        break;
+      case BEJ_FORMAT_BOOLEAN:
+        text = StreamReadInt(&value, length) == 0x01 ? "true" : "false";
+        len = strlen(text);
+        break;
+      case BEJ_FORMAT_ENUM:
+        text = ExportEnumName(column, (int64_t)BejUnpackNNInt(&value));
+        len = text ? strlen(text) : 0;
+        break;
+      case BEJ_FORMAT_STRING:
+        text = (const char *)StreamReadBytes(&value, length);
+        len = length > 0 ? length - 1 : 0;
+        break;
+      default:
+        continue;
+    }
+    if (i > 0 && !ExportAppendBytes(column, ";", 1)) return false;
+    if (text && !ExportAppendBytes(column, text, len)) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Stores one leaf value in the current row of its column.
+ */
+static bool ExportReadValue(BejExporter *exporter, BejExportColumn *column,
+                            InputStream *in, uint8_t format,
+                            uint64_t length) {
+  size_t row = exporter->chunk_rows;
+  if (column->valid[row] || format == BEJ_FORMAT_NULL) return true;
+  if (format != column->format) return true;
+
+  switch (format) {
+    case BEJ_FORMAT_INTEGER:
+      column->values[row] = stream_read_sint(in, length);
+      break;
+    case BEJ_FORMAT_ENUM: {
+      // Dictionary sequence numbers fit into 32 bits; larger values name
+      // no enum value and stay null.
+      uint64_t seq = BejUnpackNNInt(in);
+      if (seq > UINT32_MAX) return true;
+      column->values[row] = (int64_t)seq;
+      break;
+    }
+    case BEJ_FORMAT_BOOLEAN:
+      column->values[row] = StreamReadInt(in, length) == 0x01;
+      break;
+    case BEJ_FORMAT_STRING: {
+      const uint8_t *text = StreamReadBytes(in, length);
+      if (!text ||
+          !ExportAppendBytes(column, (const char *)text,
+                             length > 0 ? length - 1 : 0)) {
+        return false;
+      }
+      break;
+    }
+    case BEJ_FORMAT_ARRAY:
+      if (!ExportReadArray(column, in)) return false;
+      break;
+    default:
+      return true;
+  }
+  column->valid[row] = 1;
+  return true;
+}
+
+/**
+ * @brief Scans the members of a SET into the columns in [first, end), which
+ * share the first `depth` path elements.
+ */
+static bool ExportScanSet(BejExporter *exporter, InputStream *in,
+                          size_t depth, size_t first, size_t end) {
+  uint64_t count = BejUnpackNNInt(in);
+  if (count > in->size - in->pos) return false;
+  for (uint64_t i = 0; i < count; ++i) {
+    uint32_t seq = (uint32_t)(BejUnpackNNInt(in) >> 1);
+    uint8_t format = (uint8_t)StreamReadInt(in, 1) >> 4;
+    uint64_t length = BejUnpackNNInt(in);
+    if (length > in->size - in->pos) return false;
+    InputStream value = {in->data, in->pos + length, in->pos};
+    in->pos += length;
+
+    // Columns are in dictionary order, so those below `seq` are contiguous.
+    size_t a = first;
+    while (a < end && exporter->columns[a].path[depth] != seq) a++;
+    size_t b = a;
+    while (b < end && exporter->columns[b].path[depth] == seq) b++;
+    if (a == b) continue;
+
+    BejExportColumn *column = &exporter->columns[a];
+    if (column->depth == depth + 1) {
+      if (!ExportReadValue(exporter, column, &value, format, length)) {
+        return false;
+      }
+    } else if (format == BEJ_FORMAT_SET &&
+               !ExportScanSet(exporter, &value, depth + 1, a, b)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Writes the rows of the current chunk as CSV lines.
+ */
+static void ExportWriteCsvChunk(BejExporter *exporter) {
+  for (size_t row = 0; row < exporter->chunk_rows; ++row) {
+    for (size_t c = 0; c < exporter->column_count; ++c) {
+      const BejExportColumn *column = &exporter->columns[c];
+      if (c > 0) ExportPut(exporter, ",", 1);
+      if (!column->valid[row]) continue;
+
+      char buffer[32];
+      const char *text = buffer;
+      size_t len;
+      switch (column->type) {
+        case BEJ_COLUMN_INT64:
+          len = (size_t)snprintf(buffer, sizeof(buffer), "%" PRId64,
+                                 column->values[row]);
+          break;
+        case BEJ_COLUMN_BOOL:
+          text = column->values[row] ? "true" : "false";
+          len = strlen(text);
+          break;
+        case BEJ_COLUMN_ENUM:
+          text = ExportEnumName(column, column->values[row]);
+          len = text ? strlen(text) : 0;
+          break;
+        default:
+          text = column->bytes + column->offsets[row];
+          len = column->offsets[row + 1] - column->offsets[row];
+          break;
+      }
+      if (text) ExportPutCsv(exporter, text, len);
+    }
+    ExportPut(exporter, "\n", 1);
+  }
+}
+
+/**
+ * @brief Writes the current chunk in the binary column-chunked layout.
+ */
+static void ExportWriteBinaryChunk(BejExporter *exporter) {
+  size_t rows = exporter->chunk_rows;
+  ExportPutInt(exporter, rows, 4);
+  for (size_t c = 0; c < exporter->column_count; ++c) {
+    const BejExportColumn *column = &exporter->columns[c];
+    size_t width;
+    switch (column->type) {
+      case BEJ_COLUMN_INT64:
+        width = 8;
+        break;
+      case BEJ_COLUMN_ENUM:
+        width = 4;
+        break;
+      case BEJ_COLUMN_BOOL:
+        width = 1;
+        break;
+      default:
+        width = 0;
+        break;
+    }
+    size_t size = rows + rows * width;
+    if (column->type == BEJ_COLUMN_STRING) {
+      size += (rows + 1) * 4 + column->bytes_len;
+    }
+    ExportPutInt(exporter, size, 4);
+    ExportPut(exporter, column->valid, rows);
+    if (column->type == BEJ_COLUMN_STRING) {
+      for (size_t row = 0; row <= rows; ++row) {
+        ExportPutInt(exporter, column->offsets[row], 4);
+      }
+      ExportPut(exporter, column->bytes, column->bytes_len);
+      continue;
+    }
+    for (size_t row = 0; row < rows; ++row) {
+      ExportPutInt(exporter, (uint64_t)column->values[row], width);
+    }
+  }
+}
+
+/**
+ * @brief Writes the pending rows and starts a new chunk.
+ */
+static void ExportFlushChunk(BejExporter *exporter) {
+  if (exporter->chunk_rows == 0) return;
+  if (exporter->format == BEJ_EXPORT_CSV) {
+    ExportWriteCsvChunk(exporter);
+  } else {
+    ExportWriteBinaryChunk(exporter);
+  }
+  for (size_t c = 0; c < exporter->column_count; ++c) {
+    BejExportColumn *column = &exporter->columns[c];
+    memset(column->valid, 0, BEJ_EXPORT_CHUNK_ROWS);
+    column->bytes_len = 0;
+  }
+  exporter->chunk_rows = 0;
+}
+
+bool BejExporterAdd(BejExporter *exporter, const uint8_t *payload,
+                    size_t size) {
+  size_t row = exporter->chunk_rows;
+  InputStream in = {payload, size, 0};
+  bool ok = BejReadHeader(&in);
+  if (ok) {
+    BejUnpackNNInt(&in);
+    uint8_t format = (uint8_t)StreamReadInt(&in, 1) >> 4;
+    uint64_t length = BejUnpackNNInt(&in);
+    ok = format == BEJ_FORMAT_SET && length <= in.size - in.pos &&
+         ExportScanSet(exporter, &in, 0, 0, exporter->column_count);
+  }
+
+  for (size_t c = 0; c < exporter->column_count; ++c) {
+    BejExportColumn *column = &exporter->columns[c];
+    if (!ok) {
+      column->valid[row] = 0;
+      column->bytes_len = column->offsets[row];
+    }
+    column->offsets[row + 1] = (uint32_t)column->bytes_len;
+  }
+  if (!ok) exporter->failed++;
+  exporter->rows++;
+  if (++exporter->chunk_rows == BEJ_EXPORT_CHUNK_ROWS) {
+    ExportFlushChunk(exporter);
+  }
+  return ok && !exporter->error;
+}
+
+bool BejExporterClose(BejExporter *exporter) {
+  if (exporter->out) {
+    ExportFlushChunk(exporter);
+    if (exporter->format == BEJ_EXPORT_BINARY) ExportPutInt(exporter, 0, 4);
+    if (fflush(exporter->out) != 0) exporter->error = true;
+  }
+  bool ok = !exporter->error;
+
+  for (size_t c = 0; c < exporter->column_count; ++c) {
+    BejExportColumn *column = &exporter->columns[c];
+    free(column->valid);
+    free(column->values);
+    free(column->offsets);
+    free(column->bytes);
+  }
+  free(exporter->columns);
+  DictionaryRelease(&exporter->dictionary);
+  exporter->columns = NULL;
+  exporter->column_count = 0;
+  return ok;
+}
@@ -0,0 +1,214 @@
+#include "hash.h"
+
+#include <stdio.h>
+
+#include "bej_types.h"
+#include "decoder.h"
+#include "stream_utils.h"
+
+/// @brief Nesting limit of objects and arrays, which bounds the recursion.
+#define HASH_MAX_DEPTH 64
+
+#define HASH_P1 0x9E3779B185EBCA87ULL
+#define HASH_P2 0xC2B2AE3D27D4EB4FULL
+#define HASH_P3 0x165667B19E3779F9ULL
+#define HASH_P4 0x85EBCA77C2B2AE63ULL
+
+static uint64_t HashRotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @brief Reads a little-endian word whatever the host byte order.
+ */
+static uint64_t HashRead64(const uint8_t *p) {
+  return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 |
+         (uint64_t)p[3] << 24 | (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 |
+         (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+static uint64_t HashRound(uint64_t acc, uint64_t input) {
+  acc += input * HASH_P2;
+  acc = HashRotl(acc, 31);
+  return acc * HASH_P1;
+}
+
+static uint64_t HashMix(uint64_t x) {
+  x ^= x >> 33;
+  x *= HASH_P2;
+  x ^= x >> 29;
+  x *= HASH_P3;
+  x ^= x >> 32;
+  return x;
+}
+
+/**
+ * @brief Mixes two words into a 128-bit hash. Both halves depend on both
+ * words but not on each other, so they are computed in parallel.
+ */
+static BejHashValue HashPair(uint64_t a, uint64_t b) {
+  BejHashValue h;
+  h.lo = HashMix(a * HASH_P1 ^ HashRotl(b, 31) * HASH_P2);
+  h.hi = HashMix(b * HASH_P3 ^ HashRotl(a, 27) * HASH_P4);
+  return h;
+}
+
+BejHashValue BejHashBytes(const void *data, size_t size, uint64_t seed) {
+  const uint8_t *p = data;
+  const uint8_t *end = p + size;
+  uint64_t v1 = seed + HASH_P1 + HASH_P2;
+  uint64_t v2 = seed + HASH_P2;
+  uint64_t v3 = seed;
+  uint64_t v4 = seed - HASH_P1;
+
+  // Four independent lanes keep the multipliers busy on long strings.
+  while (end - p >= 32) {
+    v1 = HashRound(v1, HashRead64(p));
+    v2 = HashRound(v2, HashRead64(p + 8));
+    v3 = HashRound(v3, HashRead64(p + 16));
+    v4 = HashRound(v4, HashRead64(p + 24));
+    p += 32;
+  }
+
+  uint64_t lo = HashRotl(v1, 1) + HashRotl(v2, 7) + HashRotl(v3, 12) +
+                HashRotl(v4, 18) + (uint64_t)size;
+  uint64_t hi = v1 ^ HashRotl(v2, 11) ^ HashRotl(v3, 29) ^ HashRotl(v4, 41) ^
+                ((uint64_t)size * HASH_P4);
+  while (end - p >= 8) {
+    uint64_t word = HashRead64(p);
+    lo = HashRotl(lo ^ HashRound(0, word), 27) * HASH_P1 + HASH_P4;
+    hi = HashRotl(hi + word * HASH_P3, 31) * HASH_P2;
+    p += 8;
+  }
+  uint64_t tail = 0;
+  for (int i = 0; p + i < end; ++i) tail |= (uint64_t)p[i] << (8 * i);
+  return HashPair(lo ^ tail, hi + HashMix(tail ^ seed));
+}
+
+/**
+ * @brief Reads an NNInt, failing if it does not fit into the buffer.
+ */
+static bool HashReadNNInt(const uint8_t **p, const uint8_t *end,
+                          uint64_t *value) {
+  if (*p >= end) return false;
+  size_t n = **p;
+  ++*p;
+  if (n > 8 || (size_t)(end - *p) < n) return false;
+  uint64_t v = 0;
+  for (size_t i = 0; i < n; ++i) v |= (uint64_t)(*p)[i] << (8 * i);
+  *p += n;
+  *value = v;
+  return true;
+}
+
+/**
+ * @brief Hashes one tuple and advances past it.
+ *
+ * The hash of a SET member covers its sequence number; array elements are
+ * hashed without it, as their position is covered by the order in which
+ * the array combines them.
+ */
+static bool HashTuple(const uint8_t **p, const uint8_t *end, int depth,
+                      bool is_array_item, BejHashValue *out) {
+  uint64_t seq, length;
+  if (!HashReadNNInt(p, end, &seq) || *p >= end) return false;
+  uint8_t format = **p >> 4;
+  ++*p;
+  if (!HashReadNNInt(p, end, &length) || (uint64_t)(end - *p) < length) {
+    return false;
+  }
+  const uint8_t *value = *p;
+  const uint8_t *value_end = *p + length;
+  *p = value_end;
+  uint64_t key = (format + 1u) * HASH_P4 ^
+                 (is_array_item ? 0 : HashRotl((seq + 1) * HASH_P3, 17));
+
+  switch (format) {
+    case BEJ_FORMAT_SET:
+    case BEJ_FORMAT_ARRAY: {
+      uint64_t count;
+      if (depth >= HASH_MAX_DEPTH ||
+          !HashReadNNInt(&value, value_end, &count)) {
+        return false;
+      }
+      BejHashValue acc = {key, ~key};
+      for (uint64_t i = 0; i < count; ++i) {
+        BejHashValue member;
+        if (!HashTuple(&value, value_end, depth + 1,
+                       format == BEJ_FORMAT_ARRAY, &member)) {
+          return false;
+        }
+        if (format == BEJ_FORMAT_SET) {
+          // Addition is commutative, so member order does not matter.
+          acc.lo += member.lo;
+          acc.hi += member.hi;
+        } else {
+          acc.lo = HashRound(acc.lo, member.lo);
+          acc.hi = HashRound(acc.hi ^ acc.lo, member.hi);
+        }
+      }
+      *out = HashPair(acc.lo ^ key, acc.hi + count);
+      return true;
+    }
+    case BEJ_FORMAT_INTEGER: {
+      if (length > 8) return false;
+      uint64_t raw = 0;
+      for (size_t i = 0; i < length; ++i) {
+        raw |= (uint64_t)value[i] << (8 * i);
+      }
+      if (length > 0 && length < 8 && (value[length - 1] & 0x80)) {
+        raw |= ~0ULL << (8 * length);
+      }
+      *out = HashPair(key, raw);
+      return true;
+    }
+    case BEJ_FORMAT_BOOLEAN: {
+      // Only 0x01 is true, as in BejDecode().
+      uint64_t raw = 0;
+      for (size_t i = 0; i < length && i < 8; ++i) {
+        raw |= (uint64_t)value[i] << (8 * i);
+      }
+      *out = HashPair(key, raw == 1);
+      return true;
+    }
+    case BEJ_FORMAT_ENUM: {
+      uint64_t enum_seq;
+      if (!HashReadNNInt(&value, value_end, &enum_seq)) return false;
+      *out = HashPair(key, enum_seq);
+      return true;
+    }
+    case BEJ_FORMAT_STRING:
+      *out = BejHashBytes(value, length > 0 ? length - 1 : 0, key);
+      return true;
+    case BEJ_FORMAT_NULL:
+      *out = HashPair(key, 0);
+      return true;
+    default:
+      // Other formats are opaque: their bytes are their value.
+      *out = BejHashBytes(value, length, key);
+      return true;
+  }
+}
+
+bool BejHash(const uint8_t *payload, size_t size, BejHashValue *out) {
+  InputStream in = {payload, size, 0};
+  if (!BejReadHeader(&in)) return false;
+
+  const uint8_t *p = payload + in.pos;
+  const uint8_t *end = payload + size;
+  if (p >= end) {
+    *out = HashPair(0, 0);
+    return true;
+  }
+
+  return HashTuple(&p, end, 0, false, out);
+}
+
+bool BejHashEqual(const BejHashValue *a, const BejHashValue *b) {
+  return a->lo == b->lo && a->hi == b->hi;
+}
+
+void BejHashFormat(const BejHashValue *hash, char *out) {
+  snprintf(out, BEJ_HASH_HEX_SIZE, "%016llx%016llx",
+           (unsigned long long)hash->hi, (unsigned long long)hash->lo);
+}
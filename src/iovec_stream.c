@@ -0,0 +1,99 @@
+#include "iovec_stream.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+void IovecStreamInit(IovecStream *stream, int fd) {
+  stream->iov_count = 0;
+  stream->scratch_pos = 0;
+  stream->total = 0;
+  stream->fd = fd;
+  stream->error = false;
+}
+
+/**
+ * @brief Appends a fragment, extending the previous iovec when the fragment
+ * directly follows it in memory.
+ */
+static void IovecStreamAppend(IovecStream *stream, const char *buf,
+                              size_t len) {
+  if (stream->iov_count > 0) {
+    struct iovec *last = &stream->iov[stream->iov_count - 1];
+    if ((const char *)last->iov_base + last->iov_len == buf) {
+      last->iov_len += len;
+      stream->total += len;
+      return;
+    }
+  }
+  if (stream->iov_count == IOVEC_STREAM_MAX_IOV &&
+      !IovecStreamFlush(stream)) {
+    return;
+  }
+  stream->iov[stream->iov_count].iov_base = (void *)buf;
+  stream->iov[stream->iov_count].iov_len = len;
+  stream->iov_count++;
+  stream->total += len;
+}
+
+void IovecStreamWrite(IovecStream *stream, const char *buf, size_t len) {
+  if (stream->error || len == 0) return;
+  if (len > IOVEC_STREAM_SCRATCH_SIZE) {
+    stream->error = true;
+    return;
+  }
+  // Flush first if the copy may need a new iovec or more scratch space, so
+  // the scratch buffer is never reset while a pending iovec points into it.
+  if ((stream->iov_count == IOVEC_STREAM_MAX_IOV ||
+       stream->scratch_pos + len > IOVEC_STREAM_SCRATCH_SIZE) &&
+      !IovecStreamFlush(stream)) {
+    return;
+  }
+  char *dst = stream->scratch + stream->scratch_pos;
+  memcpy(dst, buf, len);
+  stream->scratch_pos += len;
+  IovecStreamAppend(stream, dst, len);
+}
+
+void IovecStreamWriteRef(IovecStream *stream, const char *buf, size_t len) {
+  if (stream->error || len == 0) return;
+  if (len < IOVEC_STREAM_MIN_REF) {
+    IovecStreamWrite(stream, buf, len);
+    return;
+  }
+  IovecStreamAppend(stream, buf, len);
+}
+
+bool IovecStreamFlush(IovecStream *stream) {
+  if (stream->error) return false;
+  if (stream->fd < 0) {
+    if (stream->iov_count == 0) return true;
+    stream->error = true;
+    return false;
+  }
+
+  struct iovec *iov = stream->iov;
+  size_t count = stream->iov_count;
+  while (count > 0) {
+    ssize_t written = writev(stream->fd, iov, (int)count);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      stream->error = true;
+      return false;
+    }
+    size_t remaining = (size_t)written;
+    while (count > 0 && remaining >= iov->iov_len) {
+      remaining -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char *)iov->iov_base + remaining;
+      iov->iov_len -= remaining;
+    }
+  }
+
+  stream->iov_count = 0;
+  stream->scratch_pos = 0;
+  return true;
+}
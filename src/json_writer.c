@@ -1,6 +1,14 @@
 #include "json_writer.h"
 
 #include <stdio.h>
+#include <string.h>
+
+#define JSON_GATHER_MAX_INDENT 32
+
+/** A newline followed by JSON_GATHER_MAX_INDENT levels of indentation. */
+static const char kGatherIndent[] =
+    "\n                                                                "
+    "                                                                ";
 
 void JsonWriteIndent(OutputStream *out, int indent_level) {
   OutputStreamWrite(out, "\n", 1);
@@ -10,6 +18,85 @@ void JsonWriteIndent(OutputStream *out, int indent_level) {
   }
 }
 
+void JsonGatherWriteIndent(IovecStream *stream, int indent_level) {
+  if (indent_level > JSON_GATHER_MAX_INDENT) {
+    IovecStreamWriteRef(stream, kGatherIndent,
+                        1 + JSON_GATHER_MAX_INDENT * 4);
+    for (int i = JSON_GATHER_MAX_INDENT; i < indent_level; ++i) {
+      IovecStreamWrite(stream, "    ", 4);
+    }
+    return;
+  }
+  IovecStreamWriteRef(stream, kGatherIndent, 1 + (size_t)indent_level * 4);
+}
+
+/**
+ * @brief Writes the escape sequence for `c` into `buf`.
+ *
+ * @return The length of the sequence, or 0 if `c` needs no escaping.
+ */
+static size_t JsonEscape(unsigned char c, char *buf) {
+  static const char kHex[] = "0123456789abcdef";
+  if (c >= 0x20 && c != '"' && c != '\\') return 0;
+  buf[0] = '\\';
+  switch (c) {
+    case '"':
+    case '\\':
+      buf[1] = (char)c;
+      return 2;
+    case '\b':
+      buf[1] = 'b';
+      return 2;
+    case '\f':
+      buf[1] = 'f';
+      return 2;
+    case '\n':
+      buf[1] = 'n';
+      return 2;
+    case '\r':
+      buf[1] = 'r';
+      return 2;
+    case '\t':
+      buf[1] = 't';
+      return 2;
+    default:
+      memcpy(buf + 1, "u00", 3);
+      buf[4] = kHex[c >> 4];
+      buf[5] = kHex[c & 0x0F];
+      return 6;
+  }
+}
+
+void JsonWriteString(OutputStream *stream, const char *text, size_t len) {
+  OutputStreamWrite(stream, "\"", 1);
+  size_t start = 0;
+  for (size_t i = 0; i < len; ++i) {
+    char escaped[6];
+    size_t n = JsonEscape((unsigned char)text[i], escaped);
+    if (n == 0) continue;
+    OutputStreamWrite(stream, text + start, i - start);
+    OutputStreamWrite(stream, escaped, n);
+    start = i + 1;
+  }
+  OutputStreamWrite(stream, text + start, len - start);
+  OutputStreamWrite(stream, "\"", 1);
+}
+
+void JsonGatherWriteString(IovecStream *stream, const char *text, size_t len) {
+  IovecStreamWrite(stream, "\"", 1);
+  size_t start = 0;
+  for (size_t i = 0; i < len; ++i) {
+    char escaped[6];
+    size_t n = JsonEscape((unsigned char)text[i], escaped);
+    if (n == 0) continue;
+    IovecStreamWriteRef(stream, text + start, i - start);
+    IovecStreamWrite(stream, escaped, n);
+    start = i + 1;
+  }
+  IovecStreamWriteRef(stream, text + start, len - start);
+  IovecStreamWrite(stream, "\"", 1);
+}
+
 bool JsonWriterFlushToFile(const OutputStream *stream,
                                const char *filename) {
   if (!stream || stream->pos == 0) return false;
@@ -1,9 +1,25 @@
+#include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "archive.h"
+#include "batch.h"
 #include "decoder.h"
+#ifdef BEJ_USE_ARENA_ALLOCATOR
+#include "document.h"
+#endif
+#include "export.h"
+#include "hash.h"
 #include "json_writer.h"
+#include "parallel.h"
+#include "pipeline.h"
+#include "query.h"
 #include "stream_utils.h"
+#include "transcode.h"
 
 /**
  * @brief Reads a file into a dynamically allocated buffer.
@@ -51,19 +67,790 @@ static uint8_t *ReadFile(const char *filename, size_t *size) {
   return buf;
 }
 
+/**
+ * @brief Loads every dictionary named on the command line.
+ *
+ * @return An array of `count` streams, or NULL on failure.
+ */
+static InputStream *LoadDictionaries(char **paths, size_t count) {
+  InputStream *dicts = calloc(count ? count : 1, sizeof(*dicts));
+  if (!dicts) return NULL;
+  for (size_t i = 0; i < count; ++i) {
+    size_t size = 0;
+    uint8_t *data = ReadFile(paths[i], &size);
+    if (!data) {
+      for (size_t j = 0; j < i; ++j) free((void *)dicts[j].data);
+      free(dicts);
+      return NULL;
+    }
+    dicts[i] = (InputStream){data, size, 0};
+  }
+  return dicts;
+}
+
+/**
+ * @brief Frees dictionaries returned by LoadDictionaries().
+ */
+static void FreeDictionaries(InputStream *dicts, size_t count) {
+  if (!dicts) return;
+  for (size_t i = 0; i < count; ++i) free((void *)dicts[i].data);
+  free(dicts);
+}
+
+/**
+ * @brief Decodes a payload straight to a file with writev(), referencing
+ * strings in the payload and dictionary buffers instead of copying them.
+ *
+ * @return true if decoding and writing succeeded, false otherwise.
+ */
+static bool DecodeGatherToFile(InputStream *payload_is, InputStream *schema_is,
+                               const char *output_path) {
+  int fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Error: cannot open %s\n", output_path);
+    return false;
+  }
+
+  static IovecStream gather;
+  IovecStreamInit(&gather, fd);
+  bool ok = BejDecodeGather(&gather, payload_is, schema_is) &&
+            IovecStreamFlush(&gather);
+  ok = (close(fd) == 0) && ok;
+  return ok;
+}
+
+/**
+ * @brief Runs the framed stdin/stdout pipeline.
+ *
+ * Usage: pipe [--tagged] [--flush] [--cache MiB] <schema_dict.bin>...
+ * Dictionary ids are the positions of the dictionaries on the command line,
+ * starting at 0.
+ */
+static int RunPipe(int argc, char **argv) {
+  PipelineOptions options = {false, false, 0};
+  int arg = 0;
+  for (; arg < argc && argv[arg][0] == '-'; ++arg) {
+    if (strcmp(argv[arg], "--tagged") == 0) {
+      options.tagged = true;
+    } else if (strcmp(argv[arg], "--flush") == 0) {
+      options.flush_each_record = true;
+    } else if (strcmp(argv[arg], "--cache") == 0 && arg + 1 < argc) {
+      options.cache_bytes = strtoul(argv[++arg], NULL, 10) * 1024 * 1024;
+    } else {
+      fprintf(stderr, "Error: unknown option %s\n", argv[arg]);
+      return 1;
+    }
+  }
+  size_t dict_count = (size_t)(argc - arg);
+  if (dict_count == 0) {
+    fprintf(stderr, "Error: pipe needs at least one dictionary\n");
+    return 1;
+  }
+
+  InputStream *dicts = LoadDictionaries(&argv[arg], dict_count);
+  if (!dicts) return 2;
+
+  setvbuf(stdin, NULL, _IOFBF, PIPELINE_IO_BUFFER_SIZE);
+  setvbuf(stdout, NULL, _IOFBF, PIPELINE_IO_BUFFER_SIZE);
+
+  int rc = 0;
+  PipelineStats stats;
+  if (!PipelineRun(stdin, stdout, dicts, dict_count, &options, &stats)) {
+    rc = 3;
+  }
+  fprintf(stderr, "Decoded %zu records (%zu failed)\n", stats.records,
+          stats.failed);
+  if (options.cache_bytes > 0) {
+    uint64_t lookups = stats.cache.hits + stats.cache.misses;
+    fprintf(stderr,
+            "Subtree cache: %" PRIu64 " hits, %" PRIu64
+            " misses (%.1f%% hit rate), %zu entries, %zu bytes\n",
+            stats.cache.hits, stats.cache.misses,
+            lookups ? 100.0 * stats.cache.hits / lookups : 0.0,
+            stats.cache.entries, stats.cache.bytes);
+  }
+
+  FreeDictionaries(dicts, dict_count);
+  return rc;
+}
+
+/**
+ * @brief Appends payload files to an archive.
+ *
+ * Usage: archive append <archive> <dict_id> <payload.bin>...
+ */
+static int RunArchiveAppend(int argc, char **argv) {
+  if (argc < 3) return 1;
+  const char *path = argv[0];
+  long dict_id = strtol(argv[1], NULL, 10);
+  if (dict_id < 0 || dict_id > UINT16_MAX) {
+    fprintf(stderr, "Error: invalid dictionary id %s\n", argv[1]);
+    return 1;
+  }
+
+  BejArchiveWriter writer;
+  if (!BejArchiveWriterOpen(&writer, path)) {
+    fprintf(stderr, "Error: cannot open archive %s\n", path);
+    return 2;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  uint64_t timestamp =
+      (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+
+  int rc = 0;
+  for (int i = 2; i < argc && rc == 0; ++i) {
+    size_t size = 0;
+    uint8_t *payload = ReadFile(argv[i], &size);
+    if (!payload ||
+        !BejArchiveAppend(&writer, (uint16_t)dict_id, timestamp, payload,
+                          size)) {
+      rc = 2;
+    }
+    free(payload);
+  }
+  size_t count = writer.record_count;
+  if (!BejArchiveWriterClose(&writer)) rc = 2;
+  if (rc == 0) printf("%s now holds %zu records\n", path, count);
+  return rc;
+}
+
+/**
+ * @brief Lists the records of an archive.
+ *
+ * Usage: archive list <archive>
+ */
+static int RunArchiveList(int argc, char **argv) {
+  if (argc < 1) return 1;
+  BejArchive archive;
+  if (!BejArchiveOpen(&archive, argv[0])) return 2;
+
+  int rc = 0;
+  printf("index\tsize\tdictionary\ttimestamp\n");
+  for (size_t i = 0; i < archive.record_count; ++i) {
+    BejArchiveRecord record;
+    if (!BejArchiveGetRecord(&archive, i, &record)) {
+      fprintf(stderr, "Error: record %zu is corrupt\n", i);
+      rc = 3;
+      break;
+    }
+    printf("%zu\t%u\t%u\t%llu\n", i, record.size, record.dictionary_id,
+           (unsigned long long)record.timestamp);
+  }
+  BejArchiveClose(&archive);
+  return rc;
+}
+
+/**
+ * @brief Decodes a single archived record.
+ *
+ * Usage: archive get <archive> <index> <schema_dict.bin> [output.json]
+ */
+static int RunArchiveGet(int argc, char **argv) {
+  if (argc < 3) return 1;
+  const char *output_path = (argc > 3) ? argv[3] : "decoded.json";
+
+  BejArchive archive;
+  if (!BejArchiveOpen(&archive, argv[0])) return 2;
+
+  BejArchiveRecord record;
+  size_t index = (size_t)strtoull(argv[1], NULL, 10);
+  if (!BejArchiveGetRecord(&archive, index, &record)) {
+    fprintf(stderr, "Error: no record %s in %s\n", argv[1], argv[0]);
+    BejArchiveClose(&archive);
+    return 2;
+  }
+
+  InputStream *dict = LoadDictionaries(&argv[2], 1);
+  if (!dict) {
+    BejArchiveClose(&archive);
+    return 2;
+  }
+
+  InputStream payload_is = {record.payload, record.size, 0};
+  OutputStream out;
+  OutputStreamInit(&out);
+  if (BejDecode(&out, &payload_is, dict)) {
+    printf("Decoded JSON written to %s\n", output_path);
+    JsonWriterFlushToFile(&out, output_path);
+  } else {
+    fprintf(stderr, "Decode failed\n");
+  }
+
+  FreeDictionaries(dict, 1);
+  BejArchiveClose(&archive);
+  return 0;
+}
+
+/**
+ * @brief Decodes a whole archive into NDJSON on stdout.
+ *
+ * Usage: archive decode [-j threads] <archive> <schema_dict.bin>...
+ */
+static int RunArchiveDecode(int argc, char **argv) {
+  size_t threads = ParallelDefaultThreadCount();
+  int arg = 0;
+  if (argc > 1 && strcmp(argv[0], "-j") == 0) {
+    threads = (size_t)strtoul(argv[1], NULL, 10);
+    arg = 2;
+  }
+  if (argc - arg < 2) return 1;
+
+  BejArchive archive;
+  if (!BejArchiveOpen(&archive, argv[arg])) return 2;
+
+  size_t dict_count = (size_t)(argc - arg - 1);
+  InputStream *dicts = LoadDictionaries(&argv[arg + 1], dict_count);
+  if (!dicts) {
+    BejArchiveClose(&archive);
+    return 2;
+  }
+
+  setvbuf(stdout, NULL, _IOFBF, PIPELINE_IO_BUFFER_SIZE);
+  BejArchiveDecodeStats stats;
+  int rc = BejArchiveDecodeAll(&archive, dicts, dict_count, threads, stdout,
+                               &stats)
+               ? 0
+               : 3;
+  fprintf(stderr, "Decoded %zu records (%zu failed)\n", stats.records,
+          stats.failed);
+
+  FreeDictionaries(dicts, dict_count);
+  BejArchiveClose(&archive);
+  return rc;
+}
+
+/**
+ * @brief Dispatches the archive subcommands.
+ */
+static int RunArchive(int argc, char **argv) {
+  int rc = 1;
+  if (argc > 0 && strcmp(argv[0], "append") == 0) {
+    rc = RunArchiveAppend(argc - 1, argv + 1);
+  } else if (argc > 0 && strcmp(argv[0], "list") == 0) {
+    rc = RunArchiveList(argc - 1, argv + 1);
+  } else if (argc > 0 && strcmp(argv[0], "get") == 0) {
+    rc = RunArchiveGet(argc - 1, argv + 1);
+  } else if (argc > 0 && strcmp(argv[0], "decode") == 0) {
+    rc = RunArchiveDecode(argc - 1, argv + 1);
+  }
+  if (rc == 1) {
+    fprintf(stderr,
+            "Usage: archive append <archive> <dict_id> <payload.bin>...\n"
+            "       archive list <archive>\n"
+            "       archive get <archive> <index> <schema_dict.bin> "
+            "[output.json]\n"
+            "       archive decode [-j threads] <archive> "
+            "<schema_dict.bin>...\n");
+  }
+  return rc;
+}
+
+/**
+ * @brief Prints the payloads matching a query as NDJSON on stdout.
+ *
+ * Usage: query [-j threads] <schema_dict.bin> <expression> <payload.bin>...
+ */
+static int RunQuery(int argc, char **argv) {
+  size_t threads = ParallelDefaultThreadCount();
+  int arg = 0;
+  if (argc > 1 && strcmp(argv[0], "-j") == 0) {
+    threads = (size_t)strtoul(argv[1], NULL, 10);
+    arg = 2;
+  }
+  if (argc - arg < 3) {
+    fprintf(stderr,
+            "Usage: query [-j threads] <schema_dict.bin> <expression> "
+            "<payload.bin>...\n");
+    return 1;
+  }
+
+  size_t dict_size = 0;
+  uint8_t *dict = ReadFile(argv[arg], &dict_size);
+  if (!dict) return 2;
+
+  BejQuery query;
+  bool compiled = BejQueryCompile(&query, dict, dict_size, argv[arg + 1]);
+  free(dict);
+  if (!compiled) return 1;
+
+  setvbuf(stdout, NULL, _IOFBF, PIPELINE_IO_BUFFER_SIZE);
+  BejQueryStats stats;
+  int rc = BejQueryRunFiles(&query, &argv[arg + 2], (size_t)(argc - arg - 2),
+                            threads, stdout, &stats)
+               ? 0
+               : 3;
+  fprintf(stderr, "Matched %zu of %zu payloads (%zu failed)\n",
+          stats.matched, stats.payloads, stats.failed);
+
+  BejQueryRelease(&query);
+  return rc;
+}
+
+/**
+ * @brief Exports payloads sharing one dictionary as CSV or binary columns.
+ *
+ * Usage: export [--binary] <schema_dict.bin> <output> <payload.bin>...
+ */
+static int RunExport(int argc, char **argv) {
+  BejExportFormat format = BEJ_EXPORT_CSV;
+  int arg = 0;
+  if (argc > 0 && strcmp(argv[0], "--binary") == 0) {
+    format = BEJ_EXPORT_BINARY;
+    arg = 1;
+  }
+  if (argc - arg < 3) {
+    fprintf(stderr,
+            "Usage: export [--binary] <schema_dict.bin> <output> "
+            "<payload.bin>...\n");
+    return 1;
+  }
+
+  size_t dict_size = 0;
+  uint8_t *dict = ReadFile(argv[arg], &dict_size);
+  if (!dict) return 2;
+  FILE *out = fopen(argv[arg + 1], "wb");
+  if (!out) {
+    fprintf(stderr, "Error: cannot open %s\n", argv[arg + 1]);
+    free(dict);
+    return 2;
+  }
+
+  BejExporter exporter;
+  bool opened = BejExporterOpen(&exporter, dict, dict_size, format, out);
+  free(dict);
+  if (!opened) {
+    fclose(out);
+    return 2;
+  }
+
+  for (int i = arg + 2; i < argc; ++i) {
+    size_t size = 0;
+    uint8_t *payload = ReadFile(argv[i], &size);
+    if (!BejExporterAdd(&exporter, payload, payload ? size : 0)) {
+      fprintf(stderr, "Error: %s could not be exported\n", argv[i]);
+    }
+    free(payload);
+  }
+  size_t rows = exporter.rows;
+  size_t failed = exporter.failed;
+  bool ok = BejExporterClose(&exporter);
+  ok = (fclose(out) == 0) && ok;
+  fprintf(stderr, "Exported %zu rows (%zu failed) to %s\n", rows, failed,
+          argv[arg + 1]);
+  return ok ? 0 : 3;
+}
+
+/**
+ * @brief Rewrites a payload for a newer version of its dictionary.
+ *
+ * Usage: transcode <from_dict.bin> <to_dict.bin> <payload.bin> <output.bin>
+ */
+static int RunTranscode(int argc, char **argv) {
+  if (argc < 4) {
+    fprintf(stderr,
+            "Usage: transcode <from_dict.bin> <to_dict.bin> <payload.bin> "
+            "<output.bin>\n");
+    return 1;
+  }
+
+  size_t from_size = 0, to_size = 0, payload_size = 0;
+  uint8_t *from = ReadFile(argv[0], &from_size);
+  uint8_t *to = ReadFile(argv[1], &to_size);
+  uint8_t *payload = ReadFile(argv[2], &payload_size);
+  BejTranslation translation;
+  bool ok = from && to && payload &&
+            BejTranslationCreate(&translation, from, from_size, to, to_size);
+  free(from);
+  free(to);
+  if (!ok) {
+    free(payload);
+    return 2;
+  }
+
+  static OutputStream out;
+  size_t dropped = 0;
+  int rc = 0;
+  if (BejTranscode(&translation, payload, payload_size, &out, &dropped)) {
+    FILE *f = fopen(argv[3], "wb");
+    if (!f || fwrite(out.data, 1, out.pos, f) != out.pos) rc = 3;
+    if (f && fclose(f) != 0) rc = 3;
+    if (rc == 0) {
+      printf("Transcoded %zu -> %zu bytes into %s (%zu dropped)\n",
+             payload_size, out.pos, argv[3], dropped);
+    }
+  } else {
+    fprintf(stderr, "Transcode failed\n");
+    rc = 3;
+  }
+
+  BejTranslationRelease(&translation);
+  free(payload);
+  return rc;
+}
+
+/**
+ * @struct HashedFile
+ * @brief Content hash of one command-line payload.
+ */
+typedef struct {
+  BejHashValue hash;
+  size_t index;
+} HashedFile;
+
+/**
+ * @brief Orders hashed files by hash, then by position.
+ */
+static int CompareHashedFiles(const void *a, const void *b) {
+  const HashedFile *lhs = a;
+  const HashedFile *rhs = b;
+  if (lhs->hash.hi != rhs->hash.hi) {
+    return lhs->hash.hi < rhs->hash.hi ? -1 : 1;
+  }
+  if (lhs->hash.lo != rhs->hash.lo) {
+    return lhs->hash.lo < rhs->hash.lo ? -1 : 1;
+  }
+  return (lhs->index > rhs->index) - (lhs->index < rhs->index);
+}
+
+/**
+ * @brief Prints the content hash of every payload.
+ *
+ * Usage: hash [--unique] <payload.bin>... Each line is `<hash>  <file>`.
+ * With --unique only the first file of each distinct content is listed.
+ */
+static int RunHash(int argc, char **argv) {
+  int arg = 0;
+  bool unique = argc > 0 && strcmp(argv[0], "--unique") == 0;
+  if (unique) arg++;
+  if (argc - arg < 1) {
+    fprintf(stderr, "Usage: hash [--unique] <payload.bin>...\n");
+    return 1;
+  }
+
+  size_t count = (size_t)(argc - arg);
+  HashedFile *files = calloc(count, sizeof(*files));
+  bool *valid = calloc(count, sizeof(*valid));
+  if (!files || !valid) {
+    free(files);
+    free(valid);
+    return 2;
+  }
+
+  int rc = 0;
+  for (size_t i = 0; i < count; ++i) {
+    size_t size = 0;
+    uint8_t *payload = ReadFile(argv[arg + i], &size);
+    files[i].index = i;
+    valid[i] = payload && BejHash(payload, size, &files[i].hash);
+    if (!valid[i]) {
+      if (payload) fprintf(stderr, "Error: cannot hash %s\n", argv[arg + i]);
+      rc = 3;
+    }
+    free(payload);
+  }
+
+  // Sorting a copy finds the later duplicates of each content.
+  bool *duplicate = calloc(count, sizeof(*duplicate));
+  HashedFile *sorted = malloc(count * sizeof(*sorted));
+  if (unique && duplicate && sorted) {
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+      if (valid[i]) sorted[n++] = files[i];
+    }
+    qsort(sorted, n, sizeof(*sorted), CompareHashedFiles);
+    for (size_t i = 1; i < n; ++i) {
+      duplicate[sorted[i].index] =
+          BejHashEqual(&sorted[i].hash, &sorted[i - 1].hash);
+    }
+  } else if (unique) {
+    rc = 2;
+  }
+
+  size_t duplicates = 0;
+  for (size_t i = 0; rc != 2 && i < count; ++i) {
+    if (!valid[i]) continue;
+    if (unique && duplicate[i]) {
+      duplicates++;
+      continue;
+    }
+    char hex[BEJ_HASH_HEX_SIZE];
+    BejHashFormat(&files[i].hash, hex);
+    printf("%s  %s\n", hex, argv[arg + i]);
+  }
+  if (unique && rc != 2) {
+    fprintf(stderr, "%zu duplicates skipped\n", duplicates);
+  }
+
+  free(sorted);
+  free(duplicate);
+  free(files);
+  free(valid);
+  return rc;
+}
+
+/**
+ * @brief Decodes many payload files into JSON files in a directory and
+ * reports the throughput.
+ *
+ * Usage: batch [--backend sync|pread|uring] [--depth N] <schema_dict.bin>
+ * <output_dir> <payload.bin>... Each payload `dir/name.bin` is written to
+ * `output_dir/name.json`.
+ */
+static int RunBatch(int argc, char **argv) {
+  BejBatchOptions options = {
+      BejBatchUringAvailable() ? BEJ_BATCH_URING : BEJ_BATCH_PREAD,
+      BEJ_BATCH_DEFAULT_QUEUE_DEPTH};
+  int arg = 0;
+  for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+    if (strcmp(argv[arg], "--backend") == 0) {
+      const char *name = argv[arg + 1];
+      if (strcmp(name, "sync") == 0) {
+        options.backend = BEJ_BATCH_SYNC;
+      } else if (strcmp(name, "pread") == 0) {
+        options.backend = BEJ_BATCH_PREAD;
+      } else if (strcmp(name, "uring") == 0) {
+        options.backend = BEJ_BATCH_URING;
+      } else {
+        fprintf(stderr, "Error: unknown backend %s\n", name);
+        return 1;
+      }
+    } else if (strcmp(argv[arg], "--depth") == 0) {
+      options.queue_depth = (size_t)strtoul(argv[arg + 1], NULL, 10);
+    } else {
+      fprintf(stderr, "Error: unknown option %s\n", argv[arg]);
+      return 1;
+    }
+  }
+  if (argc - arg < 3) {
+    fprintf(stderr,
+            "Usage: batch [--backend sync|pread|uring] [--depth N] "
+            "<schema_dict.bin> <output_dir> <payload.bin>...\n");
+    return 1;
+  }
+
+  size_t count = (size_t)(argc - arg - 2);
+  char **inputs = &argv[arg + 2];
+  char **outputs = calloc(count, sizeof(*outputs));
+  size_t dict_size = 0;
+  uint8_t *dict = ReadFile(argv[arg], &dict_size);
+  BejDecoder *decoder = dict ? BejDecoderCreate(dict, dict_size) : NULL;
+  free(dict);
+  int rc = (outputs && decoder) ? 0 : 2;
+
+  for (size_t i = 0; rc == 0 && i < count; ++i) {
+    const char *name = strrchr(inputs[i], '/');
+    name = name ? name + 1 : inputs[i];
+    const char *ext = strrchr(name, '.');
+    int name_len = ext ? (int)(ext - name) : (int)strlen(name);
+    size_t size = strlen(argv[arg + 1]) + (size_t)name_len + 7;
+    outputs[i] = malloc(size);
+    if (!outputs[i]) {
+      rc = 2;
+      break;
+    }
+    snprintf(outputs[i], size, "%s/%.*s.json", argv[arg + 1], name_len,
+             name);
+  }
+
+  if (rc == 0) {
+    BejBatchStats stats;
+    if (!BejBatchDecodeFiles(decoder, inputs, outputs, count, &options,
+                             &stats)) {
+      rc = 3;
+    }
+    printf("Decoded %zu files (%zu failed) in %.3f s with %s: %.0f files/s, "
+           "%.1f MB/s read\n",
+           stats.files, stats.failed, stats.seconds,
+           BejBatchBackendName(stats.backend),
+           stats.seconds > 0 ? (double)stats.files / stats.seconds : 0.0,
+           stats.seconds > 0 ? (double)stats.bytes_read / stats.seconds / 1e6
+                             : 0.0);
+  }
+
+  if (outputs) {
+    for (size_t i = 0; i < count; ++i) free(outputs[i]);
+  }
+  free(outputs);
+  BejDecoderDestroy(decoder);
+  return rc;
+}
+
+#ifdef BEJ_USE_ARENA_ALLOCATOR
+/**
+ * @brief Applies one `path=value` assignment or `-path` removal.
+ */
+static bool ApplyEdit(BejDocument *doc, const char *edit) {
+  if (edit[0] == '-') {
+    return BejDocumentRemove(doc, BejDocumentFindPath(doc, edit + 1));
+  }
+  const char *eq = strchr(edit, '=');
+  if (!eq) return false;
+
+  char path[256];
+  size_t len = (size_t)(eq - edit);
+  if (len >= sizeof(path)) return false;
+  memcpy(path, edit, len);
+  path[len] = '\0';
+  const char *value = eq + 1;
+
+  uint32_t index = BejDocumentFindPath(doc, path);
+  if (index == BEJ_NODE_NONE) return false;
+  switch (doc->nodes[index].type) {
+    case BEJ_NODE_INTEGER: {
+      char *end;
+      long long number = strtoll(value, &end, 10);
+      return *value && !*end && BejDocumentSetInteger(doc, index, number);
+    }
+    case BEJ_NODE_BOOLEAN:
+      if (strcmp(value, "true") != 0 && strcmp(value, "false") != 0) {
+        return false;
+      }
+      return BejDocumentSetBoolean(doc, index, strcmp(value, "true") == 0);
+    case BEJ_NODE_STRING:
+      return BejDocumentSetString(doc, index, value);
+    case BEJ_NODE_ENUM:
+      return BejDocumentSetEnum(doc, index, value);
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Edits properties of a payload and writes the re-encoded payload.
+ *
+ * Usage: edit <schema_dict.bin> <payload.bin> <output.bin> <edit>... where
+ * each edit is `path=value` or `-path` to remove a property.
+ */
+static int RunEdit(int argc, char **argv) {
+  if (argc < 4) {
+    fprintf(stderr,
+            "Usage: edit <schema_dict.bin> <payload.bin> <output.bin> "
+            "<path=value|-path>...\n");
+    return 1;
+  }
+
+  size_t dict_size = 0, payload_size = 0;
+  uint8_t *dict_data = ReadFile(argv[0], &dict_size);
+  uint8_t *payload = ReadFile(argv[1], &payload_size);
+  CompiledDictionary dict;
+  if (!dict_data || !payload ||
+      !DictionaryCompile(&dict, dict_data, dict_size)) {
+    free(dict_data);
+    free(payload);
+    return 2;
+  }
+
+  Arena arena;
+  ArenaInit(&arena, 0);
+  BejDocument doc;
+  int rc = 0;
+  if (!BejDocumentParse(&doc, &arena, &dict, payload, payload_size)) {
+    fprintf(stderr, "Error: cannot parse %s\n", argv[1]);
+    rc = 3;
+  }
+  for (int i = 3; rc == 0 && i < argc; ++i) {
+    if (!ApplyEdit(&doc, argv[i])) {
+      fprintf(stderr, "Error: cannot apply %s\n", argv[i]);
+      rc = 3;
+    }
+  }
+
+  static OutputStream out;
+  OutputStreamInit(&out);
+  if (rc == 0 && BejDocumentWriteBej(&doc, &out)) {
+    FILE *f = fopen(argv[2], "wb");
+    if (!f || fwrite(out.data, 1, out.pos, f) != out.pos) rc = 3;
+    if (f && fclose(f) != 0) rc = 3;
+    if (rc == 0) {
+      printf("Wrote %zu bytes to %s (%d edits)\n", out.pos, argv[2],
+             argc - 3);
+    }
+  } else if (rc == 0) {
+    rc = 3;
+  }
+
+  ArenaRelease(&arena);
+  DictionaryRelease(&dict);
+  free(dict_data);
+  free(payload);
+  return rc;
+}
+#endif
+
+/**
+ * @brief Prints the command line usage.
+ */
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [--gather] <schema_dict.bin> <payload.bin> "
+          "[output.json]\n"
+          "       %s pipe [--tagged] [--flush] [--cache MiB] "
+          "<schema_dict.bin>...\n"
+          "       %s archive <append|list|get|decode> ...\n"
+          "       %s query [-j threads] <schema_dict.bin> <expression> "
+          "<payload.bin>...\n"
+          "       %s export [--binary] <schema_dict.bin> <output> "
+          "<payload.bin>...\n"
+          "       %s transcode <from_dict.bin> <to_dict.bin> <payload.bin> "
+          "<output.bin>\n"
+          "       %s batch [--backend sync|pread|uring] [--depth N] "
+          "<schema_dict.bin> <output_dir> <payload.bin>...\n"
+          "       %s hash [--unique] <payload.bin>...\n",
+          program, program, program, program, program, program, program,
+          program);
+#ifdef BEJ_USE_ARENA_ALLOCATOR
+  fprintf(stderr,
+          "       %s edit <schema_dict.bin> <payload.bin> <output.bin> "
+          "<path=value|-path>...\n",
+          program);
+#endif
+}
+
 /**
  * @brief Main function to run the BEJ parser.
  */
 int main(int argc, char **argv) {
-  if (argc < 3) {
-    fprintf(stderr, "Usage: %s <schema_dict.bin> <payload.bin> [output.json]\n",
-            argv[0]);
+  if (argc > 1 && strcmp(argv[1], "pipe") == 0) {
+    return RunPipe(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "archive") == 0) {
+    return RunArchive(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "query") == 0) {
+    return RunQuery(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "export") == 0) {
+    return RunExport(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "transcode") == 0) {
+    return RunTranscode(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+    return RunBatch(argc - 2, argv + 2);
+  }
+  if (argc > 1 && strcmp(argv[1], "hash") == 0) {
+    return RunHash(argc - 2, argv + 2);
+  }
+#ifdef BEJ_USE_ARENA_ALLOCATOR
+  if (argc > 1 && strcmp(argv[1], "edit") == 0) {
+    return RunEdit(argc - 2, argv + 2);
+  }
+#endif
+
+  int arg = 1;
+  bool gather = (argc > arg && strcmp(argv[arg], "--gather") == 0);
+  if (gather) arg++;
+
+  if (argc - arg < 2) {
+    PrintUsage(argv[0]);
     return 1;
   }
 
-  const char *schema_path = argv[1];
-  const char *payload_path = argv[2];
-  const char *output_path = (argc > 3) ? argv[3] : "decoded.json";
+  const char *schema_path = argv[arg];
+  const char *payload_path = argv[arg + 1];
+  const char *output_path = (argc - arg > 2) ? argv[arg + 2] : "decoded.json";
 
   size_t schema_size = 0, payload_size = 0;
   uint8_t *schema = ReadFile(schema_path, &schema_size);
@@ -78,6 +865,18 @@ int main(int argc, char **argv) {
   InputStream schema_is = {schema, schema_size, 0};
   InputStream payload_is = {payload, payload_size, 0};
 
+  if (gather) {
+    bool ok = DecodeGatherToFile(&payload_is, &schema_is, output_path);
+    if (ok) {
+      printf("Decoded JSON written to %s\n", output_path);
+    } else {
+      fprintf(stderr, "Decode failed\n");
+    }
+    free(schema);
+    free(payload);
+    return 0;
+  }
+
   OutputStream out;
   OutputStreamInit(&out);
 
@@ -0,0 +1,87 @@
+#include "parallel.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * @struct ParallelJob
+ * @brief State shared by the workers of one ParallelFor() call.
+ */
+typedef struct {
+  atomic_size_t next_task;
+  size_t task_count;
+  ParallelTaskFn fn;
+  void *ctx;
+} ParallelJob;
+
+/**
+ * @struct ParallelWorker
+ * @brief Per-thread arguments of a ParallelFor() worker.
+ */
+typedef struct {
+  ParallelJob *job;
+  size_t worker;
+} ParallelWorker;
+
+static void *ParallelWorkerMain(void *arg) {
+  ParallelWorker *self = arg;
+  ParallelJob *job = self->job;
+  for (;;) {
+    size_t task = atomic_fetch_add(&job->next_task, 1);
+    if (task >= job->task_count) break;
+    job->fn(job->ctx, task, self->worker);
+  }
+  return NULL;
+}
+
+bool ParallelFor(size_t task_count, size_t thread_count, ParallelTaskFn fn,
+                 void *ctx) {
+  if (thread_count == 0) thread_count = 1;
+  if (thread_count > task_count) thread_count = task_count;
+  if (thread_count <= 1) {
+    for (size_t task = 0; task < task_count; ++task) fn(ctx, task, 0);
+    return true;
+  }
+
+  ParallelJob job;
+  atomic_init(&job.next_task, 0);
+  job.task_count = task_count;
+  job.fn = fn;
+  job.ctx = ctx;
+
+  pthread_t *threads = malloc(thread_count * sizeof(*threads));
+  ParallelWorker *workers = malloc(thread_count * sizeof(*workers));
+  if (!threads || !workers) {
+    free(threads);
+    free(workers);
+    return false;
+  }
+
+  size_t started = 0;
+  for (size_t i = 1; i < thread_count; ++i) {
+    workers[i] = (ParallelWorker){&job, i};
+    if (pthread_create(&threads[i], NULL, ParallelWorkerMain, &workers[i]) !=
+        0) {
+      break;
+    }
+    started = i;
+  }
+
+  workers[0] = (ParallelWorker){&job, 0};
+  ParallelWorkerMain(&workers[0]);
+
+  for (size_t i = 1; i <= started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+  free(workers);
+  return true;
+}
+
+size_t ParallelDefaultThreadCount(void) {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (size_t)count : 1;
+}
@@ -0,0 +1,146 @@
+#include "pipeline.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "decoder.h"
+
+/**
+ * @brief Reads a little-endian integer of `size` bytes from a FILE.
+ *
+ * @return 1 on success, 0 on a clean end of file, -1 on a truncated read.
+ */
+static int PipelineReadInt(FILE *in, size_t size, uint32_t *value) {
+  uint8_t buf[4];
+  size_t n = fread(buf, 1, size, in);
+  if (n == 0 && feof(in)) return 0;
+  if (n != size) return -1;
+
+  *value = 0;
+  for (size_t i = 0; i < size; ++i) {
+    *value |= (uint32_t)buf[i] << (i * 8);
+  }
+  return 1;
+}
+
+/**
+ * @brief Decodes one record with a cached decoder for its dictionary, which
+ * is created on first use.
+ */
+static bool PipelineDecodeCached(BejDecoder **decoders,
+                                 const InputStream *dictionary,
+                                 BejDecodeCache *cache, const uint8_t *payload,
+                                 size_t size, OutputStream *json) {
+  if (!*decoders) {
+    *decoders = BejDecoderCreate(dictionary->data, dictionary->size);
+    if (!*decoders) return false;
+    BejDecoderSetCache(*decoders, cache);
+  }
+  const char *data;
+  size_t data_size;
+  if (!BejDecoderDecodeCompact(*decoders, payload, size, &data, &data_size)) {
+    return false;
+  }
+  OutputStreamWrite(json, data, data_size);
+  return true;
+}
+
+bool PipelineRun(FILE *in, FILE *out, const InputStream *dictionaries,
+                 size_t dictionary_count, const PipelineOptions *options,
+                 PipelineStats *stats) {
+  PipelineStats local_stats = {0};
+  OutputStream *json = malloc(sizeof(*json));
+  uint8_t *payload = NULL;
+  size_t payload_capacity = 0;
+  bool ok = json != NULL;
+
+  BejDecodeCache *cache = NULL;
+  BejDecoder **decoders = NULL;
+  if (ok && options->cache_bytes > 0) {
+    cache = BejDecodeCacheCreate(options->cache_bytes,
+                                 BEJ_DECODE_CACHE_DEFAULT_MIN_SUBTREE);
+    decoders = calloc(dictionary_count ? dictionary_count : 1,
+                      sizeof(*decoders));
+    ok = cache && decoders;
+  }
+
+  while (ok) {
+    uint32_t length, dict_id = 0;
+    int status = PipelineReadInt(in, 4, &length);
+    if (status == 0) break;
+    if (status < 0 ||
+        (options->tagged && PipelineReadInt(in, 2, &dict_id) != 1)) {
+      fprintf(stderr, "Error: truncated record header after %zu records\n",
+              local_stats.records);
+      ok = false;
+      break;
+    }
+    if (length > PIPELINE_MAX_RECORD_SIZE) {
+      fprintf(stderr, "Error: record %zu too large (%u bytes)\n",
+              local_stats.records, length);
+      ok = false;
+      break;
+    }
+
+    if (length > payload_capacity) {
+      uint8_t *grown = realloc(payload, length);
+      if (!grown) {
+        fprintf(stderr, "Error: out of memory (%u bytes)\n", length);
+        ok = false;
+        break;
+      }
+      payload = grown;
+      payload_capacity = length;
+    }
+    if (fread(payload, 1, length, in) != length) {
+      fprintf(stderr, "Error: truncated record %zu\n", local_stats.records);
+      ok = false;
+      break;
+    }
+
+    bool decoded = false;
+    OutputStreamInit(json);
+    if (dict_id < dictionary_count && cache) {
+      decoded = PipelineDecodeCached(&decoders[dict_id], &dictionaries[dict_id],
+                                     cache, payload, length, json);
+    } else if (dict_id < dictionary_count) {
+      InputStream payload_is = {payload, length, 0};
+      InputStream dict_is = dictionaries[dict_id];
+      dict_is.pos = 0;
+      decoded = BejDecodeCompact(json, &payload_is, &dict_is);
+    } else {
+      fprintf(stderr, "Error: record %zu uses unknown dictionary id %u\n",
+              local_stats.records, dict_id);
+    }
+
+    if (decoded) {
+      fwrite(json->data, 1, json->pos, out);
+    } else {
+      fprintf(stderr, "Error: record %zu could not be decoded\n",
+              local_stats.records);
+      fputs("null", out);
+      local_stats.failed++;
+    }
+    fputc('\n', out);
+    local_stats.records++;
+
+    if (options->flush_each_record) fflush(out);
+    if (ferror(out)) {
+      fprintf(stderr, "Error: write failed\n");
+      ok = false;
+    }
+  }
+
+  if (fflush(out) != 0 || ferror(in)) ok = false;
+
+  if (cache) BejDecodeCacheGetStats(cache, &local_stats.cache);
+  for (size_t i = 0; decoders && i < dictionary_count; ++i) {
+    BejDecoderDestroy(decoders[i]);
+  }
+  free(decoders);
+  BejDecodeCacheDestroy(cache);
+  free(payload);
+  free(json);
+  if (stats) *stats = local_stats;
+  return ok;
+}
@@ -0,0 +1,339 @@
+#include "prune.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_types.h"
+#include "decoder.h"
+#include "stream_utils.h"
+
+/// @brief Nesting limit of objects and arrays, which bounds the recursion.
+#define PRUNE_MAX_DEPTH 64
+
+bool BejPruneInit(BejPruner *pruner, const uint8_t *dictionary, size_t size) {
+  memset(pruner, 0, sizeof(*pruner));
+  if (!DictionaryCompile(&pruner->dictionary, dictionary, size)) return false;
+  pruner->used = calloc(pruner->dictionary.entry_count + 1, 1);
+  if (!pruner->used) {
+    DictionaryRelease(&pruner->dictionary);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Returns the child subset of `entry`, as the decoder resolves it.
+ */
+static bool PruneChildren(const BejPruner *pruner,
+                          const DictionaryEntry *entry,
+                          const DictionaryEntry **children, size_t *count) {
+  *children = NULL;
+  *count = 0;
+  return entry->child_count == 0 ||
+         DictionaryFindSubset(&pruner->dictionary, entry->offset,
+                              entry->child_count, children, count);
+}
+
+/**
+ * @brief Marks the entries one tuple uses. Consumes the stream exactly as
+ * BejDecode() does, so the same tuples are visited.
+ */
+static bool PruneScanTuple(BejPruner *pruner, InputStream *in,
+                           const DictionaryEntry *entries, size_t count,
+                           bool is_array_item, int depth) {
+  if (in->pos >= in->size) return true;
+
+  uint64_t raw_seq = BejUnpackNNInt(in);
+  uint8_t format = (uint8_t)StreamReadInt(in, 1) >> 4;
+  uint64_t length = BejUnpackNNInt(in);
+
+  const DictionaryEntry *entry =
+      DictionaryFindEntry(entries, count, is_array_item ? 0 : raw_seq >> 1);
+  if (!entry) return false;
+  pruner->used[entry - pruner->dictionary.entries] = 1;
+
+  const DictionaryEntry *children;
+  size_t child_count;
+  switch (format) {
+    case BEJ_FORMAT_SET:
+    case BEJ_FORMAT_ARRAY: {
+      if (depth >= PRUNE_MAX_DEPTH) return false;
+      uint64_t member_count = BejUnpackNNInt(in);
+      if (member_count > in->size - in->pos ||
+          !PruneChildren(pruner, entry, &children, &child_count)) {
+        return false;
+      }
+      for (uint64_t i = 0; i < member_count; ++i) {
+        if (!PruneScanTuple(pruner, in, children, child_count,
+                            format == BEJ_FORMAT_ARRAY, depth + 1)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    case BEJ_FORMAT_ENUM: {
+      uint64_t enum_seq = BejUnpackNNInt(in);
+      if (!PruneChildren(pruner, entry, &children, &child_count)) {
+        return false;
+      }
+      const DictionaryEntry *value =
+          DictionaryFindEntry(children, child_count, enum_seq);
+      if (value) pruner->used[value - pruner->dictionary.entries] = 1;
+      return true;
+    }
+    case BEJ_FORMAT_STRING:
+      return StreamReadBytes(in, length) != NULL;
+    case BEJ_FORMAT_INTEGER:
+      stream_read_sint(in, length);
+      return true;
+    case BEJ_FORMAT_BOOLEAN:
+      StreamReadInt(in, length);
+      return true;
+    case BEJ_FORMAT_NULL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool BejPruneAdd(BejPruner *pruner, const uint8_t *payload, size_t size) {
+  InputStream in = {payload, size, 0};
+  const DictionaryEntry *root;
+  size_t count;
+  bool ok = BejReadHeader(&in) &&
+            DictionaryFindSubset(&pruner->dictionary, 0, 1, &root, &count) &&
+            PruneScanTuple(pruner, &in, root, count, false, 0);
+  pruner->payloads++;
+  if (!ok) pruner->failed++;
+  return ok;
+}
+
+/**
+ * @struct PruneLayout
+ * @brief Placement of the kept entries in the pruned dictionary.
+ *
+ * `order` lists the kept subsets (as slices of the compiled dictionary,
+ * `length[k]` entries long) in the order they are written, root first, and
+ * `kept[k]` is the number of used entries of `order[k]`. `placed[i]` is one
+ * plus the position in `order` of the subset whose first entry is entry `i`,
+ * or 0. `name_at[o]` is one plus the position in the name table of the name
+ * at offset `o` of the source dictionary, or 0.
+ */
+typedef struct {
+  const DictionaryEntry **order;
+  size_t *length;
+  uint32_t *kept;
+  size_t order_count;
+  uint32_t *placed;
+  uint32_t *name_at;
+  size_t entry_count;
+  size_t names_size;
+} PruneLayout;
+
+/**
+ * @brief Returns the number of used entries in a compiled slice.
+ */
+static uint32_t PruneCountUsed(const BejPruner *pruner,
+                               const DictionaryEntry *entries, size_t count) {
+  uint32_t used = 0;
+  for (size_t i = 0; i < count; ++i) {
+    used += pruner->used[entries + i - pruner->dictionary.entries];
+  }
+  return used;
+}
+
+/**
+ * @brief Returns the offset of the name of `entry` in the source dictionary,
+ * or 0 if it has none.
+ */
+static size_t PruneNameOffset(const CompiledDictionary *dict,
+                              const DictionaryEntry *entry) {
+  if (entry->name[0] == '\0') return 0;
+  return (size_t)((const uint8_t *)entry->name - dict->data);
+}
+
+/**
+ * @brief Returns the kept child subset of `entry` as its position in
+ * `order`, or -1 if no child is kept.
+ */
+static long PruneKeptChildren(const BejPruner *pruner,
+                              const PruneLayout *layout,
+                              const DictionaryEntry *entry) {
+  const DictionaryEntry *children;
+  size_t child_count;
+  if (!PruneChildren(pruner, entry, &children, &child_count) ||
+      child_count == 0) {
+    return -1;
+  }
+  uint32_t placed = layout->placed[children - pruner->dictionary.entries];
+  return placed ? (long)placed - 1 : -1;
+}
+
+/**
+ * @brief Collects the kept subsets breadth-first from the root and assigns
+ * positions to the kept names.
+ */
+static bool PruneBuildLayout(const BejPruner *pruner, PruneLayout *layout) {
+  const CompiledDictionary *dict = &pruner->dictionary;
+  layout->order = malloc((dict->subset_count + 1) * sizeof(*layout->order));
+  layout->length =
+      malloc((dict->subset_count + 1) * sizeof(*layout->length));
+  layout->kept = malloc((dict->subset_count + 1) * sizeof(*layout->kept));
+  layout->placed = calloc(dict->entry_count + 1, sizeof(*layout->placed));
+  layout->name_at = calloc(dict->size + 1, sizeof(*layout->name_at));
+  const DictionaryEntry *root;
+  size_t count;
+  if (!layout->order || !layout->length || !layout->kept || !layout->placed ||
+      !layout->name_at ||
+      !DictionaryFindSubset(dict, 0, 1, &root, &count)) {
+    return false;
+  }
+
+  // The root is always kept, even when no payload was scanned.
+  layout->order[0] = root;
+  layout->length[0] = 1;
+  layout->kept[0] = 1;
+  layout->order_count = 1;
+  layout->placed[root - dict->entries] = 1;
+
+  for (size_t k = 0; k < layout->order_count; ++k) {
+    const DictionaryEntry *entries = layout->order[k];
+    layout->entry_count += layout->kept[k];
+
+    for (size_t i = 0; i < layout->length[k]; ++i) {
+      const DictionaryEntry *entry = &entries[i];
+      if (k > 0 && !pruner->used[entry - dict->entries]) continue;
+
+      size_t name_offset = PruneNameOffset(dict, entry);
+      if (name_offset && !layout->name_at[name_offset]) {
+        layout->name_at[name_offset] = (uint32_t)layout->names_size + 1;
+        layout->names_size += strlen(entry->name) + 1;
+      }
+
+      const DictionaryEntry *children;
+      size_t child_count;
+      if (!PruneChildren(pruner, entry, &children, &child_count) ||
+          child_count == 0 || layout->placed[children - dict->entries]) {
+        continue;
+      }
+      uint32_t kept = PruneCountUsed(pruner, children, child_count);
+      if (kept == 0) continue;
+      layout->order[layout->order_count] = children;
+      layout->length[layout->order_count] = child_count;
+      layout->kept[layout->order_count] = kept;
+      layout->placed[children - dict->entries] =
+          (uint32_t)++layout->order_count;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Writes a little-endian integer.
+ */
+static void PrunePut(uint8_t *buf, size_t *pos, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    buf[(*pos)++] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+bool BejPruneWrite(const BejPruner *pruner, uint8_t **out, size_t *out_size,
+                   size_t *entry_count) {
+  const CompiledDictionary *dict = &pruner->dictionary;
+  PruneLayout layout;
+  memset(&layout, 0, sizeof(layout));
+  uint32_t *offsets = NULL;
+  uint8_t *buf = NULL;
+  bool ok = PruneBuildLayout(pruner, &layout);
+  if (ok) {
+    offsets = malloc(layout.order_count * sizeof(*offsets));
+    ok = offsets != NULL;
+  }
+
+  if (ok) {
+    // Keep the standard layout unless a field does not fit into 16 bits.
+    size_t names_start = DICTIONARY_HEADER_SIZE +
+                         layout.entry_count * DICTIONARY_ENTRY_SIZE;
+    bool wide = names_start + layout.names_size > UINT16_MAX;
+    for (size_t k = 0; k < layout.order_count && !wide; ++k) {
+      const DictionaryEntry *entries = layout.order[k];
+      wide = layout.kept[k] > UINT16_MAX;
+      for (size_t i = 0; i < layout.length[k] && !wide; ++i) {
+        if (k > 0 && !pruner->used[&entries[i] - dict->entries]) continue;
+        wide = entries[i].sequence_number > UINT16_MAX;
+      }
+    }
+    size_t entry_size =
+        wide ? DICTIONARY_WIDE_ENTRY_SIZE : DICTIONARY_ENTRY_SIZE;
+    size_t field = wide ? 4 : 2;
+    names_start = DICTIONARY_HEADER_SIZE + layout.entry_count * entry_size;
+    size_t size = names_start + layout.names_size;
+
+    size_t next = DICTIONARY_HEADER_SIZE;
+    for (size_t k = 0; k < layout.order_count; ++k) {
+      offsets[k] = (uint32_t)next;
+      next += layout.kept[k] * entry_size;
+    }
+
+    buf = malloc(size);
+    ok = buf != NULL;
+    if (ok) {
+      size_t pos = 0;
+      size_t header = dict->size < DICTIONARY_HEADER_SIZE
+                          ? dict->size
+                          : DICTIONARY_HEADER_SIZE;
+      memset(buf, 0, DICTIONARY_HEADER_SIZE);
+      memcpy(buf, dict->data, header);
+      if (wide) {
+        buf[1] |= DICTIONARY_FLAG_WIDE;
+      } else {
+        buf[1] &= (uint8_t)~DICTIONARY_FLAG_WIDE;
+      }
+      pos = 2;
+      PrunePut(buf, &pos, layout.entry_count & 0xFFFF, 2);
+      pos = 8;
+      PrunePut(buf, &pos, size, 4);
+
+      for (size_t k = 0; k < layout.order_count; ++k) {
+        const DictionaryEntry *entries = layout.order[k];
+        for (size_t i = 0, written = 0; written < layout.kept[k]; ++i) {
+          const DictionaryEntry *entry = &entries[i];
+          if (k > 0 && !pruner->used[entry - dict->entries]) continue;
+          written++;
+
+          long child = PruneKeptChildren(pruner, &layout, entry);
+          size_t name_offset = PruneNameOffset(dict, entry);
+          uint32_t name = name_offset ? layout.name_at[name_offset] : 0;
+
+          PrunePut(buf, &pos, (uint64_t)entry->format << 4 | entry->flags, 1);
+          PrunePut(buf, &pos, entry->sequence_number, field);
+          PrunePut(buf, &pos, child < 0 ? 0 : offsets[child], field);
+          PrunePut(buf, &pos, child < 0 ? 0 : layout.kept[child], field);
+          PrunePut(buf, &pos, name ? strlen(entry->name) + 1 : 0, 1);
+          PrunePut(buf, &pos, name ? names_start + name - 1 : 0, field);
+          if (name) {
+            memcpy(buf + names_start + name - 1, entry->name,
+                   strlen(entry->name) + 1);
+          }
+        }
+      }
+      *out = buf;
+      *out_size = size;
+      if (entry_count) *entry_count = layout.entry_count;
+    }
+  }
+
+  free(offsets);
+  free(layout.order);
+  free(layout.length);
+  free(layout.kept);
+  free(layout.placed);
+  free(layout.name_at);
+  return ok;
+}
+
+void BejPruneRelease(BejPruner *pruner) {
+  DictionaryRelease(&pruner->dictionary);
+  free(pruner->used);
+  pruner->used = NULL;
+}
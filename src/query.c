@@ -0,0 +1,627 @@
+#include "query.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bej_types.h"
+#include "decoder.h"
+#include "json_writer.h"
+#include "parallel.h"
+
+/// @brief Number of files evaluated per thread before matches are written.
+#define BEJ_QUERY_FILES_PER_THREAD 256
+
+/**
+ * @struct QueryLiteral
+ * @brief The right-hand side of a term before it is typed by the dictionary.
+ */
+typedef struct {
+  char text[BEJ_QUERY_MAX_LITERAL];
+  size_t len;
+  bool quoted;
+} QueryLiteral;
+
+/**
+ * @brief Skips whitespace in the expression.
+ */
+static const char *QuerySkipSpace(const char *p) {
+  while (isspace((unsigned char)*p)) p++;
+  return p;
+}
+
+/**
+ * @brief Returns true for characters allowed in paths and bare literals.
+ */
+static bool QueryIsWordChar(char c) {
+  return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '@' ||
+         c == '#' || c == '-' || c == '+';
+}
+
+/**
+ * @brief Reads a word (path or bare literal) into `buf`.
+ */
+static const char *QueryReadWord(const char *p, char *buf, size_t size,
+                                 size_t *len) {
+  size_t n = 0;
+  while (QueryIsWordChar(*p)) {
+    if (n + 1 >= size) return NULL;
+    buf[n++] = *p++;
+  }
+  buf[n] = '\0';
+  *len = n;
+  return n > 0 ? p : NULL;
+}
+
+/**
+ * @brief Reads a comparison operator.
+ */
+static const char *QueryReadOp(const char *p, BejQueryOp *op) {
+  if (p[0] == '=' && p[1] == '=') {
+    *op = BEJ_QUERY_EQ;
+    return p + 2;
+  }
+  if (p[0] == '!' && p[1] == '=') {
+    *op = BEJ_QUERY_NE;
+    return p + 2;
+  }
+  if (p[0] == '<') {
+    *op = (p[1] == '=') ? BEJ_QUERY_LE : BEJ_QUERY_LT;
+    return p + (p[1] == '=' ? 2 : 1);
+  }
+  if (p[0] == '>') {
+    *op = (p[1] == '=') ? BEJ_QUERY_GE : BEJ_QUERY_GT;
+    return p + (p[1] == '=' ? 2 : 1);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Reads a quoted string or a bare word.
+ */
+static const char *QueryReadLiteral(const char *p, QueryLiteral *literal) {
+  literal->quoted = (*p == '"' || *p == '\'');
+  if (!literal->quoted) {
+    return QueryReadWord(p, literal->text, sizeof(literal->text),
+                         &literal->len);
+  }
+  char quote = *p++;
+  size_t n = 0;
+  while (*p && *p != quote) {
+    if (n + 1 >= sizeof(literal->text)) return NULL;
+    literal->text[n++] = *p++;
+  }
+  if (*p != quote) return NULL;
+  literal->text[n] = '\0';
+  literal->len = n;
+  return p + 1;
+}
+
+/**
+ * @brief Finds an entry of a subset by name.
+ */
+static const DictionaryEntry *QueryFindByName(const DictionaryEntry *entries,
+                                              size_t count, const char *name,
+                                              size_t len) {
+  for (size_t i = 0; i < count; ++i) {
+    if (strncmp(entries[i].name, name, len) == 0 &&
+        entries[i].name[len] == '\0') {
+      return &entries[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Resolves a term's dotted field name to sequence numbers and returns
+ * the dictionary entry of the leaf.
+ */
+static const DictionaryEntry *QueryResolvePath(const BejQuery *query,
+                                               BejQueryTerm *term) {
+  const DictionaryEntry *entries;
+  size_t count;
+  if (!DictionaryFindSubset(&query->dictionary, 0, 1, &entries, &count)) {
+    return NULL;
+  }
+  const DictionaryEntry *entry = &entries[0];
+
+  const char *name = term->field;
+  term->depth = 0;
+  while (true) {
+    if (entry->format != BEJ_FORMAT_SET) {
+      fprintf(stderr, "Error: %s: only object properties can be traversed\n",
+              term->field);
+      return NULL;
+    }
+    if (term->depth == BEJ_QUERY_MAX_DEPTH) {
+      fprintf(stderr, "Error: %s: path is too deep\n", term->field);
+      return NULL;
+    }
+    if (!DictionaryFindSubset(&query->dictionary, entry->offset,
+                              entry->child_count, &entries, &count)) {
+      return NULL;
+    }
+    const char *dot = strchr(name, '.');
+    size_t len = dot ? (size_t)(dot - name) : strlen(name);
+    entry = QueryFindByName(entries, count, name, len);
+    if (!entry) {
+      fprintf(stderr, "Error: %s: unknown property %.*s\n", term->field,
+              (int)len, name);
+      return NULL;
+    }
+    term->path[term->depth++] = entry->sequence_number;
+    if (!dot) return entry;
+    name = dot + 1;
+  }
+}
+
+/**
+ * @brief Types the literal of a term using the leaf's dictionary entry.
+ */
+static bool QueryBindLiteral(const BejQuery *query, BejQueryTerm *term,
+                             const DictionaryEntry *leaf,
+                             const QueryLiteral *literal) {
+  bool ordered = term->op != BEJ_QUERY_EQ && term->op != BEJ_QUERY_NE;
+  term->format = leaf->format;
+
+  if (!literal->quoted && strcmp(literal->text, "null") == 0) {
+    term->null_literal = true;
+    if (ordered) {
+      fprintf(stderr, "Error: %s: null only supports == and !=\n",
+              term->field);
+      return false;
+    }
+    return true;
+  }
+
+  switch (leaf->format) {
+    case BEJ_FORMAT_INTEGER: {
+      char *end;
+      errno = 0;
+      term->integer = strtoll(literal->text, &end, 10);
+      if (literal->quoted || *end != '\0' || errno != 0) {
+        fprintf(stderr, "Error: %s: expected an integer, got %s\n",
+                term->field, literal->text);
+        return false;
+      }
+      return true;
+    }
+    case BEJ_FORMAT_STRING:
+      memcpy(term->string, literal->text, literal->len + 1);
+      term->string_len = literal->len;
+      return true;
+    case BEJ_FORMAT_BOOLEAN:
+      if (ordered || literal->quoted ||
+          (strcmp(literal->text, "true") != 0 &&
+           strcmp(literal->text, "false") != 0)) {
+        fprintf(stderr, "Error: %s: expected == or != true/false\n",
+                term->field);
+        return false;
+      }
+      term->integer = strcmp(literal->text, "true") == 0;
+      return true;
+    case BEJ_FORMAT_ENUM: {
+      if (ordered) {
+        fprintf(stderr, "Error: %s: enums only support == and !=\n",
+                term->field);
+        return false;
+      }
+      if (!DictionaryFindSubset(&query->dictionary, leaf->offset,
+                                leaf->child_count, &term->enum_entries,
+                                &term->enum_count)) {
+        return false;
+      }
+      const DictionaryEntry *value = QueryFindByName(
+          term->enum_entries, term->enum_count, literal->text, literal->len);
+      if (!value) {
+        fprintf(stderr, "Error: %s: unknown enum value %s\n", term->field,
+                literal->text);
+        return false;
+      }
+      term->integer = value->sequence_number;
+      return true;
+    }
+    default:
+      fprintf(stderr, "Error: %s: objects and arrays cannot be compared\n",
+              term->field);
+      return false;
+  }
+}
+
+bool BejQueryCompile(BejQuery *query, const uint8_t *dictionary, size_t size,
+                     const char *expression) {
+  memset(query, 0, sizeof(*query));
+  if (!DictionaryCompile(&query->dictionary, dictionary, size)) return false;
+
+  const char *p = QuerySkipSpace(expression);
+  size_t group = 0;
+  while (true) {
+    if (query->term_count == BEJ_QUERY_MAX_TERMS) {
+      fprintf(stderr, "Error: too many terms (max %d)\n",
+              BEJ_QUERY_MAX_TERMS);
+      break;
+    }
+    BejQueryTerm *term = &query->terms[query->term_count];
+    QueryLiteral literal;
+    size_t len;
+
+    p = QueryReadWord(p, term->field, sizeof(term->field), &len);
+    if (p) p = QueryReadOp(QuerySkipSpace(p), &term->op);
+    if (p) p = QueryReadLiteral(QuerySkipSpace(p), &literal);
+    if (!p) {
+      fprintf(stderr, "Error: expected `Path op value` in query: %s\n",
+              expression);
+      break;
+    }
+
+    const DictionaryEntry *leaf = QueryResolvePath(query, term);
+    if (!leaf || !QueryBindLiteral(query, term, leaf, &literal)) break;
+    term->group = group;
+    query->term_count++;
+
+    p = QuerySkipSpace(p);
+    if (*p == '\0') return true;
+    if (p[0] == '|' && p[1] == '|') {
+      group++;
+    } else if (p[0] != '&' || p[1] != '&') {
+      fprintf(stderr, "Error: expected && or || in query at: %s\n", p);
+      break;
+    }
+    p = QuerySkipSpace(p + 2);
+  }
+
+  BejQueryRelease(query);
+  return false;
+}
+
+/**
+ * @brief Reads a leaf value whose tuple format and length are known.
+ */
+static bool QueryReadValue(InputStream *in, uint8_t format, uint64_t length,
+                           BejQueryValue *value) {
+  value->found = true;
+  value->format = format;
+  switch (format) {
+    case BEJ_FORMAT_INTEGER:
+      value->integer = stream_read_sint(in, length);
+      return true;
+    case BEJ_FORMAT_ENUM:
+      value->integer = (int64_t)BejUnpackNNInt(in);
+      return true;
+    case BEJ_FORMAT_BOOLEAN:
+      value->integer = StreamReadInt(in, length) == 0x01;
+      return true;
+    case BEJ_FORMAT_STRING:
+      value->string = StreamReadBytes(in, length);
+      value->string_len = length > 0 ? length - 1 : 0;
+      return value->string != NULL;
+    default:
+      return true;
+  }
+}
+
+/**
+ * @struct QueryScan
+ * @brief State of one payload scan.
+ */
+typedef struct {
+  const BejQuery *query;
+  BejQueryResult *result;
+  size_t pending;
+} QueryScan;
+
+/**
+ * @brief Scans the members of a SET for the terms in `terms` (a bit mask of
+ * term indices whose path matched up to `depth`).
+ *
+ * Members that no term refers to are skipped by their length without being
+ * parsed. The scan stops as soon as every term has a value.
+ */
+static bool QueryScanSet(QueryScan *scan, InputStream *in, size_t depth,
+                         uint32_t terms) {
+  uint64_t count = BejUnpackNNInt(in);
+  if (count > in->size - in->pos) return false;
+  for (uint64_t i = 0; i < count && scan->pending > 0; ++i) {
+    uint32_t seq = (uint32_t)(BejUnpackNNInt(in) >> 1);
+    uint8_t format = (uint8_t)StreamReadInt(in, 1) >> 4;
+    uint64_t length = BejUnpackNNInt(in);
+    if (in->pos > in->size || length > in->size - in->pos) return false;
+
+    InputStream value = {in->data, in->pos + length, in->pos};
+    in->pos += length;
+
+    uint32_t nested = 0;
+    for (uint32_t mask = terms; mask; mask &= mask - 1) {
+      size_t t = (size_t)__builtin_ctz(mask);
+      const BejQueryTerm *term = &scan->query->terms[t];
+      if (term->path[depth] != seq) continue;
+      if (term->depth > depth + 1) {
+        nested |= 1u << t;
+        continue;
+      }
+      BejQueryValue *result = &scan->result->values[t];
+      if (result->found) continue;
+      InputStream leaf = value;
+      if (!QueryReadValue(&leaf, format, length, result)) return false;
+      scan->pending--;
+    }
+    if (nested && format == BEJ_FORMAT_SET &&
+        !QueryScanSet(scan, &value, depth + 1, nested)) {
+      return false;
+    }
+  }
+  return in->pos <= in->size;
+}
+
+/**
+ * @brief Evaluates one term against the value found in a payload.
+ */
+static bool QueryTermHolds(const BejQueryTerm *term,
+                           const BejQueryValue *value) {
+  if (!value->found) return false;
+  if (term->null_literal) {
+    return (value->format == BEJ_FORMAT_NULL) == (term->op == BEJ_QUERY_EQ);
+  }
+  if (value->format != term->format) return false;
+
+  int cmp;
+  if (term->format == BEJ_FORMAT_STRING) {
+    size_t n = value->string_len < term->string_len ? value->string_len
+                                                    : term->string_len;
+    cmp = memcmp(value->string, term->string, n);
+    if (cmp == 0) {
+      cmp = (value->string_len > term->string_len) -
+            (value->string_len < term->string_len);
+    }
+  } else {
+    cmp = (value->integer > term->integer) - (value->integer < term->integer);
+  }
+
+  switch (term->op) {
+    case BEJ_QUERY_EQ:
+      return cmp == 0;
+    case BEJ_QUERY_NE:
+      return cmp != 0;
+    case BEJ_QUERY_LT:
+      return cmp < 0;
+    case BEJ_QUERY_LE:
+      return cmp <= 0;
+    case BEJ_QUERY_GT:
+      return cmp > 0;
+    case BEJ_QUERY_GE:
+      return cmp >= 0;
+  }
+  return false;
+}
+
+bool BejQueryMatch(const BejQuery *query, const uint8_t *payload, size_t size,
+                   BejQueryResult *result, bool *matched) {
+  memset(result, 0, sizeof(*result));
+  *matched = false;
+
+  InputStream in = {payload, size, 0};
+  if (!BejReadHeader(&in)) return false;
+  BejUnpackNNInt(&in);
+  uint8_t format = (uint8_t)StreamReadInt(&in, 1) >> 4;
+  BejUnpackNNInt(&in);
+  if (format != BEJ_FORMAT_SET || in.pos > in.size) return false;
+
+  QueryScan scan = {query, result, query->term_count};
+  uint32_t terms = (query->term_count >= 32)
+                       ? UINT32_MAX
+                       : (1u << query->term_count) - 1;
+  if (!QueryScanSet(&scan, &in, 0, terms)) return false;
+
+  bool group_holds = true;
+  for (size_t t = 0; t < query->term_count; ++t) {
+    if (t > 0 && query->terms[t].group != query->terms[t - 1].group) {
+      if (group_holds) break;
+      group_holds = true;
+    }
+    group_holds = group_holds && QueryTermHolds(&query->terms[t],
+                                                &result->values[t]);
+  }
+  *matched = query->term_count > 0 && group_holds;
+  return true;
+}
+
+/**
+ * @brief Writes one queried value as JSON.
+ */
+static void QueryWriteValue(const BejQueryTerm *term,
+                            const BejQueryValue *value, OutputStream *out) {
+  char buffer[32];
+  int n;
+  switch (value->found ? value->format : BEJ_FORMAT_NULL) {
+    case BEJ_FORMAT_INTEGER:
+      n = snprintf(buffer, sizeof(buffer), "%" PRId64, value->integer);
+      OutputStreamWrite(out, buffer, (size_t)n);
+      return;
+    case BEJ_FORMAT_BOOLEAN:
+      if (value->integer) {
+        OutputStreamWrite(out, "true", 4);
+      } else {
+        OutputStreamWrite(out, "false", 5);
+      }
+      return;
+    case BEJ_FORMAT_STRING:
+      JsonWriteString(out, (const char *)value->string, value->string_len);
+      return;
+    case BEJ_FORMAT_ENUM: {
+      const DictionaryEntry *entry =
+          value->integer < 0
+              ? NULL
+              : DictionaryFindEntry(term->enum_entries, term->enum_count,
+                                    (uint64_t)value->integer);
+      if (entry) {
+        OutputStreamWrite(out, "\"", 1);
+        OutputStreamWrite(out, entry->name, strlen(entry->name));
+        OutputStreamWrite(out, "\"", 1);
+      } else {
+        OutputStreamWrite(out, "null", 4);
+      }
+      return;
+    }
+    default:
+      OutputStreamWrite(out, "null", 4);
+      return;
+  }
+}
+
+void BejQueryWriteMatch(const BejQuery *query, const BejQueryResult *result,
+                        const char *id, OutputStream *out) {
+  OutputStreamWrite(out, "{\"id\":", 6);
+  JsonWriteString(out, id, strlen(id));
+  for (size_t t = 0; t < query->term_count; ++t) {
+    const BejQueryTerm *term = &query->terms[t];
+    bool repeated = false;
+    for (size_t prev = 0; prev < t && !repeated; ++prev) {
+      repeated = strcmp(query->terms[prev].field, term->field) == 0;
+    }
+    if (repeated) continue;
+    OutputStreamWrite(out, ",\"", 2);
+    OutputStreamWrite(out, term->field, strlen(term->field));
+    OutputStreamWrite(out, "\":", 2);
+    QueryWriteValue(term, &result->values[t], out);
+  }
+  OutputStreamWrite(out, "}\n", 2);
+}
+
+/**
+ * @struct QueryFileOutput
+ * @brief Outcome of evaluating one file.
+ */
+typedef struct {
+  char *line;
+  size_t len;
+  bool matched;
+  bool failed;
+} QueryFileOutput;
+
+/**
+ * @struct QueryWorker
+ * @brief Per-thread buffers of BejQueryRunFiles().
+ */
+typedef struct {
+  uint8_t *payload;
+  size_t capacity;
+  OutputStream line;
+} QueryWorker;
+
+/**
+ * @struct QueryFilesJob
+ * @brief State shared by the workers of BejQueryRunFiles().
+ */
+typedef struct {
+  const BejQuery *query;
+  char *const *paths;
+  size_t first_file;
+  QueryWorker *workers;
+  QueryFileOutput *outputs;
+} QueryFilesJob;
+
+/**
+ * @brief Reads a whole file into a worker's reusable payload buffer.
+ */
+static bool QueryReadFile(QueryWorker *worker, const char *path,
+                          size_t *size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0 && st.st_size >= 0;
+  *size = ok ? (size_t)st.st_size : 0;
+  if (ok && *size > worker->capacity) {
+    uint8_t *payload = realloc(worker->payload, *size);
+    ok = payload != NULL;
+    if (ok) {
+      worker->payload = payload;
+      worker->capacity = *size;
+    }
+  }
+  for (size_t done = 0; ok && done < *size;) {
+    ssize_t n = read(fd, worker->payload + done, *size - done);
+    if (n < 0 && errno == EINTR) continue;
+    ok = n > 0;
+    if (ok) done += (size_t)n;
+  }
+  close(fd);
+  return ok;
+}
+
+static void QueryFileTask(void *ctx, size_t task, size_t worker_index) {
+  QueryFilesJob *job = ctx;
+  QueryWorker *worker = &job->workers[worker_index];
+  QueryFileOutput *output = &job->outputs[task];
+  const char *path = job->paths[job->first_file + task];
+
+  BejQueryResult result;
+  size_t size;
+  output->matched = false;
+  output->failed =
+      !QueryReadFile(worker, path, &size) ||
+      !BejQueryMatch(job->query, worker->payload, size, &result,
+                     &output->matched);
+  if (output->failed) {
+    fprintf(stderr, "Error: %s could not be queried\n", path);
+    return;
+  }
+  if (!output->matched) return;
+
+  OutputStreamInit(&worker->line);
+  BejQueryWriteMatch(job->query, &result, path, &worker->line);
+  output->line = malloc(worker->line.pos);
+  output->len = worker->line.pos;
+  if (output->line) memcpy(output->line, worker->line.data, output->len);
+}
+
+bool BejQueryRunFiles(const BejQuery *query, char *const *paths,
+                      size_t count, size_t thread_count, FILE *out,
+                      BejQueryStats *stats) {
+  if (thread_count == 0) thread_count = 1;
+  size_t round_size = thread_count * BEJ_QUERY_FILES_PER_THREAD;
+
+  QueryFilesJob job = {query, paths, 0, NULL, NULL};
+  job.workers = calloc(thread_count, sizeof(*job.workers));
+  job.outputs = calloc(round_size, sizeof(*job.outputs));
+  bool ok = job.workers && job.outputs;
+
+  BejQueryStats local_stats = {0, 0, 0};
+  for (size_t first = 0; ok && first < count; first += round_size) {
+    size_t tasks = count - first < round_size ? count - first : round_size;
+    job.first_file = first;
+    ok = ParallelFor(tasks, thread_count, QueryFileTask, &job);
+
+    for (size_t t = 0; t < tasks; ++t) {
+      QueryFileOutput *output = &job.outputs[t];
+      if (ok && output->matched) {
+        ok = output->line &&
+             fwrite(output->line, 1, output->len, out) == output->len;
+        local_stats.matched++;
+      }
+      local_stats.failed += output->failed;
+      free(output->line);
+      memset(output, 0, sizeof(*output));
+    }
+    if (ok) local_stats.payloads = first + tasks;
+  }
+
+  if (job.workers) {
+    for (size_t w = 0; w < thread_count; ++w) free(job.workers[w].payload);
+  }
+  free(job.workers);
+  free(job.outputs);
+
+  ok = (fflush(out) == 0) && ok;
+  if (stats) *stats = local_stats;
+  return ok;
+}
+
+void BejQueryRelease(BejQuery *query) {
+  DictionaryRelease(&query->dictionary);
+  query->term_count = 0;
+}
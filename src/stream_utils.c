@@ -2,11 +2,15 @@
 
 void OutputStreamInit(OutputStream *stream) {
   stream->pos = 0;
+  stream->overflow = false;
   stream->data[0] = '\0';
 }
 
 void OutputStreamWrite(OutputStream *stream, const char *buf, size_t len) {
-  if (stream->pos + len >= OUTBUF_SIZE) return;
+  if (stream->pos + len >= OUTBUF_SIZE) {
+    stream->overflow = true;
+    return;
+  }
   memcpy(stream->data + stream->pos, buf, len);
   stream->pos += len;
   stream->data[stream->pos] = '\0';
@@ -0,0 +1,338 @@
+#include "transcode.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_types.h"
+#include "decoder.h"
+
+/// @brief Nesting limit when matching subsets, which guards against cycles.
+#define TRANSLATION_MAX_DEPTH 32
+
+/// @brief Largest encoded NNInt: one length byte and eight value bytes.
+#define TRANSCODE_MAX_NNINT 9
+
+/**
+ * @brief Finds the counterpart of `entry` in a target subset.
+ *
+ * Entries are matched by name. When `by_position` is set, as for the element
+ * of an array, a subset with a single entry is matched by position.
+ */
+static const DictionaryEntry *TranslationFind(const DictionaryEntry *entry,
+                                              size_t source_count,
+                                              const DictionaryEntry *targets,
+                                              size_t target_count,
+                                              bool by_position) {
+  for (size_t i = 0; i < target_count; ++i) {
+    if (strcmp(targets[i].name, entry->name) == 0) return &targets[i];
+  }
+  if (by_position && source_count == 1 && target_count == 1) {
+    return &targets[0];
+  }
+  return NULL;
+}
+
+/**
+ * @brief Maps every entry of a source subset and, recursively, its children.
+ *
+ * @param by_position Whether single entries may be matched by position,
+ * which holds for the root and for the elements of an array.
+ */
+static void TranslationMapSubset(BejTranslation *translation,
+                                 const DictionaryEntry *sources,
+                                 size_t source_count,
+                                 const DictionaryEntry *targets,
+                                 size_t target_count, bool by_position,
+                                 int depth) {
+  for (size_t i = 0; i < source_count; ++i) {
+    const DictionaryEntry *source = &sources[i];
+    size_t index = (size_t)(source - translation->source.entries);
+    if (translation->map[index] != BEJ_TRANSLATION_UNMAPPED) continue;
+
+    const DictionaryEntry *target =
+        TranslationFind(source, source_count, targets, target_count,
+                        by_position);
+    if (!target || target->format != source->format) continue;
+    translation->map[index] =
+        (uint32_t)(target - translation->target.entries);
+
+    const DictionaryEntry *source_children, *target_children;
+    size_t source_child_count, target_child_count;
+    if (depth < TRANSLATION_MAX_DEPTH && source->child_count > 0 &&
+        target->child_count > 0 &&
+        DictionaryFindSubset(&translation->source, source->offset,
+                             source->child_count, &source_children,
+                             &source_child_count) &&
+        DictionaryFindSubset(&translation->target, target->offset,
+                             target->child_count, &target_children,
+                             &target_child_count)) {
+      TranslationMapSubset(translation, source_children, source_child_count,
+                           target_children, target_child_count,
+                           source->format == BEJ_FORMAT_ARRAY, depth + 1);
+    }
+  }
+}
+
+bool BejTranslationCreate(BejTranslation *translation, const uint8_t *source,
+                          size_t source_size, const uint8_t *target,
+                          size_t target_size) {
+  memset(translation, 0, sizeof(*translation));
+  if (!DictionaryCompile(&translation->source, source, source_size)) {
+    return false;
+  }
+  if (!DictionaryCompile(&translation->target, target, target_size)) {
+    DictionaryRelease(&translation->source);
+    return false;
+  }
+
+  const DictionaryEntry *source_root, *target_root;
+  size_t count;
+  translation->map =
+      malloc((translation->source.entry_count + 1) * sizeof(uint32_t));
+  if (!translation->map ||
+      !DictionaryFindSubset(&translation->source, 0, 1, &source_root,
+                            &count) ||
+      !DictionaryFindSubset(&translation->target, 0, 1, &target_root,
+                            &count)) {
+    BejTranslationRelease(translation);
+    return false;
+  }
+  for (size_t i = 0; i < translation->source.entry_count; ++i) {
+    translation->map[i] = BEJ_TRANSLATION_UNMAPPED;
+  }
+
+  // The roots correspond to each other whatever their names.
+  TranslationMapSubset(translation, source_root, 1, target_root, 1, true, 0);
+  for (size_t i = 0; i < translation->source.entry_count; ++i) {
+    translation->unmapped += translation->map[i] == BEJ_TRANSLATION_UNMAPPED;
+  }
+  return true;
+}
+
+/**
+ * @brief Encodes a BEJ NNInt and returns its size.
+ */
+static size_t TranscodePackNNInt(uint8_t *buf, uint64_t value) {
+  size_t n = 0;
+  do {
+    buf[1 + n++] = (uint8_t)value;
+    value >>= 8;
+  } while (value > 0);
+  buf[0] = (uint8_t)n;
+  return n + 1;
+}
+
+/**
+ * @brief Returns the encoded size of a BEJ NNInt.
+ */
+static size_t TranscodeNNIntSize(uint64_t value) {
+  uint8_t buf[TRANSCODE_MAX_NNINT];
+  return TranscodePackNNInt(buf, value);
+}
+
+/**
+ * @struct TranscodeContainer
+ * @brief Output shape of one SET or ARRAY, found by the measuring pass.
+ */
+typedef struct {
+  uint64_t count;  ///< Members that survive translation.
+  uint64_t size;   ///< Encoded value size, member count included.
+} TranscodeContainer;
+
+/**
+ * @struct TranscodeContext
+ * @brief State of one BejTranscode() call.
+ *
+ * The payload is walked twice. The first pass runs with `out` NULL and
+ * records every container in `containers`, in the order they are met. The
+ * second pass reads them back so that each header is written before its
+ * members.
+ */
+typedef struct {
+  const BejTranslation *translation;
+  OutputStream *out;
+  TranscodeContainer *containers;
+  size_t container_count;
+  size_t container_capacity;
+  size_t next_container;
+  size_t dropped;
+} TranscodeContext;
+
+/**
+ * @brief Appends a container to the list and returns its index in `slot`.
+ */
+static bool TranscodeAddContainer(TranscodeContext *ctx, size_t *slot) {
+  if (ctx->container_count == ctx->container_capacity) {
+    size_t capacity =
+        ctx->container_capacity ? ctx->container_capacity * 2 : 64;
+    TranscodeContainer *containers =
+        realloc(ctx->containers, capacity * sizeof(*containers));
+    if (!containers) return false;
+    ctx->containers = containers;
+    ctx->container_capacity = capacity;
+  }
+  *slot = ctx->container_count++;
+  return true;
+}
+
+/**
+ * @brief Transcodes one tuple, or only measures it while `ctx->out` is NULL.
+ *
+ * @param size Receives the encoded size of the written tuple.
+ * @return 1 if the tuple was written, 0 if it was dropped, -1 on error.
+ */
+static int TranscodeTuple(TranscodeContext *ctx, InputStream *in,
+                          const DictionaryEntry *entries, size_t count,
+                          bool is_array_item, uint64_t *size) {
+  const BejTranslation *translation = ctx->translation;
+  uint64_t raw_seq = BejUnpackNNInt(in);
+  uint8_t format_byte = (uint8_t)StreamReadInt(in, 1);
+  uint8_t format = format_byte >> 4;
+  uint64_t length = BejUnpackNNInt(in);
+  if (length > in->size - in->pos) return -1;
+  InputStream value = {in->data, in->pos + length, in->pos};
+  in->pos += length;
+
+  const DictionaryEntry *source =
+      DictionaryFindEntry(entries, count, is_array_item ? 0 : raw_seq >> 1);
+  if (!source) return -1;
+  uint32_t mapped = translation->map[source - translation->source.entries];
+  if (mapped == BEJ_TRANSLATION_UNMAPPED) {
+    ctx->dropped++;
+    return 0;
+  }
+  const DictionaryEntry *target = &translation->target.entries[mapped];
+
+  uint8_t header[3 * TRANSCODE_MAX_NNINT + 1];
+  size_t header_len = TranscodePackNNInt(
+      header, is_array_item ? raw_seq
+                            : ((uint64_t)target->sequence_number << 1) |
+                                  (raw_seq & 1));
+  header[header_len++] = format_byte;
+
+  switch (format) {
+    case BEJ_FORMAT_SET:
+    case BEJ_FORMAT_ARRAY: {
+      uint64_t member_count = BejUnpackNNInt(&value);
+      const DictionaryEntry *children = NULL;
+      size_t child_count = 0;
+      if (member_count > value.size - value.pos) return -1;
+      if (member_count > 0 &&
+          !DictionaryFindSubset(&translation->source, source->offset,
+                                source->child_count, &children,
+                                &child_count)) {
+        return -1;
+      }
+
+      size_t prefix_len = header_len;
+      size_t slot = 0;
+      if (!ctx->out) {
+        if (!TranscodeAddContainer(ctx, &slot)) return -1;
+      } else {
+        if (ctx->next_container == ctx->container_count) return -1;
+        const TranscodeContainer *container =
+            &ctx->containers[ctx->next_container++];
+        header_len += TranscodePackNNInt(header + header_len,
+                                         container->size);
+        header_len += TranscodePackNNInt(header + header_len,
+                                         container->count);
+        OutputStreamWrite(ctx->out, (const char *)header, header_len);
+      }
+
+      uint64_t written = 0, members_size = 0;
+      for (uint64_t i = 0; i < member_count; ++i) {
+        uint64_t member_size;
+        int rc = TranscodeTuple(ctx, &value, children, child_count,
+                                format == BEJ_FORMAT_ARRAY, &member_size);
+        if (rc < 0) return -1;
+        if (rc == 0) continue;
+        written++;
+        members_size += member_size;
+      }
+
+      uint64_t value_size = TranscodeNNIntSize(written) + members_size;
+      if (!ctx->out) {
+        ctx->containers[slot].count = written;
+        ctx->containers[slot].size = value_size;
+      } else if (ctx->out->overflow) {
+        return -1;
+      }
+      *size = prefix_len + TranscodeNNIntSize(value_size) + value_size;
+      return 1;
+    }
+    case BEJ_FORMAT_ENUM: {
+      uint64_t enum_seq = BejUnpackNNInt(&value);
+      const DictionaryEntry *values;
+      size_t value_count;
+      if (!DictionaryFindSubset(&translation->source, source->offset,
+                                source->child_count, &values,
+                                &value_count)) {
+        return -1;
+      }
+      const DictionaryEntry *enum_value =
+          DictionaryFindEntry(values, value_count, enum_seq);
+      uint32_t enum_mapped =
+          enum_value
+              ? translation->map[enum_value - translation->source.entries]
+              : BEJ_TRANSLATION_UNMAPPED;
+      if (enum_mapped == BEJ_TRANSLATION_UNMAPPED) {
+        ctx->dropped++;
+        return 0;
+      }
+
+      uint8_t enum_buf[TRANSCODE_MAX_NNINT];
+      size_t enum_len = TranscodePackNNInt(
+          enum_buf,
+          translation->target.entries[enum_mapped].sequence_number);
+      header_len += TranscodePackNNInt(header + header_len, enum_len);
+      *size = header_len + enum_len;
+      if (!ctx->out) return 1;
+      OutputStreamWrite(ctx->out, (const char *)header, header_len);
+      OutputStreamWrite(ctx->out, (const char *)enum_buf, enum_len);
+      return ctx->out->overflow ? -1 : 1;
+    }
+    default:
+      // Leaf values are copied verbatim.
+      header_len += TranscodePackNNInt(header + header_len, length);
+      *size = header_len + length;
+      if (!ctx->out) return 1;
+      OutputStreamWrite(ctx->out, (const char *)header, header_len);
+      OutputStreamWrite(ctx->out, (const char *)value.data + value.pos,
+                        length);
+      return ctx->out->overflow ? -1 : 1;
+  }
+}
+
+bool BejTranscode(const BejTranslation *translation, const uint8_t *payload,
+                  size_t size, OutputStream *out, size_t *dropped) {
+  TranscodeContext ctx = {translation, NULL, NULL, 0, 0, 0, 0};
+  InputStream in = {payload, size, 0};
+  OutputStreamInit(out);
+
+  const DictionaryEntry *root;
+  size_t count;
+  uint64_t tuple_size;
+  bool ok = BejReadHeader(&in) &&
+            DictionaryFindSubset(&translation->source, 0, 1, &root, &count);
+  size_t header_size = in.pos;
+  if (ok) {
+    ok = TranscodeTuple(&ctx, &in, root, count, false, &tuple_size) == 1;
+  }
+  if (ok) {
+    ctx.out = out;
+    ctx.dropped = 0;
+    in.pos = header_size;
+    OutputStreamWrite(out, (const char *)payload, header_size);
+    ok = TranscodeTuple(&ctx, &in, root, count, false, &tuple_size) == 1;
+  }
+  free(ctx.containers);
+  if (dropped) *dropped = ctx.dropped;
+  return ok && !out->overflow;
+}
+
+void BejTranslationRelease(BejTranslation *translation) {
+  DictionaryRelease(&translation->source);
+  DictionaryRelease(&translation->target);
+  free(translation->map);
+  translation->map = NULL;
+}
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "archive.h"
+#include "stream_utils.h"
+#include "unity.h"
+
+#define ARCHIVE_PATH "test_archive.beja"
+
+static InputStream dicts[2];
+static InputStream memory_payload, message_payload;
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+static void LoadStream(const char *path, InputStream *stream) {
+  size_t size;
+  uint8_t *data = ReadFile(path, &size);
+  *stream = (InputStream){data, size, 0};
+}
+
+static void AppendRecords(size_t count) {
+  BejArchiveWriter writer;
+  TEST_ASSERT_TRUE(BejArchiveWriterOpen(&writer, ARCHIVE_PATH));
+  for (size_t i = 0; i < count; ++i) {
+    const InputStream *payload = (i % 2) ? &message_payload : &memory_payload;
+    TEST_ASSERT_TRUE(BejArchiveAppend(&writer, (uint16_t)(i % 2), 1000 + i,
+                                      payload->data, payload->size));
+  }
+  TEST_ASSERT_TRUE(BejArchiveWriterClose(&writer));
+}
+
+void setUp(void) {
+  remove(ARCHIVE_PATH);
+  LoadStream("dummy_dictionaries/Memory_v1.bin", &dicts[0]);
+  LoadStream("dummy_dictionaries/Message_v1.bin", &dicts[1]);
+  LoadStream("dummy_data/memory_bej.bin", &memory_payload);
+  LoadStream("dummy_data/message_bej.bin", &message_payload);
+}
+
+void tearDown(void) {
+  remove(ARCHIVE_PATH);
+  free((void *)dicts[0].data);
+  free((void *)dicts[1].data);
+  free((void *)memory_payload.data);
+  free((void *)message_payload.data);
+}
+
+void test_archive_random_access(void) {
+  AppendRecords(3);
+  AppendRecords(2);
+
+  BejArchive archive;
+  TEST_ASSERT_TRUE(BejArchiveOpen(&archive, ARCHIVE_PATH));
+  TEST_ASSERT_EQUAL_size_t(5, archive.record_count);
+
+  BejArchiveRecord record;
+  TEST_ASSERT_TRUE(BejArchiveGetRecord(&archive, 4, &record));
+  TEST_ASSERT_EQUAL_UINT(1, record.dictionary_id);
+  TEST_ASSERT_EQUAL_UINT64(1001, record.timestamp);
+  TEST_ASSERT_EQUAL_size_t(message_payload.size, record.size);
+  TEST_ASSERT_EQUAL_MEMORY(message_payload.data, record.payload, record.size);
+
+  TEST_ASSERT_TRUE(BejArchiveGetRecord(&archive, 3, &record));
+  TEST_ASSERT_EQUAL_UINT(0, record.dictionary_id);
+  TEST_ASSERT_EQUAL_MEMORY(memory_payload.data, record.payload, record.size);
+  TEST_ASSERT_FALSE(BejArchiveGetRecord(&archive, 5, &record));
+
+  BejArchiveClose(&archive);
+}
+
+void test_archive_recovers_missing_index(void) {
+  AppendRecords(2);
+
+  FILE *f = fopen(ARCHIVE_PATH, "r+b");
+  TEST_ASSERT_NOT_NULL(f);
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_INT(0, truncate(ARCHIVE_PATH, size - 3));
+
+  BejArchive archive;
+  TEST_ASSERT_FALSE(BejArchiveOpen(&archive, ARCHIVE_PATH));
+
+  AppendRecords(1);
+  TEST_ASSERT_TRUE(BejArchiveOpen(&archive, ARCHIVE_PATH));
+  TEST_ASSERT_EQUAL_size_t(3, archive.record_count);
+  BejArchiveClose(&archive);
+}
+
+static void PutLE(uint8_t *p, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; ++i) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+void test_archive_rejects_wrapped_index_offset(void) {
+  // A header and a footer whose index offset wraps around to pass
+  // index_offset + count * 8 + footer == size.
+  uint8_t bytes[BEJ_ARCHIVE_HEADER_SIZE + BEJ_ARCHIVE_FOOTER_SIZE] = {0};
+  memcpy(bytes, "BEJA", 4);
+  PutLE(bytes + 4, BEJ_ARCHIVE_VERSION, 2);
+  uint8_t *footer = bytes + BEJ_ARCHIVE_HEADER_SIZE;
+  PutLE(footer, UINT64_MAX - 23, 8);
+  PutLE(footer + 8, 4, 8);
+  memcpy(footer + 16, "BEJX", 4);
+
+  FILE *f = fopen(ARCHIVE_PATH, "wb");
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL_size_t(sizeof(bytes), fwrite(bytes, 1, sizeof(bytes), f));
+  fclose(f);
+
+  BejArchive archive;
+  TEST_ASSERT_FALSE(BejArchiveOpen(&archive, ARCHIVE_PATH));
+
+  // The writer ignores the footer and rebuilds an empty index.
+  AppendRecords(1);
+  TEST_ASSERT_TRUE(BejArchiveOpen(&archive, ARCHIVE_PATH));
+  TEST_ASSERT_EQUAL_size_t(1, archive.record_count);
+  BejArchiveClose(&archive);
+}
+
+void test_archive_decode_all_keeps_order(void) {
+  AppendRecords(300);
+
+  BejArchive archive;
+  TEST_ASSERT_TRUE(BejArchiveOpen(&archive, ARCHIVE_PATH));
+
+  FILE *out = tmpfile();
+  BejArchiveDecodeStats stats;
+  TEST_ASSERT_TRUE(BejArchiveDecodeAll(&archive, dicts, 2, 4, out, &stats));
+  TEST_ASSERT_EQUAL_size_t(300, stats.records);
+  TEST_ASSERT_EQUAL_size_t(0, stats.failed);
+
+  rewind(out);
+  char line[4096];
+  for (int i = 0; i < 300; ++i) {
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), out));
+    const char *prefix = (i % 2) ? "{\"MessageId\":" : "{\"CapacityMiB\":";
+    TEST_ASSERT_EQUAL_STRING_LEN(prefix, line, strlen(prefix));
+  }
+  TEST_ASSERT_NULL(fgets(line, sizeof(line), out));
+
+  fclose(out);
+  BejArchiveClose(&archive);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_archive_random_access);
+  RUN_TEST(test_archive_recovers_missing_index);
+  RUN_TEST(test_archive_rejects_wrapped_index_offset);
+  RUN_TEST(test_archive_decode_all_keeps_order);
+  return UNITY_END();
+}
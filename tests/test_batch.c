@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "decoder.h"
+#include "unity.h"
+
+static BejDecoder *decoder;
+static uint8_t *payload;
+static size_t payload_size;
+static char dir[] = "/tmp/bej_batch_XXXXXX";
+static char inputs[3][64];
+static char outputs[3][64];
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return NULL;
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz + 1);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+void setUp(void) {
+  size_t dict_size;
+  uint8_t *dict = ReadFile("dummy_dictionaries/Memory_v1.bin", &dict_size);
+  TEST_ASSERT_NOT_NULL(dict);
+  decoder = BejDecoderCreate(dict, dict_size);
+  free(dict);
+  payload = ReadFile("dummy_data/memory_bej.bin", &payload_size);
+  TEST_ASSERT_NOT_NULL(payload);
+
+  TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+  for (int i = 0; i < 3; ++i) {
+    snprintf(inputs[i], sizeof(inputs[i]), "%s/in%d.bin", dir, i);
+    snprintf(outputs[i], sizeof(outputs[i]), "%s/out%d.json", dir, i);
+  }
+  // inputs[1] is left missing.
+  for (int i = 0; i < 3; i += 2) {
+    FILE *f = fopen(inputs[i], "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    fwrite(payload, 1, payload_size, f);
+    fclose(f);
+  }
+}
+
+void tearDown(void) {
+  for (int i = 0; i < 3; ++i) {
+    unlink(inputs[i]);
+    unlink(outputs[i]);
+  }
+  rmdir(dir);
+  strcpy(dir, "/tmp/bej_batch_XXXXXX");
+  free(payload);
+  BejDecoderDestroy(decoder);
+}
+
+static void RunBackend(BejBatchBackend backend, BejBatchBackend expected) {
+  char *in[] = {inputs[0], inputs[1], inputs[2]};
+  char *out[] = {outputs[0], outputs[1], outputs[2]};
+  BejBatchOptions options = {backend, 2};
+  BejBatchStats stats;
+  TEST_ASSERT_FALSE(BejBatchDecodeFiles(decoder, in, out, 3, &options,
+                                        &stats));
+  TEST_ASSERT_EQUAL_INT(expected, stats.backend);
+  TEST_ASSERT_EQUAL_size_t(3, stats.files);
+  TEST_ASSERT_EQUAL_size_t(1, stats.failed);
+  TEST_ASSERT_EQUAL_size_t(2 * payload_size, stats.bytes_read);
+
+  static char expected_json[OUTBUF_SIZE];
+  const char *json;
+  size_t json_size;
+  TEST_ASSERT_TRUE(
+      BejDecoderDecode(decoder, payload, payload_size, &json, &json_size));
+  memcpy(expected_json, json, json_size + 1);
+  TEST_ASSERT_EQUAL_size_t(2 * json_size, stats.bytes_written);
+
+  for (int i = 0; i < 3; i += 2) {
+    size_t size;
+    uint8_t *written = ReadFile(outputs[i], &size);
+    TEST_ASSERT_NOT_NULL(written);
+    written[size] = '\0';
+    TEST_ASSERT_EQUAL_STRING(expected_json, (const char *)written);
+    free(written);
+  }
+}
+
+void test_batch_sync_backend(void) {
+  RunBackend(BEJ_BATCH_SYNC, BEJ_BATCH_SYNC);
+}
+
+void test_batch_pread_backend(void) {
+  RunBackend(BEJ_BATCH_PREAD, BEJ_BATCH_PREAD);
+}
+
+void test_batch_uring_backend_or_fallback(void) {
+  RunBackend(BEJ_BATCH_URING, BejBatchUringAvailable() ? BEJ_BATCH_URING
+                                                       : BEJ_BATCH_PREAD);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_batch_sync_backend);
+  RUN_TEST(test_batch_pread_backend);
+  RUN_TEST(test_batch_uring_backend_or_fallback);
+  return UNITY_END();
+}
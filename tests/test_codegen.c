@@ -0,0 +1,102 @@
+#include <stdlib.h>
+
+#include "bej_decode_memory.h"
+#include "bej_decode_message.h"
+#include "decoder.h"
+#include "stream_utils.h"
+#include "unity.h"
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+static OutputStream generic_output, generated_output;
+
+void setUp(void) {
+  OutputStreamInit(&generic_output);
+  OutputStreamInit(&generated_output);
+}
+void tearDown(void) {}
+
+void test_generated_memory_decoder_matches_generic(void) {
+  size_t dict_sz, bej_sz;
+  uint8_t *dict_buf = ReadFile("dummy_dictionaries/Memory_v1.bin", &dict_sz);
+  uint8_t *bej_buf = ReadFile("dummy_data/memory_bej.bin", &bej_sz);
+
+  InputStream dict = {dict_buf, dict_sz, 0};
+  InputStream generic_input = {bej_buf, bej_sz, 0};
+  InputStream generated_input = {bej_buf, bej_sz, 0};
+
+  TEST_ASSERT_TRUE(BejDecode(&generic_output, &generic_input, &dict));
+  TEST_ASSERT_TRUE(BejDecodeMemory(&generated_output, &generated_input));
+  TEST_ASSERT_EQUAL_STRING(generic_output.data, generated_output.data);
+  TEST_ASSERT_EQUAL_size_t(generic_input.pos, generated_input.pos);
+
+  free(dict_buf);
+  free(bej_buf);
+}
+
+void test_generated_message_decoder_matches_generic(void) {
+  size_t dict_sz, bej_sz;
+  uint8_t *dict_buf = ReadFile("dummy_dictionaries/Message_v1.bin", &dict_sz);
+  uint8_t *bej_buf = ReadFile("dummy_data/message_bej.bin", &bej_sz);
+
+  InputStream dict = {dict_buf, dict_sz, 0};
+  InputStream generic_input = {bej_buf, bej_sz, 0};
+  InputStream generated_input = {bej_buf, bej_sz, 0};
+
+  TEST_ASSERT_TRUE(BejDecode(&generic_output, &generic_input, &dict));
+  TEST_ASSERT_TRUE(BejDecodeMessage(&generated_output, &generated_input));
+  TEST_ASSERT_EQUAL_STRING(generic_output.data, generated_output.data);
+
+  free(dict_buf);
+  free(bej_buf);
+}
+
+void test_generated_decoder_handles_truncated_payloads(void) {
+  size_t bej_sz;
+  uint8_t *bej_buf = ReadFile("dummy_data/memory_bej.bin", &bej_sz);
+
+  // No cut may crash the decoder. Cuts at 91 to 95 bytes fall inside the
+  // "Some" string value, which can then not be read.
+  for (size_t size = 0; size < bej_sz; ++size) {
+    InputStream input = {bej_buf, size, 0};
+    OutputStreamInit(&generated_output);
+    bool ok = BejDecodeMemory(&generated_output, &input);
+    if (size >= 91 && size <= 95) TEST_ASSERT_FALSE(ok);
+  }
+
+  free(bej_buf);
+}
+
+void test_generated_decoder_rejects_error_payload(void) {
+  uint8_t bej_buf[] = {0xF1, 0xF0, 0xF0, 0x00, 0x00, 0x00, 0x00};
+  InputStream input = {bej_buf, sizeof(bej_buf), 0};
+
+  TEST_ASSERT_FALSE(BejDecodeMemory(&generated_output, &input));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_generated_memory_decoder_matches_generic);
+  RUN_TEST(test_generated_message_decoder_matches_generic);
+  RUN_TEST(test_generated_decoder_handles_truncated_payloads);
+  RUN_TEST(test_generated_decoder_rejects_error_payload);
+  return UNITY_END();
+}
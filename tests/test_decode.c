@@ -1,5 +1,7 @@
 
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "decoder.h"
 #include "dictionary.h"
@@ -129,8 +131,119 @@ void test_decoder_real_payload(void) {
   free(bej_message_buf);
 }
 
+/**
+ * Arguments of a thread decoding the same payload repeatedly with its own
+ * BejDecoder.
+ */
+typedef struct {
+  const uint8_t *dict;
+  size_t dict_size;
+  const uint8_t *payload;
+  size_t payload_size;
+  const char *expected;
+  int mismatches;
+} DecodeThreadArgs;
+
+static void *DecodeThread(void *arg) {
+  DecodeThreadArgs *args = arg;
+  BejDecoder *decoder = BejDecoderCreate(args->dict, args->dict_size);
+  if (!decoder) {
+    args->mismatches = -1;
+    return NULL;
+  }
+  for (int i = 0; i < 1000; ++i) {
+    const char *json;
+    size_t json_size;
+    if (!BejDecoderDecode(decoder, args->payload, args->payload_size, &json,
+                          &json_size) ||
+        strcmp(json, args->expected) != 0) {
+      args->mismatches++;
+    }
+  }
+  BejDecoderDestroy(decoder);
+  return NULL;
+}
+
+void test_decoder_handle_matches_bej_decode(void) {
+  size_t dict_sz, bej_sz;
+  uint8_t *dict_buf =
+      ReadFile("dummy_dictionaries/Memory_v1.bin", &dict_sz);
+  uint8_t *bej_buf = ReadFile("dummy_data/memory_bej.bin", &bej_sz);
+
+  InputStream dict = {dict_buf, dict_sz, 0};
+  InputStream bej = {bej_buf, bej_sz, 0};
+  static OutputStream expected;
+  OutputStreamInit(&expected);
+  TEST_ASSERT_TRUE(BejDecode(&expected, &bej, &dict));
+
+  BejDecoder *decoder = BejDecoderCreate(dict_buf, dict_sz);
+  TEST_ASSERT_NOT_NULL(decoder);
+
+  const char *json;
+  size_t json_size;
+  for (int i = 0; i < 3; ++i) {
+    TEST_ASSERT_TRUE(
+        BejDecoderDecode(decoder, bej_buf, bej_sz, &json, &json_size));
+    TEST_ASSERT_EQUAL_size_t(expected.pos, json_size);
+    TEST_ASSERT_EQUAL_STRING(expected.data, json);
+  }
+
+  TEST_ASSERT_TRUE(
+      BejDecoderDecodeCompact(decoder, bej_buf, bej_sz, &json, &json_size));
+  TEST_ASSERT_EQUAL_STRING_LEN("{\"CapacityMiB\":65536,", json, 21);
+
+  BejDecoderReset(decoder);
+  BejDecoderDestroy(decoder);
+  free(dict_buf);
+  free(bej_buf);
+}
+
+void test_decoder_handles_are_independent_across_threads(void) {
+  size_t memory_dict_sz, memory_sz, message_dict_sz, message_sz;
+  uint8_t *memory_dict =
+      ReadFile("dummy_dictionaries/Memory_v1.bin", &memory_dict_sz);
+  uint8_t *memory = ReadFile("dummy_data/memory_bej.bin", &memory_sz);
+  uint8_t *message_dict =
+      ReadFile("dummy_dictionaries/Message_v1.bin", &message_dict_sz);
+  uint8_t *message = ReadFile("dummy_data/message_bej.bin", &message_sz);
+
+  static OutputStream memory_json, message_json;
+  InputStream dict = {memory_dict, memory_dict_sz, 0};
+  InputStream bej = {memory, memory_sz, 0};
+  OutputStreamInit(&memory_json);
+  TEST_ASSERT_TRUE(BejDecode(&memory_json, &bej, &dict));
+  dict = (InputStream){message_dict, message_dict_sz, 0};
+  bej = (InputStream){message, message_sz, 0};
+  OutputStreamInit(&message_json);
+  TEST_ASSERT_TRUE(BejDecode(&message_json, &bej, &dict));
+
+  DecodeThreadArgs args[4];
+  pthread_t threads[4];
+  for (int i = 0; i < 4; ++i) {
+    args[i] = (i % 2) ? (DecodeThreadArgs){message_dict, message_dict_sz,
+                                           message, message_sz,
+                                           message_json.data, 0}
+                      : (DecodeThreadArgs){memory_dict, memory_dict_sz,
+                                           memory, memory_sz,
+                                           memory_json.data, 0};
+    TEST_ASSERT_EQUAL_INT(
+        0, pthread_create(&threads[i], NULL, DecodeThread, &args[i]));
+  }
+  for (int i = 0; i < 4; ++i) {
+    pthread_join(threads[i], NULL);
+    TEST_ASSERT_EQUAL_INT(0, args[i].mismatches);
+  }
+
+  free(memory_dict);
+  free(memory);
+  free(message_dict);
+  free(message);
+}
+
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_decoder_real_payload);
+  RUN_TEST(test_decoder_handle_matches_bej_decode);
+  RUN_TEST(test_decoder_handles_are_independent_across_threads);
   return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "decode_cache.h"
+#include "decoder.h"
+#include "stream_utils.h"
+#include "unity.h"
+
+static uint8_t *dict;
+static size_t dict_size;
+static uint8_t *payload;
+static size_t payload_size;
+static char expected[OUTBUF_SIZE];
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+void setUp(void) {
+  dict = ReadFile("dummy_dictionaries/Memory_v1.bin", &dict_size);
+  payload = ReadFile("dummy_data/memory_bej.bin", &payload_size);
+}
+
+void tearDown(void) {
+  free(dict);
+  free(payload);
+}
+
+/**
+ * @brief Decodes `data` without a cache into `expected`.
+ */
+static void DecodeUncached(const uint8_t *data, size_t size, bool compact) {
+  BejDecoder *decoder = BejDecoderCreate(dict, dict_size);
+  const char *json;
+  size_t json_size;
+  TEST_ASSERT_TRUE(compact ? BejDecoderDecodeCompact(decoder, data, size,
+                                                     &json, &json_size)
+                           : BejDecoderDecode(decoder, data, size, &json,
+                                              &json_size));
+  memcpy(expected, json, json_size + 1);
+  BejDecoderDestroy(decoder);
+}
+
+static void AssertCachedDecode(BejDecoder *decoder, const uint8_t *data,
+                               size_t size, bool compact) {
+  DecodeUncached(data, size, compact);
+  const char *json;
+  size_t json_size;
+  TEST_ASSERT_TRUE(compact ? BejDecoderDecodeCompact(decoder, data, size,
+                                                     &json, &json_size)
+                           : BejDecoderDecode(decoder, data, size, &json,
+                                              &json_size));
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), json_size);
+  TEST_ASSERT_EQUAL_STRING(expected, json);
+}
+
+void test_repeated_payload_hits_whole_document(void) {
+  BejDecodeCache *cache = BejDecodeCacheCreate(1 << 20, 32);
+  BejDecoder *decoder = BejDecoderCreate(dict, dict_size);
+  BejDecoderSetCache(decoder, cache);
+
+  BejDecodeCacheStats stats;
+  AssertCachedDecode(decoder, payload, payload_size, false);
+  BejDecodeCacheGetStats(cache, &stats);
+  TEST_ASSERT_EQUAL_UINT64(0, stats.hits);
+  TEST_ASSERT_EQUAL_UINT64(1, stats.insertions);
+
+  AssertCachedDecode(decoder, payload, payload_size, false);
+  BejDecodeCacheGetStats(cache, &stats);
+  TEST_ASSERT_EQUAL_UINT64(1, stats.hits);
+
+  // Compact output is a different style and is cached separately.
+  AssertCachedDecode(decoder, payload, payload_size, true);
+  AssertCachedDecode(decoder, payload, payload_size, true);
+  BejDecodeCacheGetStats(cache, &stats);
+  TEST_ASSERT_EQUAL_UINT64(2, stats.hits);
+  TEST_ASSERT_EQUAL_size_t(2, stats.entries);
+
+  BejDecoderDestroy(decoder);
+  BejDecodeCacheDestroy(cache);
+}
+
+void test_changed_leaf_reuses_unchanged_subtrees(void) {
+  BejDecodeCache *cache = BejDecodeCacheCreate(1 << 20, 8);
+  BejDecoder *decoder = BejDecoderCreate(dict, dict_size);
+  BejDecoderSetCache(decoder, cache);
+  AssertCachedDecode(decoder, payload, payload_size, false);
+
+  // CapacityMiB becomes 131072; AllowedSpeedsMHz and MemoryLocation stay.
+  payload[0x15] = 0x02;
+  AssertCachedDecode(decoder, payload, payload_size, false);
+  TEST_ASSERT_NOT_NULL(strstr(expected, "131072"));
+
+  BejDecodeCacheStats stats;
+  BejDecodeCacheGetStats(cache, &stats);
+  TEST_ASSERT_EQUAL_UINT64(2, stats.hits);
+  TEST_ASSERT_EQUAL_UINT64(4, stats.misses);
+
+  BejDecoderDestroy(decoder);
+  BejDecodeCacheDestroy(cache);
+}
+
+void test_container_format_is_part_of_the_key(void) {
+  BejDecodeCache *cache = BejDecodeCacheCreate(1 << 20, 8);
+  BejDecoder *decoder = BejDecoderCreate(dict, dict_size);
+  BejDecoderSetCache(decoder, cache);
+  AssertCachedDecode(decoder, payload, payload_size, false);
+  TEST_ASSERT_EQUAL_INT('{', expected[0]);
+
+  // The root keeps its sequence number and value bytes but becomes an ARRAY.
+  payload[0x09] = 0x10;
+  AssertCachedDecode(decoder, payload, payload_size, false);
+  TEST_ASSERT_EQUAL_INT('[', expected[0]);
+
+  BejDecoderDestroy(decoder);
+  BejDecodeCacheDestroy(cache);
+}
+
+void test_memory_bound_evicts_least_recently_used(void) {
+  BejDecodeCache *cache = BejDecodeCacheCreate(4096, 1);
+  BejDecodeCacheKey key = {1, 0, 0};
+  char fragment[200];
+  memset(fragment, 'x', sizeof(fragment));
+
+  for (uint64_t path = 0; path < 64; ++path) {
+    key.path = path;
+    TEST_ASSERT_TRUE(BejDecodeCacheInsert(cache, &key, (const uint8_t *)"ab",
+                                          2, fragment, sizeof(fragment)));
+  }
+  BejDecodeCacheStats stats;
+  BejDecodeCacheGetStats(cache, &stats);
+  TEST_ASSERT_TRUE(stats.bytes <= 4096);
+  TEST_ASSERT_TRUE(stats.evictions > 0);
+  TEST_ASSERT_EQUAL_size_t(64 - stats.evictions, stats.entries);
+
+  size_t size;
+  key.path = 0;
+  TEST_ASSERT_NULL(
+      BejDecodeCacheLookup(cache, &key, (const uint8_t *)"ab", 2, &size));
+  key.path = 63;
+  TEST_ASSERT_NOT_NULL(
+      BejDecodeCacheLookup(cache, &key, (const uint8_t *)"ab", 2, &size));
+  TEST_ASSERT_EQUAL_size_t(sizeof(fragment), size);
+  TEST_ASSERT_NULL(
+      BejDecodeCacheLookup(cache, &key, (const uint8_t *)"ac", 2, &size));
+
+  // Entries larger than an eighth of the bound are refused.
+  static char large[1024];
+  TEST_ASSERT_FALSE(BejDecodeCacheInsert(cache, &key, (const uint8_t *)"ab",
+                                         2, large, sizeof(large)));
+
+  BejDecodeCacheClear(cache);
+  BejDecodeCacheGetStats(cache, &stats);
+  TEST_ASSERT_EQUAL_size_t(0, stats.entries);
+  TEST_ASSERT_EQUAL_size_t(0, stats.bytes);
+  TEST_ASSERT_EQUAL_size_t(4096, stats.max_bytes);
+  BejDecodeCacheDestroy(cache);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_repeated_payload_hits_whole_document);
+  RUN_TEST(test_changed_leaf_reuses_unchanged_subtrees);
+  RUN_TEST(test_container_format_is_part_of_the_key);
+  RUN_TEST(test_memory_bound_evicts_least_recently_used);
+  return UNITY_END();
+}
@@ -1,6 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_types.h"
+#include "decoder.h"
 #include "dictionary.h"
+#include "stream_utils.h"
 #include "unity.h"
 
+/**
+ * @brief Entry of a dictionary built by TestBuildDictionary().
+ */
+typedef struct {
+  uint8_t format;
+  uint32_t seq;
+  uint32_t offset;
+  uint32_t count;
+  char name[16];
+} TestEntry;
+
+static void TestPut(uint8_t *buf, size_t *pos, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; ++i) buf[(*pos)++] = (uint8_t)(value >> (8 * i));
+}
+
+/**
+ * @brief Serializes a header, `entries` in order and then their names.
+ */
+static uint8_t *TestBuildDictionary(bool wide, const TestEntry *entries,
+                                    size_t count, size_t *size) {
+  size_t entry_size = wide ? DICTIONARY_WIDE_ENTRY_SIZE : DICTIONARY_ENTRY_SIZE;
+  size_t field = wide ? 4 : 2;
+  size_t names = DICTIONARY_HEADER_SIZE + count * entry_size;
+  uint8_t *buf = malloc(names + count * 16);
+  TEST_ASSERT_NOT_NULL(buf);
+
+  size_t pos = 0;
+  TestPut(buf, &pos, 0, 1);
+  TestPut(buf, &pos, wide ? DICTIONARY_FLAG_WIDE : 0, 1);
+  TestPut(buf, &pos, count & 0xFFFF, 2);
+  TestPut(buf, &pos, 0, 8);
+  size_t name_pos = names;
+  for (size_t i = 0; i < count; ++i) {
+    size_t len = strlen(entries[i].name) + 1;
+    TestPut(buf, &pos, (uint64_t)entries[i].format << 4, 1);
+    TestPut(buf, &pos, entries[i].seq, field);
+    TestPut(buf, &pos, entries[i].offset, field);
+    TestPut(buf, &pos, entries[i].count, field);
+    TestPut(buf, &pos, len, 1);
+    TestPut(buf, &pos, name_pos, field);
+    memcpy(buf + name_pos, entries[i].name, len);
+    name_pos += len;
+  }
+  *size = name_pos;
+  return buf;
+}
+
+/**
+ * @brief Decodes `payload` compactly through BejDecoder and BejDecode and
+ * checks that both produce `expected`.
+ */
+static void TestDecodeBothWays(const uint8_t *dict, size_t dict_size,
+                               const uint8_t *payload, size_t payload_size,
+                               const char *expected) {
+  BejDecoder *decoder = BejDecoderCreate(dict, dict_size);
+  TEST_ASSERT_NOT_NULL(decoder);
+  const char *json;
+  size_t json_size;
+  TEST_ASSERT_TRUE(BejDecoderDecodeCompact(decoder, payload, payload_size,
+                                           &json, &json_size));
+  TEST_ASSERT_EQUAL_STRING(expected, json);
+  BejDecoderDestroy(decoder);
+
+  static OutputStream out;
+  OutputStreamInit(&out);
+  InputStream payload_is = {payload, payload_size, 0};
+  InputStream dict_is = {dict, dict_size, 0};
+  TEST_ASSERT_TRUE(BejDecodeCompact(&out, &payload_is, &dict_is));
+  TEST_ASSERT_EQUAL_STRING(expected, out.data);
+}
+
 void setUp(void) {}
 void tearDown(void) {}
 
@@ -32,9 +110,217 @@ void test_load_dictionary_subset_into_buffer_single_entry(void) {
   TEST_ASSERT_EQUAL_STRING("Name", entries[0].name);
 }
 
+void test_dictionary_compile_finds_subsets(void) {
+  // Root entry (offset 22, one child) followed by a SET with two children.
+  uint8_t buf[] = {
+      0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x16, 0x00, 0x02, 0x00, 0x05, 0x2A, 0x00,
+      0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x2F, 0x00,
+      0x50, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x31, 0x00,
+      'R',  'o',  'o',  't',  '\0', 'A',  '\0', 'B',  '\0'};
+
+  CompiledDictionary dict;
+  TEST_ASSERT_TRUE(DictionaryCompile(&dict, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_size_t(2, dict.subset_count);
+  TEST_ASSERT_EQUAL_size_t(3, dict.entry_count);
+
+  const DictionaryEntry *entries;
+  size_t count;
+  TEST_ASSERT_TRUE(DictionaryFindSubset(&dict, 0, 1, &entries, &count));
+  TEST_ASSERT_EQUAL_size_t(1, count);
+  TEST_ASSERT_EQUAL_STRING("Root", entries[0].name);
+
+  TEST_ASSERT_TRUE(DictionaryFindSubset(&dict, entries[0].offset,
+                                        entries[0].child_count, &entries,
+                                        &count));
+  TEST_ASSERT_EQUAL_size_t(2, count);
+  TEST_ASSERT_EQUAL_STRING("B", entries[1].name);
+  TEST_ASSERT_EQUAL_UINT8(5, entries[1].format);
+
+  TEST_ASSERT_FALSE(DictionaryFindSubset(&dict, 0x40, 1, &entries, &count));
+  DictionaryRelease(&dict);
+}
+
+void test_dictionary_find_entry(void) {
+  DictionaryEntry entries[5] = {{0, 0, 0, 0, 0, "a"},
+                                {0, 0, 1, 0, 0, "b"},
+                                {0, 0, 2, 0, 0, "c"},
+                                {0, 0, 7, 0, 0, "d"},
+                                {0, 0, 7, 0, 0, "e"}};
+  TEST_ASSERT_EQUAL_STRING("b", DictionaryFindEntry(entries, 5, 1)->name);
+  TEST_ASSERT_EQUAL_STRING("d", DictionaryFindEntry(entries, 5, 7)->name);
+  TEST_ASSERT_NULL(DictionaryFindEntry(entries, 5, 3));
+  TEST_ASSERT_NULL(DictionaryFindEntry(entries, 5, 8));
+  TEST_ASSERT_NULL(DictionaryFindEntry(entries, 0, 0));
+}
+
+void test_dictionary_find_raw_entry(void) {
+  // Sorted but not numbered by position, then the same values reversed.
+  enum { kValues = 300 };
+  static TestEntry entries[2 * kValues];
+  for (uint32_t i = 0; i < kValues; ++i) {
+    entries[i] = (TestEntry){0, 2 * i, 0, 0, ""};
+    entries[kValues + i] = (TestEntry){0, 2 * (kValues - 1 - i), 0, 0, ""};
+    snprintf(entries[i].name, sizeof(entries[i].name), "V%u", 2 * i);
+    snprintf(entries[kValues + i].name, sizeof(entries[i].name), "V%u",
+             2 * (kValues - 1 - i));
+  }
+  size_t size;
+  uint8_t *dict = TestBuildDictionary(false, entries, 2 * kValues, &size);
+  uint32_t sorted = DICTIONARY_HEADER_SIZE;
+  uint32_t reversed = sorted + kValues * DICTIONARY_ENTRY_SIZE;
+
+  DictionaryEntry entry;
+  TEST_ASSERT_TRUE(
+      DictionaryFindRawEntry(dict, size, sorted, kValues, 2, &entry));
+  TEST_ASSERT_EQUAL_STRING("V2", entry.name);
+  TEST_ASSERT_TRUE(
+      DictionaryFindRawEntry(dict, size, sorted, kValues, 598, &entry));
+  TEST_ASSERT_EQUAL_STRING("V598", entry.name);
+  TEST_ASSERT_FALSE(
+      DictionaryFindRawEntry(dict, size, sorted, kValues, 7, &entry));
+  TEST_ASSERT_TRUE(
+      DictionaryFindRawEntry(dict, size, reversed, kValues, 100, &entry));
+  TEST_ASSERT_EQUAL_STRING("V100", entry.name);
+  TEST_ASSERT_FALSE(
+      DictionaryFindRawEntry(dict, size, reversed, kValues, 601, &entry));
+  free(dict);
+}
+
+void test_dictionary_set_with_more_than_512_members(void) {
+  enum { kMembers = 600 };
+  static TestEntry entries[kMembers + 1];
+  entries[0] = (TestEntry){BEJ_FORMAT_SET, 0,
+                           DICTIONARY_HEADER_SIZE + DICTIONARY_ENTRY_SIZE,
+                           kMembers, "Root"};
+  for (uint32_t i = 0; i < kMembers; ++i) {
+    entries[i + 1] = (TestEntry){BEJ_FORMAT_INTEGER, i, 0, 0, ""};
+    snprintf(entries[i + 1].name, sizeof(entries[i + 1].name), "P%u", i);
+  }
+  size_t size;
+  uint8_t *dict = TestBuildDictionary(false, entries, kMembers + 1, &size);
+
+  CompiledDictionary compiled;
+  TEST_ASSERT_TRUE(DictionaryCompile(&compiled, dict, size));
+  TEST_ASSERT_EQUAL_size_t(kMembers + 1, compiled.entry_count);
+  DictionaryRelease(&compiled);
+
+  // {"P599": 42}
+  const uint8_t payload[] = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00,
+                             0x01, 0x00, 0x00, 0x01, 0x09, 0x01, 0x01,
+                             0x02, 0xAE, 0x04, 0x30, 0x01, 0x01, 0x2A};
+  TestDecodeBothWays(dict, size, payload, sizeof(payload), "{\"P599\":42}");
+  free(dict);
+}
+
+void test_dictionary_wide_layout_with_large_enum(void) {
+  // Values are stored in reverse order; compiling sorts them. Their names
+  // push the dictionary past 64 KiB.
+  enum { kValues = 4000 };
+  static TestEntry entries[kValues + 2];
+  entries[0] = (TestEntry){BEJ_FORMAT_SET, 0,
+                           DICTIONARY_HEADER_SIZE + DICTIONARY_WIDE_ENTRY_SIZE,
+                           1, "Root"};
+  entries[1] = (TestEntry){BEJ_FORMAT_ENUM, 0,
+                           DICTIONARY_HEADER_SIZE +
+                               2 * DICTIONARY_WIDE_ENTRY_SIZE,
+                           kValues, "Big"};
+  for (uint32_t i = 0; i < kValues; ++i) {
+    uint32_t seq = kValues - 1 - i;
+    entries[i + 2] = (TestEntry){0, seq, 0, 0, ""};
+    snprintf(entries[i + 2].name, sizeof(entries[i + 2].name),
+             "LongValue%u", seq);
+  }
+  size_t size;
+  uint8_t *dict = TestBuildDictionary(true, entries, kValues + 2, &size);
+  TEST_ASSERT_TRUE(size > UINT16_MAX);
+  TEST_ASSERT_TRUE(DictionaryIsWide(dict, size));
+
+  CompiledDictionary compiled;
+  TEST_ASSERT_TRUE(DictionaryCompile(&compiled, dict, size));
+  const DictionaryEntry *values;
+  size_t count;
+  TEST_ASSERT_TRUE(DictionaryFindSubset(&compiled, entries[1].offset,
+                                        kValues, &values, &count));
+  TEST_ASSERT_EQUAL_size_t(kValues, count);
+  for (uint32_t seq = 0; seq < kValues; ++seq) {
+    TEST_ASSERT_EQUAL_UINT32(seq, values[seq].sequence_number);
+  }
+  TEST_ASSERT_EQUAL_STRING("LongValue3999",
+                           DictionaryFindEntry(values, count, 3999)->name);
+  DictionaryRelease(&compiled);
+
+  // {"Big": "LongValue2500"}
+  const uint8_t payload[] = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00,
+                             0x01, 0x00, 0x00, 0x01, 0x0A, 0x01, 0x01,
+                             0x01, 0x00, 0x40, 0x01, 0x03, 0x02, 0xC4, 0x09};
+  TestDecodeBothWays(dict, size, payload, sizeof(payload),
+                     "{\"Big\":\"LongValue2500\"}");
+  free(dict);
+}
+
+void test_dictionary_compile_rejects_oversized_subset(void) {
+  TestEntry root = {BEJ_FORMAT_SET, 0, DICTIONARY_HEADER_SIZE, 0xFFFFFFF0u,
+                    "Root"};
+  size_t size;
+  uint8_t *dict = TestBuildDictionary(true, &root, 1, &size);
+  CompiledDictionary compiled;
+  TEST_ASSERT_FALSE(DictionaryCompile(&compiled, dict, size));
+  free(dict);
+}
+
+void test_dictionary_subsets_sharing_an_offset(void) {
+  // A's enum is the first value of B's, and the values are not stored in
+  // sequence number order.
+  enum { kValues = DICTIONARY_HEADER_SIZE + 3 * DICTIONARY_ENTRY_SIZE };
+  const TestEntry entries[] = {
+      {BEJ_FORMAT_SET, 0, DICTIONARY_HEADER_SIZE + DICTIONARY_ENTRY_SIZE, 2,
+       "Root"},
+      {BEJ_FORMAT_ENUM, 0, kValues, 1, "A"},
+      {BEJ_FORMAT_ENUM, 1, kValues, 2, "B"},
+      {0, 5, 0, 0, "Five"},
+      {0, 1, 0, 0, "One"},
+  };
+  size_t size;
+  uint8_t *dict = TestBuildDictionary(false, entries, 5, &size);
+
+  CompiledDictionary compiled;
+  TEST_ASSERT_TRUE(DictionaryCompile(&compiled, dict, size));
+  const DictionaryEntry *values;
+  size_t count;
+  TEST_ASSERT_TRUE(
+      DictionaryFindSubset(&compiled, kValues, 1, &values, &count));
+  TEST_ASSERT_EQUAL_size_t(1, count);
+  TEST_ASSERT_EQUAL_STRING("Five", values[0].name);
+  TEST_ASSERT_TRUE(
+      DictionaryFindSubset(&compiled, kValues, 2, &values, &count));
+  TEST_ASSERT_EQUAL_size_t(2, count);
+  TEST_ASSERT_EQUAL_STRING("One", values[0].name);
+  TEST_ASSERT_EQUAL_STRING("Five", values[1].name);
+  TEST_ASSERT_FALSE(
+      DictionaryFindSubset(&compiled, kValues, 3, &values, &count));
+  DictionaryRelease(&compiled);
+
+  // {"A": "Five", "B": "One"}
+  const uint8_t payload[] = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00, 0x01,
+                             0x00, 0x00, 0x01, 0x10, 0x01, 0x02, 0x01, 0x00,
+                             0x40, 0x01, 0x02, 0x01, 0x05, 0x01, 0x02, 0x40,
+                             0x01, 0x02, 0x01, 0x01};
+  TestDecodeBothWays(dict, size, payload, sizeof(payload),
+                     "{\"A\":\"Five\",\"B\":\"One\"}");
+  free(dict);
+}
+
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_load_dictionary_subset_into_buffer_empty);
   RUN_TEST(test_load_dictionary_subset_into_buffer_single_entry);
+  RUN_TEST(test_dictionary_compile_finds_subsets);
+  RUN_TEST(test_dictionary_find_entry);
+  RUN_TEST(test_dictionary_find_raw_entry);
+  RUN_TEST(test_dictionary_set_with_more_than_512_members);
+  RUN_TEST(test_dictionary_wide_layout_with_large_enum);
+  RUN_TEST(test_dictionary_compile_rejects_oversized_subset);
+  RUN_TEST(test_dictionary_subsets_sharing_an_offset);
   return UNITY_END();
 }
\ No newline at end of file
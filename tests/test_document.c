@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "decoder.h"
+#include "dictionary.h"
+#include "document.h"
+#include "stream_utils.h"
+#include "unity.h"
+
+static uint8_t *dict_data;
+static size_t dict_size;
+static uint8_t *payload;
+static size_t payload_size;
+static CompiledDictionary dict;
+static Arena arena;
+static OutputStream out;
+static OutputStream expected;
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+void setUp(void) {
+  dict_data = ReadFile("dummy_dictionaries/Memory_v1.bin", &dict_size);
+  payload = ReadFile("dummy_data/memory_bej.bin", &payload_size);
+  TEST_ASSERT_TRUE(DictionaryCompile(&dict, dict_data, dict_size));
+  ArenaInit(&arena, 1024);
+  OutputStreamInit(&out);
+  OutputStreamInit(&expected);
+}
+
+void tearDown(void) {
+  ArenaRelease(&arena);
+  DictionaryRelease(&dict);
+  free(dict_data);
+  free(payload);
+}
+
+static void DecodeInto(OutputStream *stream, const uint8_t *data, size_t size,
+                       bool compact) {
+  InputStream payload_is = {data, size, 0};
+  InputStream dict_is = {dict_data, dict_size, 0};
+  OutputStreamInit(stream);
+  TEST_ASSERT_TRUE(compact ? BejDecodeCompact(stream, &payload_is, &dict_is)
+                           : BejDecode(stream, &payload_is, &dict_is));
+}
+
+void test_document_json_matches_decoder(void) {
+  BejDocument doc;
+  TEST_ASSERT_TRUE(
+      BejDocumentParse(&doc, &arena, &dict, payload, payload_size));
+
+  DecodeInto(&expected, payload, payload_size, false);
+  TEST_ASSERT_TRUE(BejDocumentWriteJson(&doc, &out, false));
+  TEST_ASSERT_EQUAL_STRING(expected.data, out.data);
+
+  DecodeInto(&expected, payload, payload_size, true);
+  OutputStreamInit(&out);
+  TEST_ASSERT_TRUE(BejDocumentWriteJson(&doc, &out, true));
+  TEST_ASSERT_EQUAL_STRING(expected.data, out.data);
+}
+
+void test_document_bej_round_trip_is_identical(void) {
+  BejDocument doc;
+  TEST_ASSERT_TRUE(
+      BejDocumentParse(&doc, &arena, &dict, payload, payload_size));
+  TEST_ASSERT_TRUE(BejDocumentWriteBej(&doc, &out));
+  TEST_ASSERT_EQUAL_size_t(payload_size, out.pos);
+  TEST_ASSERT_EQUAL_MEMORY(payload, out.data, payload_size);
+}
+
+void test_document_navigation(void) {
+  BejDocument doc;
+  TEST_ASSERT_TRUE(
+      BejDocumentParse(&doc, &arena, &dict, payload, payload_size));
+  TEST_ASSERT_EQUAL_INT(BEJ_NODE_OBJECT, doc.nodes[0].type);
+  TEST_ASSERT_EQUAL_UINT32(8, doc.nodes[0].count);
+  TEST_ASSERT_EQUAL_UINT32(doc.node_count, doc.nodes[0].end);
+
+  uint32_t speeds = BejDocumentFind(&doc, 0, "AllowedSpeedsMHz");
+  TEST_ASSERT_NOT_EQUAL(BEJ_NODE_NONE, speeds);
+  TEST_ASSERT_EQUAL_INT(BEJ_NODE_ARRAY, doc.nodes[speeds].type);
+  TEST_ASSERT_EQUAL_UINT32(speeds + 3, doc.nodes[speeds].end);
+
+  uint32_t index = BejDocumentFindPath(&doc, "AllowedSpeedsMHz.1");
+  TEST_ASSERT_EQUAL_INT64(3200, doc.nodes[index].value.integer);
+  TEST_ASSERT_EQUAL_STRING("", BejNodeName(&doc.nodes[index]));
+
+  index = BejDocumentFindPath(&doc, "MemoryLocation.Slot");
+  TEST_ASSERT_EQUAL_INT(BEJ_NODE_INTEGER, doc.nodes[index].type);
+  TEST_ASSERT_EQUAL_STRING("Slot", BejNodeName(&doc.nodes[index]));
+
+  index = BejDocumentFindPath(&doc, "ErrorCorrection");
+  TEST_ASSERT_EQUAL_INT(BEJ_NODE_ENUM, doc.nodes[index].type);
+  TEST_ASSERT_EQUAL_STRING_LEN("NoECC", doc.nodes[index].value.string.data,
+                               doc.nodes[index].value.string.size);
+
+  index = BejDocumentFindPath(&doc, "Manufacturer");
+  TEST_ASSERT_EQUAL_size_t(4, doc.nodes[index].value.string.size);
+  TEST_ASSERT_TRUE(doc.nodes[index].value.string.data >= (char *)payload &&
+                   doc.nodes[index].value.string.data <
+                       (char *)payload + payload_size);
+
+  TEST_ASSERT_EQUAL_UINT32(BEJ_NODE_NONE,
+                           BejDocumentFindPath(&doc, "MemoryLocation.Nope"));
+  TEST_ASSERT_EQUAL_UINT32(BEJ_NODE_NONE,
+                           BejDocumentFindPath(&doc, "AllowedSpeedsMHz.2"));
+}
+
+void test_document_modify_and_reserialize(void) {
+  BejDocument doc;
+  TEST_ASSERT_TRUE(
+      BejDocumentParse(&doc, &arena, &dict, payload, payload_size));
+
+  TEST_ASSERT_TRUE(BejDocumentSetInteger(
+      &doc, BejDocumentFindPath(&doc, "CapacityMiB"), 131072));
+  TEST_ASSERT_TRUE(BejDocumentSetInteger(
+      &doc, BejDocumentFindPath(&doc, "MemoryLocation.Slot"), -129));
+  TEST_ASSERT_TRUE(BejDocumentSetString(
+      &doc, BejDocumentFindPath(&doc, "Manufacturer"), "Another vendor"));
+  TEST_ASSERT_TRUE(BejDocumentSetEnum(
+      &doc, BejDocumentFindPath(&doc, "ErrorCorrection"), "MultiBitECC"));
+  TEST_ASSERT_TRUE(BejDocumentSetBoolean(
+      &doc, BejDocumentFindPath(&doc, "IsRankSpareEnabled"), false));
+  TEST_ASSERT_TRUE(BejDocumentRemove(
+      &doc, BejDocumentFindPath(&doc, "AllowedSpeedsMHz.0")));
+  TEST_ASSERT_TRUE(
+      BejDocumentRemove(&doc, BejDocumentFindPath(&doc, "PartNumber")));
+
+  TEST_ASSERT_FALSE(BejDocumentSetEnum(
+      &doc, BejDocumentFindPath(&doc, "ErrorCorrection"), "Bogus"));
+  TEST_ASSERT_FALSE(BejDocumentSetString(
+      &doc, BejDocumentFindPath(&doc, "CapacityMiB"), "wrong type"));
+  TEST_ASSERT_FALSE(BejDocumentRemove(&doc, 0));
+
+  const char *edited =
+      "{\"CapacityMiB\":131072,\"DataWidthBits\":64,"
+      "\"AllowedSpeedsMHz\":[3200],\"ErrorCorrection\":\"MultiBitECC\","
+      "\"MemoryLocation\":{\"Channel\":0,\"Slot\":-129},"
+      "\"IsRankSpareEnabled\":false,\"Manufacturer\":\"Another vendor\"}";
+  TEST_ASSERT_TRUE(BejDocumentWriteJson(&doc, &out, true));
+  TEST_ASSERT_EQUAL_STRING(edited, out.data);
+
+  static OutputStream bej;
+  OutputStreamInit(&bej);
+  TEST_ASSERT_TRUE(BejDocumentWriteBej(&doc, &bej));
+  DecodeInto(&expected, (const uint8_t *)bej.data, bej.pos, true);
+  TEST_ASSERT_EQUAL_STRING(edited, expected.data);
+}
+
+void test_document_arena_reset_reuses_memory(void) {
+  BejDocument doc;
+  TEST_ASSERT_TRUE(
+      BejDocumentParse(&doc, &arena, &dict, payload, payload_size));
+  size_t reserved = ArenaReserved(&arena);
+  TEST_ASSERT_TRUE(reserved > 0);
+  BejNode *first_tape = doc.nodes;
+
+  for (int i = 0; i < 100; ++i) {
+    ArenaReset(&arena);
+    TEST_ASSERT_TRUE(
+        BejDocumentParse(&doc, &arena, &dict, payload, payload_size));
+  }
+  TEST_ASSERT_EQUAL_size_t(reserved, ArenaReserved(&arena));
+  TEST_ASSERT_TRUE(first_tape == doc.nodes);
+}
+
+void test_document_rejects_truncated_payload(void) {
+  BejDocument doc;
+  TEST_ASSERT_FALSE(
+      BejDocumentParse(&doc, &arena, &dict, payload, payload_size - 3));
+}
+
+void test_arena_grows_in_place_and_across_blocks(void) {
+  uint8_t *a = ArenaAlloc(&arena, 100);
+  TEST_ASSERT_NOT_NULL(a);
+  memset(a, 0xAB, 100);
+  TEST_ASSERT_TRUE(ArenaGrow(&arena, a, 100, 400) == a);
+
+  uint8_t *b = ArenaGrow(&arena, a, 400, 4000);
+  TEST_ASSERT_NOT_NULL(b);
+  TEST_ASSERT_TRUE(b != a);
+  for (int i = 0; i < 100; ++i) TEST_ASSERT_EQUAL_UINT8(0xAB, b[i]);
+  TEST_ASSERT_EQUAL_UINT64(0, (uintptr_t)ArenaAlloc(&arena, 3) % 8);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_document_json_matches_decoder);
+  RUN_TEST(test_document_bej_round_trip_is_identical);
+  RUN_TEST(test_document_navigation);
+  RUN_TEST(test_document_modify_and_reserialize);
+  RUN_TEST(test_document_arena_reset_reuses_memory);
+  RUN_TEST(test_document_rejects_truncated_payload);
+  RUN_TEST(test_arena_grows_in_place_and_across_blocks);
+  return UNITY_END();
+}
@@ -0,0 +1,265 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_types.h"
+#include "dictionary.h"
+#include "export.h"
+#include "stream_utils.h"
+#include "unity.h"
+
+static InputStream memory_dict, message_dict;
+static InputStream memory_payload, message_payload;
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+static void LoadStream(const char *path, InputStream *stream) {
+  size_t size;
+  uint8_t *data = ReadFile(path, &size);
+  *stream = (InputStream){data, size, 0};
+}
+
+static size_t ReadAll(FILE *f, uint8_t *buf, size_t size) {
+  rewind(f);
+  size_t n = fread(buf, 1, size - 1, f);
+  buf[n] = '\0';
+  return n;
+}
+
+static uint64_t GetInt(const uint8_t *p, size_t size) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; ++i) value |= (uint64_t)p[i] << (i * 8);
+  return value;
+}
+
+void setUp(void) {
+  LoadStream("dummy_dictionaries/Memory_v1.bin", &memory_dict);
+  LoadStream("dummy_dictionaries/Message_v1.bin", &message_dict);
+  LoadStream("dummy_data/memory_bej.bin", &memory_payload);
+  LoadStream("dummy_data/message_bej.bin", &message_payload);
+}
+
+void tearDown(void) {
+  free((void *)memory_dict.data);
+  free((void *)message_dict.data);
+  free((void *)memory_payload.data);
+  free((void *)message_payload.data);
+}
+
+void test_export_csv_has_one_column_per_leaf(void) {
+  FILE *out = tmpfile();
+  BejExporter exporter;
+  TEST_ASSERT_TRUE(BejExporterOpen(&exporter, message_dict.data,
+                                   message_dict.size, BEJ_EXPORT_CSV, out));
+  TEST_ASSERT_TRUE(BejExporterAdd(&exporter, message_payload.data,
+                                  message_payload.size));
+  TEST_ASSERT_FALSE(BejExporterAdd(&exporter, message_payload.data, 5));
+  TEST_ASSERT_EQUAL_size_t(2, exporter.rows);
+  TEST_ASSERT_EQUAL_size_t(1, exporter.failed);
+  TEST_ASSERT_TRUE(BejExporterClose(&exporter));
+
+  static uint8_t buf[4096];
+  ReadAll(out, buf, sizeof(buf));
+  fclose(out);
+  TEST_ASSERT_EQUAL_STRING(
+      "Message,MessageArgs,MessageId,RelatedProperties,Resolution,Severity,"
+      "MessageSeverity\n"
+      "The value for the property MemorySize is not valid.,MemorySize;4096,"
+      "Base.1.8.PropertyValueError,"
+      "/Systems/1/Memory/1/CapacityMiB;/Systems/1/Memory/1/SpeedMHz,"
+      "Correct the property value and retry the operation.,Warning,\n"
+      ",,,,,,\n",
+      (const char *)buf);
+}
+
+/**
+ * @brief Finds a column in a binary export and returns its index and the
+ * offset just past the header.
+ */
+static size_t FindColumn(const uint8_t *buf, const char *name,
+                         uint8_t *type, size_t *header_end) {
+  size_t columns = GetInt(buf + 6, 4);
+  size_t found = columns;
+  size_t pos = 10;
+  for (size_t c = 0; c < columns; ++c) {
+    uint8_t column_type = buf[pos];
+    size_t len = GetInt(buf + pos + 2, 2);
+    if (len == strlen(name) && memcmp(buf + pos + 4, name, len) == 0) {
+      found = c;
+      *type = column_type;
+    }
+    pos += 4 + len;
+    if (column_type == BEJ_COLUMN_ENUM) {
+      size_t values = GetInt(buf + pos, 4);
+      pos += 4;
+      for (size_t v = 0; v < values; ++v) pos += 6 + GetInt(buf + pos + 4, 2);
+    }
+  }
+  *header_end = pos;
+  return found;
+}
+
+/**
+ * @brief Returns the data of column `index` in the chunk starting at `pos`.
+ */
+static const uint8_t *ColumnData(const uint8_t *buf, size_t pos,
+                                 size_t index) {
+  pos += 4;
+  for (size_t c = 0; c < index; ++c) pos += 4 + GetInt(buf + pos, 4);
+  return buf + pos + 4;
+}
+
+void test_export_rejects_oversized_member_counts(void) {
+  // The root SET, then the AllowedSpeedsMHz ARRAY, declare 2^63 - 1
+  // members but hold none.
+  static const uint8_t kSet[] = {
+      0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01,
+      0x09, 0x08, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F};
+  static const uint8_t kArray[] = {
+      0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00,
+      0x01, 0x10, 0x01, 0x01, 0x01, 0x02, 0x10, 0x01, 0x09, 0x08,
+      0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F};
+  FILE *out = tmpfile();
+  BejExporter exporter;
+  TEST_ASSERT_TRUE(BejExporterOpen(&exporter, memory_dict.data,
+                                   memory_dict.size, BEJ_EXPORT_CSV, out));
+  TEST_ASSERT_FALSE(BejExporterAdd(&exporter, kSet, sizeof(kSet)));
+  TEST_ASSERT_FALSE(BejExporterAdd(&exporter, kArray, sizeof(kArray)));
+  TEST_ASSERT_EQUAL_size_t(2, exporter.failed);
+  TEST_ASSERT_TRUE(BejExporterClose(&exporter));
+  fclose(out);
+}
+
+void test_export_binary_stores_typed_columns(void) {
+  FILE *out = tmpfile();
+  BejExporter exporter;
+  TEST_ASSERT_TRUE(BejExporterOpen(&exporter, memory_dict.data,
+                                   memory_dict.size, BEJ_EXPORT_BINARY, out));
+  TEST_ASSERT_TRUE(BejExporterAdd(&exporter, memory_payload.data,
+                                  memory_payload.size));
+  TEST_ASSERT_TRUE(BejExporterAdd(&exporter, memory_payload.data,
+                                  memory_payload.size));
+  TEST_ASSERT_TRUE(BejExporterClose(&exporter));
+
+  static uint8_t buf[64 * 1024];
+  size_t size = ReadAll(out, buf, sizeof(buf));
+  fclose(out);
+  TEST_ASSERT_EQUAL_MEMORY("BEJC", buf, 4);
+  TEST_ASSERT_EQUAL_UINT64(BEJ_EXPORT_VERSION, GetInt(buf + 4, 2));
+
+  uint8_t type = 0;
+  size_t chunk;
+  size_t capacity = FindColumn(buf, "CapacityMiB", &type, &chunk);
+  TEST_ASSERT_EQUAL_UINT8(BEJ_COLUMN_INT64, type);
+  TEST_ASSERT_EQUAL_UINT64(2, GetInt(buf + chunk, 4));
+  const uint8_t *data = ColumnData(buf, chunk, capacity);
+  TEST_ASSERT_EQUAL_UINT8(1, data[0]);
+  TEST_ASSERT_EQUAL_UINT8(1, data[1]);
+  TEST_ASSERT_EQUAL_UINT64(65536, GetInt(data + 2, 8));
+  TEST_ASSERT_EQUAL_UINT64(65536, GetInt(data + 10, 8));
+
+  size_t ecc = FindColumn(buf, "ErrorCorrection", &type, &chunk);
+  TEST_ASSERT_EQUAL_UINT8(BEJ_COLUMN_ENUM, type);
+  data = ColumnData(buf, chunk, ecc);
+  TEST_ASSERT_EQUAL_UINT8(1, data[0]);
+
+  size_t part = FindColumn(buf, "PartNumber", &type, &chunk);
+  TEST_ASSERT_EQUAL_UINT8(BEJ_COLUMN_STRING, type);
+  data = ColumnData(buf, chunk, part);
+  TEST_ASSERT_EQUAL_UINT8(0, data[0]);
+
+  size_t columns = GetInt(buf + 6, 4);
+  const uint8_t *end = ColumnData(buf, chunk, columns) - 4;
+  TEST_ASSERT_EQUAL_size_t(size - 4, (size_t)(end - buf));
+  TEST_ASSERT_EQUAL_UINT64(0, GetInt(end, 4));
+}
+
+static void PutInt(uint8_t *buf, size_t *pos, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; ++i) buf[(*pos)++] = (uint8_t)(value >> (i * 8));
+}
+
+void test_export_binary_keeps_large_enum_sequence_numbers(void) {
+  // Wide dictionary: Root {Big: enum with the single value Huge = 70000}.
+  static const struct {
+    uint8_t format;
+    uint32_t seq, offset, count;
+    const char *name;
+  } kEntries[] = {
+      {BEJ_FORMAT_SET, 0, DICTIONARY_HEADER_SIZE + DICTIONARY_WIDE_ENTRY_SIZE,
+       1, "Root"},
+      {BEJ_FORMAT_ENUM, 0,
+       DICTIONARY_HEADER_SIZE + 2 * DICTIONARY_WIDE_ENTRY_SIZE, 1, "Big"},
+      {0, 70000, 0, 0, "Huge"},
+  };
+  uint8_t dict[128];
+  size_t pos = 0, name_pos = DICTIONARY_HEADER_SIZE +
+                             3 * DICTIONARY_WIDE_ENTRY_SIZE;
+  PutInt(dict, &pos, 0, 1);
+  PutInt(dict, &pos, DICTIONARY_FLAG_WIDE, 1);
+  PutInt(dict, &pos, 3, 2);
+  PutInt(dict, &pos, 0, 8);
+  for (size_t i = 0; i < 3; ++i) {
+    size_t len = strlen(kEntries[i].name) + 1;
+    PutInt(dict, &pos, (uint64_t)kEntries[i].format << 4, 1);
+    PutInt(dict, &pos, kEntries[i].seq, 4);
+    PutInt(dict, &pos, kEntries[i].offset, 4);
+    PutInt(dict, &pos, kEntries[i].count, 4);
+    PutInt(dict, &pos, len, 1);
+    PutInt(dict, &pos, name_pos, 4);
+    memcpy(dict + name_pos, kEntries[i].name, len);
+    name_pos += len;
+  }
+
+  // {"Big": "Huge"}
+  const uint8_t payload[] = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00,
+                             0x01, 0x00, 0x00, 0x01, 0x0B, 0x01, 0x01,
+                             0x01, 0x00, 0x40, 0x01, 0x04, 0x03, 0x70,
+                             0x11, 0x01};
+  FILE *out = tmpfile();
+  BejExporter exporter;
+  TEST_ASSERT_TRUE(
+      BejExporterOpen(&exporter, dict, name_pos, BEJ_EXPORT_BINARY, out));
+  TEST_ASSERT_TRUE(BejExporterAdd(&exporter, payload, sizeof(payload)));
+  TEST_ASSERT_TRUE(BejExporterClose(&exporter));
+
+  static uint8_t buf[1024];
+  ReadAll(out, buf, sizeof(buf));
+  fclose(out);
+
+  uint8_t type = 0;
+  size_t chunk;
+  size_t big = FindColumn(buf, "Big", &type, &chunk);
+  TEST_ASSERT_EQUAL_UINT8(BEJ_COLUMN_ENUM, type);
+  // The value list follows the column name: count, then seq and name.
+  TEST_ASSERT_EQUAL_UINT64(1, GetInt(buf + 10 + 4 + 3, 4));
+  TEST_ASSERT_EQUAL_UINT64(70000, GetInt(buf + 10 + 4 + 3 + 4, 4));
+  const uint8_t *data = ColumnData(buf, chunk, big);
+  TEST_ASSERT_EQUAL_UINT8(1, data[0]);
+  TEST_ASSERT_EQUAL_UINT64(70000, GetInt(data + 1, 4));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_export_csv_has_one_column_per_leaf);
+  RUN_TEST(test_export_rejects_oversized_member_counts);
+  RUN_TEST(test_export_binary_stores_typed_columns);
+  RUN_TEST(test_export_binary_keeps_large_enum_sequence_numbers);
+  return UNITY_END();
+}
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "unity.h"
+
+static uint8_t *payload;
+static size_t payload_size;
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+void setUp(void) {
+  payload = ReadFile("dummy_data/memory_bej.bin", &payload_size);
+}
+
+void tearDown(void) { free(payload); }
+
+#define HEADER 0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00
+
+// Root SET with an integer (seq 0) and a string (seq 1) member.
+static const uint8_t kSet[] = {HEADER, 0x01, 0x00, 0x00, 0x01, 0x0F,
+                               0x01, 0x02, 0x01, 0x00, 0x30, 0x01,
+                               0x01, 0x2A, 0x01, 0x02, 0x50, 0x01,
+                               0x02, 'x',  0x00};
+
+static BejHashValue Hash(const uint8_t *data, size_t size) {
+  BejHashValue hash;
+  TEST_ASSERT_TRUE(BejHash(data, size, &hash));
+  return hash;
+}
+
+void test_hash_ignores_set_member_order(void) {
+  const uint8_t swapped[] = {HEADER, 0x01, 0x00, 0x00, 0x01, 0x0F, 0x01,
+                             0x02,   0x01, 0x02, 0x50, 0x01, 0x02, 'x',
+                             0x00,   0x01, 0x00, 0x30, 0x01, 0x01, 0x2A};
+  BejHashValue a = Hash(kSet, sizeof(kSet));
+  BejHashValue b = Hash(swapped, sizeof(swapped));
+  TEST_ASSERT_TRUE(BejHashEqual(&a, &b));
+}
+
+void test_hash_keeps_array_order(void) {
+  const uint8_t array[] = {HEADER, 0x01, 0x00, 0x10, 0x01, 0x0E, 0x01,
+                           0x02,   0x01, 0x00, 0x30, 0x01, 0x01, 0x01,
+                           0x01,   0x00, 0x30, 0x01, 0x01, 0x02};
+  const uint8_t reversed[] = {HEADER, 0x01, 0x00, 0x10, 0x01, 0x0E, 0x01,
+                              0x02,   0x01, 0x00, 0x30, 0x01, 0x01, 0x02,
+                              0x01,   0x00, 0x30, 0x01, 0x01, 0x01};
+  BejHashValue a = Hash(array, sizeof(array));
+  BejHashValue b = Hash(reversed, sizeof(reversed));
+  TEST_ASSERT_FALSE(BejHashEqual(&a, &b));
+}
+
+void test_hash_ignores_encoding_widths(void) {
+  // Same SET with a two-byte sequence number, a two-byte integer and the
+  // format byte flags set on the string.
+  const uint8_t wide[] = {HEADER, 0x01, 0x00, 0x00, 0x01, 0x11, 0x01, 0x02,
+                          0x02,   0x00, 0x00, 0x30, 0x01, 0x02, 0x2A, 0x00,
+                          0x01,   0x02, 0x52, 0x01, 0x02, 'x',  0x00};
+  BejHashValue a = Hash(kSet, sizeof(kSet));
+  BejHashValue b = Hash(wide, sizeof(wide));
+  TEST_ASSERT_TRUE(BejHashEqual(&a, &b));
+}
+
+void test_hash_changes_with_values_and_sequence_numbers(void) {
+  BejHashValue base = Hash(kSet, sizeof(kSet));
+  uint8_t changed[sizeof(kSet)];
+
+  memcpy(changed, kSet, sizeof(kSet));
+  changed[19] = 0x2B;  // integer value
+  BejHashValue value = Hash(changed, sizeof(changed));
+  TEST_ASSERT_FALSE(BejHashEqual(&base, &value));
+
+  memcpy(changed, kSet, sizeof(kSet));
+  changed[21] = 0x04;  // sequence number of the string
+  BejHashValue seq = Hash(changed, sizeof(changed));
+  TEST_ASSERT_FALSE(BejHashEqual(&base, &seq));
+
+  memcpy(changed, kSet, sizeof(kSet));
+  changed[25] = 'y';  // string contents
+  BejHashValue text = Hash(changed, sizeof(changed));
+  TEST_ASSERT_FALSE(BejHashEqual(&base, &text));
+}
+
+void test_hash_is_stable(void) {
+  BejHashValue hash = Hash(payload, payload_size);
+  char hex[BEJ_HASH_HEX_SIZE];
+  BejHashFormat(&hash, hex);
+  TEST_ASSERT_EQUAL_STRING("1862da6f822973e6b7f82f7939fbb955", hex);
+}
+
+void test_hash_rejects_malformed_payloads(void) {
+  BejHashValue hash;
+  for (size_t size = sizeof(kSet) - 1; size > 7; --size) {
+    TEST_ASSERT_FALSE(BejHash(kSet, size, &hash));
+  }
+  const uint8_t error_payload[] = {0xF1, 0xF0, 0xF0, 0x00, 0, 0, 0};
+  TEST_ASSERT_FALSE(BejHash(error_payload, sizeof(error_payload), &hash));
+}
+
+void test_hash_bytes_depends_on_seed_and_length(void) {
+  uint8_t data[100];
+  for (size_t i = 0; i < sizeof(data); ++i) data[i] = (uint8_t)i;
+  BejHashValue a = BejHashBytes(data, sizeof(data), 1);
+  BejHashValue b = BejHashBytes(data, sizeof(data), 2);
+  BejHashValue c = BejHashBytes(data, sizeof(data) - 1, 1);
+  BejHashValue d = BejHashBytes(data, sizeof(data), 1);
+  TEST_ASSERT_FALSE(BejHashEqual(&a, &b));
+  TEST_ASSERT_FALSE(BejHashEqual(&a, &c));
+  TEST_ASSERT_TRUE(BejHashEqual(&a, &d));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_hash_ignores_set_member_order);
+  RUN_TEST(test_hash_keeps_array_order);
+  RUN_TEST(test_hash_ignores_encoding_widths);
+  RUN_TEST(test_hash_changes_with_values_and_sequence_numbers);
+  RUN_TEST(test_hash_is_stable);
+  RUN_TEST(test_hash_rejects_malformed_payloads);
+  RUN_TEST(test_hash_bytes_depends_on_seed_and_length);
+  return UNITY_END();
+}
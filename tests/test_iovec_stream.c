@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decoder.h"
+#include "iovec_stream.h"
+#include "stream_utils.h"
+#include "unity.h"
+
+static IovecStream gather;
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz + 1);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_iovec_stream_references_long_fragments(void) {
+  static const char kLong[] = "a fragment that is long enough to reference";
+  IovecStreamInit(&gather, -1);
+
+  IovecStreamWrite(&gather, "{", 1);
+  IovecStreamWriteRef(&gather, kLong, sizeof(kLong) - 1);
+  IovecStreamWriteRef(&gather, "}", 1);
+
+  TEST_ASSERT_EQUAL_size_t(3, gather.iov_count);
+  TEST_ASSERT_TRUE(gather.iov[1].iov_base == (void *)kLong);
+  TEST_ASSERT_EQUAL_size_t(sizeof(kLong) + 1, gather.total);
+  TEST_ASSERT_EQUAL_size_t(2, gather.scratch_pos);
+}
+
+void test_iovec_stream_coalesces_copies(void) {
+  IovecStreamInit(&gather, -1);
+
+  IovecStreamWrite(&gather, "ab", 2);
+  IovecStreamWrite(&gather, "cd", 2);
+
+  TEST_ASSERT_EQUAL_size_t(1, gather.iov_count);
+  TEST_ASSERT_EQUAL_size_t(4, gather.iov[0].iov_len);
+  TEST_ASSERT_EQUAL_MEMORY("abcd", gather.iov[0].iov_base, 4);
+}
+
+void test_iovec_stream_overflow_without_fd_is_error(void) {
+  IovecStreamInit(&gather, -1);
+
+  for (int i = 0; i < IOVEC_STREAM_SCRATCH_SIZE; ++i) {
+    IovecStreamWrite(&gather, "x", 1);
+  }
+  TEST_ASSERT_FALSE(gather.error);
+  IovecStreamWrite(&gather, "x", 1);
+  TEST_ASSERT_TRUE(gather.error);
+}
+
+void test_iovec_stream_flushes_full_iov_array(void) {
+  static const char kRef[] = "0123456789abcdef";
+  static char expected[3 * IOVEC_STREAM_MAX_IOV * sizeof(kRef)];
+  size_t expected_len = 0;
+
+  FILE *f = tmpfile();
+  TEST_ASSERT_NOT_NULL(f);
+  IovecStreamInit(&gather, fileno(f));
+  // Alternating copies and references use one iovec each, so the array
+  // fills up several times while copies are pending in the scratch buffer.
+  for (int i = 0; i < 3 * IOVEC_STREAM_MAX_IOV; ++i) {
+    char c = (char)('A' + i % 26);
+    IovecStreamWrite(&gather, &c, 1);
+    IovecStreamWriteRef(&gather, kRef, sizeof(kRef) - 1);
+    expected[expected_len++] = c;
+    memcpy(expected + expected_len, kRef, sizeof(kRef) - 1);
+    expected_len += sizeof(kRef) - 1;
+  }
+  TEST_ASSERT_TRUE(IovecStreamFlush(&gather));
+  TEST_ASSERT_EQUAL_size_t(expected_len, gather.total);
+
+  char *actual = malloc(expected_len);
+  TEST_ASSERT_NOT_NULL(actual);
+  rewind(f);
+  TEST_ASSERT_EQUAL_size_t(expected_len, fread(actual, 1, expected_len, f));
+  fclose(f);
+  TEST_ASSERT_EQUAL_MEMORY(expected, actual, expected_len);
+  free(actual);
+}
+
+void test_decode_gather_matches_decode(void) {
+  size_t dict_sz, bej_sz;
+  uint8_t *dict_buf = ReadFile("dummy_dictionaries/Memory_v1.bin", &dict_sz);
+  uint8_t *bej_buf = ReadFile("dummy_data/memory_bej.bin", &bej_sz);
+
+  InputStream dict = {dict_buf, dict_sz, 0};
+  InputStream bej = {bej_buf, bej_sz, 0};
+  static OutputStream expected;
+  OutputStreamInit(&expected);
+  TEST_ASSERT_TRUE(BejDecode(&expected, &bej, &dict));
+
+  FILE *f = tmpfile();
+  TEST_ASSERT_NOT_NULL(f);
+  IovecStreamInit(&gather, fileno(f));
+  dict.pos = 0;
+  bej.pos = 0;
+  TEST_ASSERT_TRUE(BejDecodeGather(&gather, &bej, &dict));
+  TEST_ASSERT_TRUE(IovecStreamFlush(&gather));
+  TEST_ASSERT_EQUAL_size_t(expected.pos, gather.total);
+
+  char *actual = malloc(expected.pos + 1);
+  TEST_ASSERT_NOT_NULL(actual);
+  rewind(f);
+  size_t nread = fread(actual, 1, expected.pos + 1, f);
+  actual[nread] = '\0';
+  fclose(f);
+
+  TEST_ASSERT_EQUAL_STRING(expected.data, actual);
+
+  free(actual);
+  free(dict_buf);
+  free(bej_buf);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_iovec_stream_references_long_fragments);
+  RUN_TEST(test_iovec_stream_coalesces_copies);
+  RUN_TEST(test_iovec_stream_overflow_without_fd_is_error);
+  RUN_TEST(test_iovec_stream_flushes_full_iov_array);
+  RUN_TEST(test_decode_gather_matches_decode);
+  return UNITY_END();
+}
@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipeline.h"
+#include "stream_utils.h"
+#include "unity.h"
+
+static const char kMemoryLine[] =
+    "{\"CapacityMiB\":65536,\"DataWidthBits\":64,"
+    "\"AllowedSpeedsMHz\":[2400,3200],\"ErrorCorrection\":\"NoECC\","
+    "\"MemoryLocation\":{\"Channel\":0,\"Slot\":0},"
+    "\"IsRankSpareEnabled\":true,\"PartNumber\":null,"
+    "\"Manufacturer\":\"Some\"}\n";
+
+static InputStream dicts[2];
+static InputStream memory_payload, message_payload;
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+static void LoadStream(const char *path, InputStream *stream) {
+  size_t size;
+  uint8_t *data = ReadFile(path, &size);
+  *stream = (InputStream){data, size, 0};
+}
+
+static void WriteFrame(FILE *f, const InputStream *payload, int dict_id) {
+  uint8_t header[6];
+  uint32_t length = (uint32_t)payload->size;
+  for (int i = 0; i < 4; ++i) header[i] = (uint8_t)(length >> (i * 8));
+  header[4] = (uint8_t)dict_id;
+  header[5] = (uint8_t)(dict_id >> 8);
+  fwrite(header, 1, dict_id < 0 ? 4 : 6, f);
+  fwrite(payload->data, 1, payload->size, f);
+}
+
+static char *ReadAll(FILE *f) {
+  static char buf[8192];
+  rewind(f);
+  size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+  buf[n] = '\0';
+  return buf;
+}
+
+void setUp(void) {
+  LoadStream("dummy_dictionaries/Memory_v1.bin", &dicts[0]);
+  LoadStream("dummy_dictionaries/Message_v1.bin", &dicts[1]);
+  LoadStream("dummy_data/memory_bej.bin", &memory_payload);
+  LoadStream("dummy_data/message_bej.bin", &message_payload);
+}
+
+void tearDown(void) {
+  free((void *)dicts[0].data);
+  free((void *)dicts[1].data);
+  free((void *)memory_payload.data);
+  free((void *)message_payload.data);
+}
+
+void test_pipeline_untagged_records(void) {
+  FILE *in = tmpfile();
+  FILE *out = tmpfile();
+  WriteFrame(in, &memory_payload, -1);
+  WriteFrame(in, &memory_payload, -1);
+  rewind(in);
+
+  PipelineOptions options = {false, false, 0};
+  PipelineStats stats;
+  TEST_ASSERT_TRUE(PipelineRun(in, out, dicts, 1, &options, &stats));
+  TEST_ASSERT_EQUAL_size_t(2, stats.records);
+  TEST_ASSERT_EQUAL_size_t(0, stats.failed);
+
+  char expected[2 * sizeof(kMemoryLine)];
+  strcpy(expected, kMemoryLine);
+  strcat(expected, kMemoryLine);
+  TEST_ASSERT_EQUAL_STRING(expected, ReadAll(out));
+
+  fclose(in);
+  fclose(out);
+}
+
+void test_pipeline_tagged_records_keep_alignment(void) {
+  FILE *in = tmpfile();
+  FILE *out = tmpfile();
+  WriteFrame(in, &message_payload, 1);
+  WriteFrame(in, &memory_payload, 7);
+  WriteFrame(in, &memory_payload, 0);
+  rewind(in);
+
+  PipelineOptions options = {true, true, 0};
+  PipelineStats stats;
+  TEST_ASSERT_TRUE(PipelineRun(in, out, dicts, 2, &options, &stats));
+  TEST_ASSERT_EQUAL_size_t(3, stats.records);
+  TEST_ASSERT_EQUAL_size_t(1, stats.failed);
+
+  char *result = ReadAll(out);
+  char *second = strchr(result, '\n') + 1;
+  TEST_ASSERT_EQUAL_STRING_LEN("{\"MessageId\":", result, 13);
+  TEST_ASSERT_EQUAL_STRING_LEN("null\n", second, 5);
+  TEST_ASSERT_EQUAL_STRING(kMemoryLine, second + 5);
+
+  fclose(in);
+  fclose(out);
+}
+
+void test_pipeline_truncated_frame_fails(void) {
+  FILE *in = tmpfile();
+  FILE *out = tmpfile();
+  WriteFrame(in, &memory_payload, -1);
+  fwrite("\x10\x00\x00\x00\x01", 1, 5, in);
+  rewind(in);
+
+  PipelineOptions options = {false, false, 0};
+  PipelineStats stats;
+  TEST_ASSERT_FALSE(PipelineRun(in, out, dicts, 1, &options, &stats));
+  TEST_ASSERT_EQUAL_size_t(1, stats.records);
+  TEST_ASSERT_EQUAL_STRING(kMemoryLine, ReadAll(out));
+
+  fclose(in);
+  fclose(out);
+}
+
+void test_pipeline_cache_keeps_output(void) {
+  FILE *in = tmpfile();
+  FILE *out = tmpfile();
+  WriteFrame(in, &memory_payload, 0);
+  WriteFrame(in, &message_payload, 1);
+  WriteFrame(in, &memory_payload, 0);
+  rewind(in);
+
+  PipelineOptions options = {true, false, 1 << 20};
+  PipelineStats stats;
+  TEST_ASSERT_TRUE(PipelineRun(in, out, dicts, 2, &options, &stats));
+  TEST_ASSERT_EQUAL_size_t(3, stats.records);
+  TEST_ASSERT_EQUAL_size_t(0, stats.failed);
+  TEST_ASSERT_EQUAL_UINT64(1, stats.cache.hits);
+
+  char *result = ReadAll(out);
+  char *second = strchr(result, '\n') + 1;
+  char *third = strchr(second, '\n') + 1;
+  TEST_ASSERT_EQUAL_STRING_LEN(kMemoryLine, result, strlen(kMemoryLine));
+  TEST_ASSERT_EQUAL_STRING_LEN("{\"MessageId\":", second, 13);
+  TEST_ASSERT_EQUAL_STRING(kMemoryLine, third);
+
+  fclose(in);
+  fclose(out);
+}
+
+void test_pipeline_escapes_strings(void) {
+  // Manufacturer "Some" becomes S, a quote, a newline and a backslash,
+  // which must be escaped so the record stays on one line.
+  uint8_t *data = malloc(memory_payload.size);
+  TEST_ASSERT_NOT_NULL(data);
+  memcpy(data, memory_payload.data, memory_payload.size);
+  uint8_t *text = NULL;
+  for (size_t i = 0; i + 5 <= memory_payload.size; ++i) {
+    if (memcmp(data + i, "Some", 5) == 0) text = data + i;
+  }
+  TEST_ASSERT_NOT_NULL(text);
+  memcpy(text, "S\"\n\\", 4);
+  InputStream payload = {data, memory_payload.size, 0};
+
+  FILE *in = tmpfile();
+  FILE *out = tmpfile();
+  WriteFrame(in, &payload, -1);
+  rewind(in);
+  PipelineOptions options = {false, false, 0};
+  PipelineStats stats;
+  TEST_ASSERT_TRUE(PipelineRun(in, out, dicts, 1, &options, &stats));
+
+  char *result = ReadAll(out);
+  TEST_ASSERT_NOT_NULL(strstr(result, "\"Manufacturer\":\"S\\\"\\n\\\\\"}"));
+  TEST_ASSERT_TRUE(strchr(result, '\n') == result + strlen(result) - 1);
+  fclose(in);
+  fclose(out);
+  free(data);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_pipeline_untagged_records);
+  RUN_TEST(test_pipeline_tagged_records_keep_alignment);
+  RUN_TEST(test_pipeline_truncated_frame_fails);
+  RUN_TEST(test_pipeline_cache_keeps_output);
+  RUN_TEST(test_pipeline_escapes_strings);
+  return UNITY_END();
+}
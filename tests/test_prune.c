@@ -0,0 +1,225 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_types.h"
+#include "decoder.h"
+#include "dictionary.h"
+#include "prune.h"
+#include "stream_utils.h"
+#include "unity.h"
+
+static uint8_t *dict_data;
+static size_t dict_size;
+static uint8_t *payload;
+static size_t payload_size;
+static BejPruner pruner;
+static OutputStream expected;
+static OutputStream actual;
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+void setUp(void) {
+  dict_data = ReadFile("dummy_dictionaries/Memory_v1.bin", &dict_size);
+  payload = ReadFile("dummy_data/memory_bej.bin", &payload_size);
+  TEST_ASSERT_TRUE(BejPruneInit(&pruner, dict_data, dict_size));
+}
+
+void tearDown(void) {
+  BejPruneRelease(&pruner);
+  free(dict_data);
+  free(payload);
+}
+
+static bool Decode(OutputStream *out, const uint8_t *dict, size_t size,
+                   const uint8_t *data, size_t data_size) {
+  InputStream payload_is = {data, data_size, 0};
+  InputStream dict_is = {dict, size, 0};
+  OutputStreamInit(out);
+  return BejDecode(out, &payload_is, &dict_is);
+}
+
+/**
+ * @brief Returns the root's member called `name` in a compiled dictionary.
+ */
+static const DictionaryEntry *FindMember(const CompiledDictionary *dict,
+                                         const char *name) {
+  const DictionaryEntry *root, *members;
+  size_t count;
+  TEST_ASSERT_TRUE(DictionaryFindSubset(dict, 0, 1, &root, &count));
+  TEST_ASSERT_TRUE(DictionaryFindSubset(dict, root->offset, root->child_count,
+                                        &members, &count));
+  for (size_t i = 0; i < count; ++i) {
+    if (strcmp(members[i].name, name) == 0) return &members[i];
+  }
+  return NULL;
+}
+
+void test_prune_keeps_decoding_identical(void) {
+  TEST_ASSERT_TRUE(BejPruneAdd(&pruner, payload, payload_size));
+
+  uint8_t *pruned;
+  size_t pruned_size, kept;
+  TEST_ASSERT_TRUE(BejPruneWrite(&pruner, &pruned, &pruned_size, &kept));
+  TEST_ASSERT_TRUE(pruned_size < dict_size);
+  TEST_ASSERT_TRUE(kept < pruner.dictionary.entry_count);
+  TEST_ASSERT_FALSE(DictionaryIsWide(pruned, pruned_size));
+
+  TEST_ASSERT_TRUE(
+      Decode(&expected, dict_data, dict_size, payload, payload_size));
+  TEST_ASSERT_TRUE(Decode(&actual, pruned, pruned_size, payload, payload_size));
+  TEST_ASSERT_EQUAL_STRING(expected.data, actual.data);
+
+  BejDecoder *decoder = BejDecoderCreate(pruned, pruned_size);
+  TEST_ASSERT_NOT_NULL(decoder);
+  const char *json;
+  size_t json_size;
+  TEST_ASSERT_TRUE(
+      BejDecoderDecode(decoder, payload, payload_size, &json, &json_size));
+  TEST_ASSERT_EQUAL_STRING(expected.data, json);
+  BejDecoderDestroy(decoder);
+  free(pruned);
+}
+
+void test_prune_drops_unused_enum_values(void) {
+  TEST_ASSERT_TRUE(BejPruneAdd(&pruner, payload, payload_size));
+  uint8_t *pruned;
+  size_t pruned_size;
+  TEST_ASSERT_TRUE(BejPruneWrite(&pruner, &pruned, &pruned_size, NULL));
+
+  CompiledDictionary dict;
+  TEST_ASSERT_TRUE(DictionaryCompile(&dict, pruned, pruned_size));
+  const DictionaryEntry *original =
+      FindMember(&pruner.dictionary, "ErrorCorrection");
+  const DictionaryEntry *kept = FindMember(&dict, "ErrorCorrection");
+  TEST_ASSERT_NOT_NULL(original);
+  TEST_ASSERT_NOT_NULL(kept);
+  TEST_ASSERT_TRUE(original->child_count > 1);
+  TEST_ASSERT_EQUAL_UINT32(1, kept->child_count);
+  TEST_ASSERT_EQUAL_UINT32(original->sequence_number, kept->sequence_number);
+
+  const DictionaryEntry *values;
+  size_t count;
+  TEST_ASSERT_TRUE(DictionaryFindSubset(&dict, kept->offset, kept->child_count,
+                                        &values, &count));
+  TEST_ASSERT_EQUAL_STRING("NoECC", values[0].name);
+  DictionaryRelease(&dict);
+  free(pruned);
+}
+
+void test_prune_without_payloads_keeps_only_the_root(void) {
+  uint8_t *pruned;
+  size_t pruned_size, kept;
+  TEST_ASSERT_TRUE(BejPruneWrite(&pruner, &pruned, &pruned_size, &kept));
+  TEST_ASSERT_EQUAL_size_t(1, kept);
+
+  CompiledDictionary dict;
+  TEST_ASSERT_TRUE(DictionaryCompile(&dict, pruned, pruned_size));
+  TEST_ASSERT_EQUAL_size_t(1, dict.entry_count);
+  TEST_ASSERT_EQUAL_STRING(pruner.dictionary.entries[0].name,
+                           dict.entries[0].name);
+  DictionaryRelease(&dict);
+
+  // The payload uses properties that are gone now.
+  TEST_ASSERT_FALSE(
+      Decode(&actual, pruned, pruned_size, payload, payload_size));
+  free(pruned);
+}
+
+static void PutLE(uint8_t *buf, size_t *pos, uint64_t value, size_t size) {
+  for (size_t i = 0; i < size; ++i) buf[(*pos)++] = (uint8_t)(value >> (8 * i));
+}
+
+void test_prune_keeps_wide_layout_for_large_sequence_numbers(void) {
+  // Wide dictionary: Root {Small (seq 0), Large (seq 70000)}.
+  static const struct {
+    uint8_t format;
+    uint32_t seq, offset, count;
+    const char *name;
+  } kEntries[] = {
+      {BEJ_FORMAT_SET, 0, DICTIONARY_HEADER_SIZE + DICTIONARY_WIDE_ENTRY_SIZE,
+       2, "Root"},
+      {BEJ_FORMAT_INTEGER, 0, 0, 0, "Small"},
+      {BEJ_FORMAT_INTEGER, 70000, 0, 0, "Large"},
+  };
+  uint8_t wide[128];
+  size_t pos = 0, name_pos = DICTIONARY_HEADER_SIZE +
+                             3 * DICTIONARY_WIDE_ENTRY_SIZE;
+  PutLE(wide, &pos, 0, 1);
+  PutLE(wide, &pos, DICTIONARY_FLAG_WIDE, 1);
+  PutLE(wide, &pos, 3, 2);
+  PutLE(wide, &pos, 0, 8);
+  for (size_t i = 0; i < 3; ++i) {
+    size_t len = strlen(kEntries[i].name) + 1;
+    PutLE(wide, &pos, (uint64_t)kEntries[i].format << 4, 1);
+    PutLE(wide, &pos, kEntries[i].seq, 4);
+    PutLE(wide, &pos, kEntries[i].offset, 4);
+    PutLE(wide, &pos, kEntries[i].count, 4);
+    PutLE(wide, &pos, len, 1);
+    PutLE(wide, &pos, name_pos, 4);
+    memcpy(wide + name_pos, kEntries[i].name, len);
+    name_pos += len;
+  }
+
+  // {"Large": 42}
+  const uint8_t large[] = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00,
+                           0x01, 0x00, 0x00, 0x01, 0x0A, 0x01, 0x01,
+                           0x03, 0xE0, 0x22, 0x02, 0x30, 0x01, 0x01, 0x2A};
+  BejPruner wide_pruner;
+  TEST_ASSERT_TRUE(BejPruneInit(&wide_pruner, wide, name_pos));
+  TEST_ASSERT_TRUE(BejPruneAdd(&wide_pruner, large, sizeof(large)));
+
+  uint8_t *pruned;
+  size_t pruned_size, kept;
+  TEST_ASSERT_TRUE(
+      BejPruneWrite(&wide_pruner, &pruned, &pruned_size, &kept));
+  TEST_ASSERT_EQUAL_size_t(2, kept);
+  TEST_ASSERT_TRUE(DictionaryIsWide(pruned, pruned_size));
+  TEST_ASSERT_TRUE(Decode(&actual, pruned, pruned_size, large, sizeof(large)));
+  TEST_ASSERT_NOT_NULL(strstr(actual.data, "\"Large\": 42"));
+
+  BejPruneRelease(&wide_pruner);
+  free(pruned);
+}
+
+void test_prune_counts_undecodable_payloads(void) {
+  const uint8_t error_payload[] = {0xF1, 0xF0, 0xF0, 0x00, 0, 0, 0};
+  TEST_ASSERT_FALSE(
+      BejPruneAdd(&pruner, error_payload, sizeof(error_payload)));
+  // The root SET declares 2^63 - 1 members but holds none.
+  const uint8_t oversized_payload[] = {
+      0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01,
+      0x09, 0x08, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F};
+  TEST_ASSERT_FALSE(
+      BejPruneAdd(&pruner, oversized_payload, sizeof(oversized_payload)));
+  TEST_ASSERT_TRUE(BejPruneAdd(&pruner, payload, payload_size));
+  TEST_ASSERT_EQUAL_size_t(3, pruner.payloads);
+  TEST_ASSERT_EQUAL_size_t(2, pruner.failed);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_prune_keeps_decoding_identical);
+  RUN_TEST(test_prune_drops_unused_enum_values);
+  RUN_TEST(test_prune_without_payloads_keeps_only_the_root);
+  RUN_TEST(test_prune_keeps_wide_layout_for_large_sequence_numbers);
+  RUN_TEST(test_prune_counts_undecodable_payloads);
+  return UNITY_END();
+}
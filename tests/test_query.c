@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "query.h"
+#include "stream_utils.h"
+#include "unity.h"
+
+static InputStream memory_dict;
+static InputStream memory_payload;
+static BejQuery query;
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+static void LoadStream(const char *path, InputStream *stream) {
+  size_t size;
+  uint8_t *data = ReadFile(path, &size);
+  *stream = (InputStream){data, size, 0};
+}
+
+static bool Compile(const char *expression) {
+  return BejQueryCompile(&query, memory_dict.data, memory_dict.size,
+                         expression);
+}
+
+static bool Matches(const char *expression) {
+  TEST_ASSERT_TRUE_MESSAGE(Compile(expression), expression);
+  BejQueryResult result;
+  bool matched = false;
+  TEST_ASSERT_TRUE(BejQueryMatch(&query, memory_payload.data,
+                                 memory_payload.size, &result, &matched));
+  BejQueryRelease(&query);
+  return matched;
+}
+
+void setUp(void) {
+  LoadStream("dummy_dictionaries/Memory_v1.bin", &memory_dict);
+  LoadStream("dummy_data/memory_bej.bin", &memory_payload);
+}
+
+void tearDown(void) {
+  free((void *)memory_dict.data);
+  free((void *)memory_payload.data);
+}
+
+void test_query_compares_integers(void) {
+  TEST_ASSERT_TRUE(Matches("CapacityMiB == 65536"));
+  TEST_ASSERT_TRUE(Matches("CapacityMiB >= 32768"));
+  TEST_ASSERT_FALSE(Matches("CapacityMiB < 32768"));
+  TEST_ASSERT_TRUE(Matches("DataWidthBits != 72"));
+}
+
+void test_query_compares_enums_strings_booleans_and_null(void) {
+  TEST_ASSERT_TRUE(Matches("ErrorCorrection == NoECC"));
+  TEST_ASSERT_FALSE(Matches("ErrorCorrection != NoECC"));
+  TEST_ASSERT_TRUE(Matches("Manufacturer == \"Some\""));
+  TEST_ASSERT_FALSE(Matches("Manufacturer == 'Som'"));
+  TEST_ASSERT_TRUE(Matches("IsRankSpareEnabled == true"));
+  TEST_ASSERT_TRUE(Matches("PartNumber == null"));
+  TEST_ASSERT_FALSE(Matches("Manufacturer == null"));
+}
+
+void test_query_follows_nested_paths(void) {
+  TEST_ASSERT_TRUE(Matches("MemoryLocation.Slot == 0"));
+  TEST_ASSERT_FALSE(Matches("MemoryLocation.Channel > 0"));
+}
+
+void test_query_combines_terms(void) {
+  TEST_ASSERT_TRUE(Matches("CapacityMiB < 32768 || ErrorCorrection == NoECC"));
+  TEST_ASSERT_FALSE(
+      Matches("CapacityMiB < 32768 && ErrorCorrection == NoECC"));
+  TEST_ASSERT_TRUE(Matches(
+      "CapacityMiB < 32768 || MemoryLocation.Slot == 0 && DataWidthBits == 64"));
+  TEST_ASSERT_FALSE(Matches(
+      "CapacityMiB < 32768 || MemoryLocation.Slot == 1 && DataWidthBits == 64"));
+}
+
+void test_query_rejects_invalid_expressions(void) {
+  TEST_ASSERT_FALSE(Compile("Capacity == 1"));
+  TEST_ASSERT_FALSE(Compile("ErrorCorrection == Parity"));
+  TEST_ASSERT_FALSE(Compile("ErrorCorrection < NoECC"));
+  TEST_ASSERT_FALSE(Compile("CapacityMiB == big"));
+  TEST_ASSERT_FALSE(Compile("AllowedSpeedsMHz == 2400"));
+  TEST_ASSERT_FALSE(Compile("CapacityMiB == 1 &&"));
+  TEST_ASSERT_FALSE(Compile("CapacityMiB = 1"));
+}
+
+void test_query_writes_matched_fields(void) {
+  TEST_ASSERT_TRUE(Compile("CapacityMiB < 32768 || ErrorCorrection == NoECC "
+                           "|| CapacityMiB > 0 && PartNumber == null"));
+  BejQueryResult result;
+  bool matched = false;
+  TEST_ASSERT_TRUE(BejQueryMatch(&query, memory_payload.data,
+                                 memory_payload.size, &result, &matched));
+  TEST_ASSERT_TRUE(matched);
+
+  static OutputStream out;
+  OutputStreamInit(&out);
+  BejQueryWriteMatch(&query, &result, "dimm0", &out);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"id\":\"dimm0\",\"CapacityMiB\":65536,\"ErrorCorrection\":\"NoECC\","
+      "\"PartNumber\":null}\n",
+      out.data);
+
+  // The id is a file path and may hold characters JSON must escape.
+  OutputStreamInit(&out);
+  BejQueryWriteMatch(&query, &result, "dir\\\"dimm\"0", &out);
+  const char *id = "{\"id\":\"dir\\\\\\\"dimm\\\"0\",";
+  TEST_ASSERT_EQUAL_STRING_LEN(id, out.data, strlen(id));
+  BejQueryRelease(&query);
+}
+
+void test_query_rejects_truncated_payloads(void) {
+  TEST_ASSERT_TRUE(Compile("Manufacturer == Some"));
+  BejQueryResult result;
+  bool matched = true;
+  TEST_ASSERT_FALSE(BejQueryMatch(&query, memory_payload.data,
+                                  memory_payload.size - 4, &result, &matched));
+  TEST_ASSERT_FALSE(matched);
+  BejQueryRelease(&query);
+}
+
+void test_query_rejects_oversized_member_counts(void) {
+  // The root SET declares 2^63 - 1 members but holds none.
+  static const uint8_t kPayload[] = {
+      0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01,
+      0x09, 0x08, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F};
+  TEST_ASSERT_TRUE(Compile("Id == 1"));
+  BejQueryResult result;
+  bool matched = true;
+  TEST_ASSERT_FALSE(
+      BejQueryMatch(&query, kPayload, sizeof(kPayload), &result, &matched));
+  TEST_ASSERT_FALSE(matched);
+  BejQueryRelease(&query);
+}
+
+void test_query_runs_files_in_parallel_and_keeps_order(void) {
+  char *paths[] = {"dummy_data/memory_bej.bin", "dummy_data/missing.bin",
+                   "dummy_data/memory_bej.bin"};
+  TEST_ASSERT_TRUE(Compile("MemoryLocation.Channel == 0"));
+
+  FILE *out = tmpfile();
+  BejQueryStats stats;
+  TEST_ASSERT_TRUE(BejQueryRunFiles(&query, paths, 3, 2, out, &stats));
+  TEST_ASSERT_EQUAL_size_t(3, stats.payloads);
+  TEST_ASSERT_EQUAL_size_t(2, stats.matched);
+  TEST_ASSERT_EQUAL_size_t(1, stats.failed);
+
+  char buf[512];
+  rewind(out);
+  size_t n = fread(buf, 1, sizeof(buf) - 1, out);
+  buf[n] = '\0';
+  fclose(out);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"id\":\"dummy_data/memory_bej.bin\",\"MemoryLocation.Channel\":0}\n"
+      "{\"id\":\"dummy_data/memory_bej.bin\",\"MemoryLocation.Channel\":0}\n",
+      buf);
+  BejQueryRelease(&query);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_query_compares_integers);
+  RUN_TEST(test_query_compares_enums_strings_booleans_and_null);
+  RUN_TEST(test_query_follows_nested_paths);
+  RUN_TEST(test_query_combines_terms);
+  RUN_TEST(test_query_rejects_invalid_expressions);
+  RUN_TEST(test_query_writes_matched_fields);
+  RUN_TEST(test_query_rejects_truncated_payloads);
+  RUN_TEST(test_query_rejects_oversized_member_counts);
+  RUN_TEST(test_query_runs_files_in_parallel_and_keeps_order);
+  return UNITY_END();
+}
@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_types.h"
+#include "decoder.h"
+#include "stream_utils.h"
+#include "transcode.h"
+#include "unity.h"
+
+/**
+ * @struct TestEntry
+ * @brief Dictionary entry description; `child` indexes the subset list.
+ */
+typedef struct {
+  uint8_t format;
+  uint16_t seq;
+  const char *name;
+  int child;
+} TestEntry;
+
+typedef struct {
+  const TestEntry *entries;
+  size_t count;
+} TestSubset;
+
+static OutputStream out;
+static OutputStream json;
+
+static uint8_t *ReadFile(const char *path, size_t *out_size) {
+  FILE *f = fopen(path, "rb");
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "Failed to open file");
+
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  rewind(f);
+  TEST_ASSERT_TRUE(sz >= 0);
+
+  uint8_t *buf = (uint8_t *)malloc((size_t)sz);
+  TEST_ASSERT_NOT_NULL_MESSAGE(buf, "malloc failed");
+
+  size_t nread = fread(buf, 1, (size_t)sz, f);
+  fclose(f);
+  TEST_ASSERT_EQUAL_size_t((size_t)sz, nread);
+
+  *out_size = (size_t)sz;
+  return buf;
+}
+
+static void Put16(uint8_t *p, size_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+}
+
+/**
+ * @brief Serializes subsets (subset 0 holds the root entry) into the binary
+ * dictionary format and returns its size.
+ */
+static size_t BuildDictionary(const TestSubset *subsets, size_t subset_count,
+                              uint8_t *buf) {
+  size_t offsets[16];
+  size_t pos = 12;
+  size_t entry_count = 0;
+  for (size_t s = 0; s < subset_count; ++s) {
+    offsets[s] = pos;
+    pos += subsets[s].count * 10;
+    entry_count += subsets[s].count;
+  }
+  size_t names = pos;
+  memset(buf, 0, 12);
+  Put16(buf + 2, entry_count);
+
+  for (size_t s = 0; s < subset_count; ++s) {
+    for (size_t i = 0; i < subsets[s].count; ++i) {
+      const TestEntry *entry = &subsets[s].entries[i];
+      uint8_t *p = buf + offsets[s] + i * 10;
+      size_t name_len = strlen(entry->name) + 1;
+      p[0] = (uint8_t)(entry->format << 4);
+      Put16(p + 1, entry->seq);
+      Put16(p + 3, entry->child >= 0 ? offsets[entry->child] : 0);
+      Put16(p + 5, entry->child >= 0 ? subsets[entry->child].count : 0);
+      p[7] = (uint8_t)name_len;
+      Put16(p + 8, names);
+      memcpy(buf + names, entry->name, name_len);
+      names += name_len;
+    }
+  }
+  return names;
+}
+
+// Version 1: {"A": int, "B": string, "C": Off|On, "D": {"X": int}}
+static const TestEntry kV1Root[] = {{BEJ_FORMAT_SET, 0, "Thing", 1}};
+static const TestEntry kV1Props[] = {{BEJ_FORMAT_INTEGER, 0, "A", -1},
+                                     {BEJ_FORMAT_STRING, 1, "B", -1},
+                                     {BEJ_FORMAT_ENUM, 2, "C", 2},
+                                     {BEJ_FORMAT_SET, 3, "D", 3}};
+static const TestEntry kV1Enum[] = {{BEJ_FORMAT_STRING, 0, "Off", -1},
+                                    {BEJ_FORMAT_STRING, 1, "On", -1}};
+static const TestEntry kV1D[] = {{BEJ_FORMAT_INTEGER, 0, "X", -1}};
+
+// Version 2 drops "A", renumbers everything and adds properties and values.
+static const TestEntry kV2Root[] = {{BEJ_FORMAT_SET, 0, "Thing", 1}};
+static const TestEntry kV2Props[] = {{BEJ_FORMAT_STRING, 0, "B", -1},
+                                     {BEJ_FORMAT_ENUM, 1, "C", 2},
+                                     {BEJ_FORMAT_SET, 2, "D", 3},
+                                     {BEJ_FORMAT_INTEGER, 3, "New", -1}};
+static const TestEntry kV2Enum[] = {{BEJ_FORMAT_STRING, 0, "Unknown", -1},
+                                    {BEJ_FORMAT_STRING, 1, "On", -1},
+                                    {BEJ_FORMAT_STRING, 2, "Off", -1}};
+static const TestEntry kV2D[] = {{BEJ_FORMAT_BOOLEAN, 0, "Y", -1},
+                                 {BEJ_FORMAT_INTEGER, 1, "X", -1}};
+
+// Version 3 is version 2 with the only property of "D" renamed.
+static const TestEntry kV3D[] = {{BEJ_FORMAT_INTEGER, 0, "Z", -1}};
+
+// {"A": 7, "B": "hi", "C": "Off", "D": {"X": 42}} encoded with version 1.
+static const uint8_t kV1Payload[] = {
+    0x00, 0xF0, 0xF1, 0xF0, 0x00, 0x00, 0x00,              // header
+    0x01, 0x00, 0x00, 0x01, 0x24, 0x01, 0x04,              // root SET
+    0x01, 0x00, 0x30, 0x01, 0x01, 0x07,                    // A
+    0x01, 0x02, 0x50, 0x01, 0x03, 'h', 'i', 0x00,          // B
+    0x01, 0x04, 0x40, 0x01, 0x02, 0x01, 0x00,              // C
+    0x01, 0x06, 0x00, 0x01, 0x08, 0x01, 0x01,              // D
+    0x01, 0x00, 0x30, 0x01, 0x01, 0x2A};                   // D.X
+
+static uint8_t v1[512], v2[512];
+static size_t v1_size, v2_size;
+
+void setUp(void) {
+  const TestSubset v1_subsets[] = {
+      {kV1Root, 1}, {kV1Props, 4}, {kV1Enum, 2}, {kV1D, 1}};
+  const TestSubset v2_subsets[] = {
+      {kV2Root, 1}, {kV2Props, 4}, {kV2Enum, 3}, {kV2D, 2}};
+  v1_size = BuildDictionary(v1_subsets, 4, v1);
+  v2_size = BuildDictionary(v2_subsets, 4, v2);
+}
+
+void tearDown(void) {}
+
+static const char *DecodeCompact(const uint8_t *payload, size_t size,
+                                 const uint8_t *dict, size_t dict_size) {
+  InputStream payload_is = {payload, size, 0};
+  InputStream dict_is = {dict, dict_size, 0};
+  OutputStreamInit(&json);
+  TEST_ASSERT_TRUE(BejDecodeCompact(&json, &payload_is, &dict_is));
+  return json.data;
+}
+
+void test_transcode_renumbers_between_versions(void) {
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"A\":7,\"B\":\"hi\",\"C\":\"Off\",\"D\":{\"X\":42}}",
+      DecodeCompact(kV1Payload, sizeof(kV1Payload), v1, v1_size));
+
+  BejTranslation translation;
+  TEST_ASSERT_TRUE(BejTranslationCreate(&translation, v1, v1_size, v2,
+                                        v2_size));
+  TEST_ASSERT_EQUAL_size_t(1, translation.unmapped);
+
+  size_t dropped = 0;
+  TEST_ASSERT_TRUE(BejTranscode(&translation, kV1Payload, sizeof(kV1Payload),
+                                &out, &dropped));
+  TEST_ASSERT_EQUAL_size_t(1, dropped);
+  TEST_ASSERT_EQUAL_size_t(sizeof(kV1Payload) - 6, out.pos);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"B\":\"hi\",\"C\":\"Off\",\"D\":{\"X\":42}}",
+      DecodeCompact((const uint8_t *)out.data, out.pos, v2, v2_size));
+  BejTranslationRelease(&translation);
+}
+
+void test_transcode_does_not_match_renamed_singletons(void) {
+  static uint8_t v3[512];
+  const TestSubset v3_subsets[] = {
+      {kV2Root, 1}, {kV2Props, 4}, {kV2Enum, 3}, {kV3D, 1}};
+  size_t v3_size = BuildDictionary(v3_subsets, 4, v3);
+
+  BejTranslation translation;
+  TEST_ASSERT_TRUE(BejTranslationCreate(&translation, v1, v1_size, v3,
+                                        v3_size));
+  TEST_ASSERT_EQUAL_size_t(2, translation.unmapped);
+
+  size_t dropped = 0;
+  TEST_ASSERT_TRUE(BejTranscode(&translation, kV1Payload, sizeof(kV1Payload),
+                                &out, &dropped));
+  TEST_ASSERT_EQUAL_size_t(2, dropped);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"B\":\"hi\",\"C\":\"Off\",\"D\":{}}",
+      DecodeCompact((const uint8_t *)out.data, out.pos, v3, v3_size));
+  BejTranslationRelease(&translation);
+}
+
+void test_transcode_rejects_truncated_payloads(void) {
+  BejTranslation translation;
+  TEST_ASSERT_TRUE(BejTranslationCreate(&translation, v1, v1_size, v2,
+                                        v2_size));
+  TEST_ASSERT_FALSE(BejTranscode(&translation, kV1Payload,
+                                 sizeof(kV1Payload) - 3, &out, NULL));
+  BejTranslationRelease(&translation);
+}
+
+void test_transcode_rejects_oversized_member_counts(void) {
+  // The root SET declares 2^63 - 1 members but holds none.
+  static const uint8_t kPayload[] = {
+      0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01,
+      0x09, 0x08, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F};
+  BejTranslation translation;
+  TEST_ASSERT_TRUE(BejTranslationCreate(&translation, v1, v1_size, v2,
+                                        v2_size));
+  TEST_ASSERT_FALSE(
+      BejTranscode(&translation, kPayload, sizeof(kPayload), &out, NULL));
+  BejTranslationRelease(&translation);
+}
+
+void test_transcode_same_dictionary_preserves_document(void) {
+  size_t dict_size, payload_size;
+  uint8_t *dict = ReadFile("dummy_dictionaries/Memory_v1.bin", &dict_size);
+  uint8_t *payload = ReadFile("dummy_data/memory_bej.bin", &payload_size);
+
+  BejTranslation translation;
+  TEST_ASSERT_TRUE(BejTranslationCreate(&translation, dict, dict_size, dict,
+                                        dict_size));
+  TEST_ASSERT_EQUAL_size_t(0, translation.unmapped);
+  size_t dropped = 1;
+  TEST_ASSERT_TRUE(
+      BejTranscode(&translation, payload, payload_size, &out, &dropped));
+  TEST_ASSERT_EQUAL_size_t(0, dropped);
+  TEST_ASSERT_EQUAL_size_t(payload_size, out.pos);
+  TEST_ASSERT_EQUAL_MEMORY(payload, out.data, payload_size);
+
+  static char expected[OUTBUF_SIZE];
+  strcpy(expected, DecodeCompact(payload, payload_size, dict, dict_size));
+  TEST_ASSERT_EQUAL_STRING(expected, DecodeCompact((const uint8_t *)out.data,
+                                                   out.pos, dict, dict_size));
+
+  BejTranslationRelease(&translation);
+  free(dict);
+  free(payload);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_transcode_renumbers_between_versions);
+  RUN_TEST(test_transcode_does_not_match_renamed_singletons);
+  RUN_TEST(test_transcode_rejects_truncated_payloads);
+  RUN_TEST(test_transcode_rejects_oversized_member_counts);
+  RUN_TEST(test_transcode_same_dictionary_preserves_document);
+  return UNITY_END();
+}
@@ -0,0 +1,649 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bej_types.h"
+#include "dictionary.h"
+
+/**
+ * @file bej_codegen.c
+ * @brief Generates a C decoder specialized for a single schema dictionary.
+ *
+ * The generated decoder produces byte-identical output to BejDecode() for the
+ * dictionary it was generated from, but replaces the runtime dictionary walk
+ * with per-SET switch tables on the sequence number, pre-rendered
+ * `"Name": ` strings and inlined enum name tables.
+ */
+
+#define CODEGEN_KIND_SET 0
+#define CODEGEN_KIND_ARRAY 1
+#define CODEGEN_KIND_ENUM 2
+
+/**
+ * @struct CodegenItem
+ * @brief A dictionary subset for which a function or table is emitted.
+ */
+typedef struct {
+  uint8_t kind;
+  uint32_t offset;
+  uint32_t count;
+} CodegenItem;
+
+/**
+ * @struct Codegen
+ * @brief State of a single generator run.
+ */
+typedef struct {
+  const uint8_t *dict;
+  size_t dict_size;
+  CodegenItem *items;
+  size_t item_count;
+  size_t item_capacity;
+  FILE *out;
+} Codegen;
+
+/**
+ * @brief Reads a file into a dynamically allocated buffer.
+ *
+ * @param filename The name of the file to read.
+ * @param size Pointer to a variable to store the file size.
+ * @return A pointer to the allocated buffer, or NULL on failure.
+ */
+static uint8_t *ReadFile(const char *filename, size_t *size) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    fprintf(stderr, "Error: cannot open %s\n", filename);
+    return NULL;
+  }
+  if (fseek(f, 0, SEEK_END) != 0) {
+    fclose(f);
+    return NULL;
+  }
+  long sz = ftell(f);
+  if (sz < 0) {
+    fclose(f);
+    return NULL;
+  }
+  rewind(f);
+
+  *size = (size_t)sz;
+  uint8_t *buf = malloc(*size ? *size : 1);
+  if (!buf) {
+    fclose(f);
+    return NULL;
+  }
+  size_t read_bytes = fread(buf, 1, *size, f);
+  fclose(f);
+  if (read_bytes != *size) {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+/**
+ * @brief Registers a subset for emission, deduplicating by kind and offset.
+ *
+ * @return The index of the item, or -1 if out of memory.
+ */
+static long CodegenAddItem(Codegen *gen, uint8_t kind, uint32_t offset,
+                           uint32_t count) {
+  for (size_t i = 0; i < gen->item_count; ++i) {
+    const CodegenItem *item = &gen->items[i];
+    if (item->kind == kind && item->offset == offset && item->count == count) {
+      return (long)i;
+    }
+  }
+  if (gen->item_count == gen->item_capacity) {
+    size_t capacity = gen->item_capacity ? gen->item_capacity * 2 : 64;
+    CodegenItem *items = realloc(gen->items, capacity * sizeof(*items));
+    if (!items) return -1;
+    gen->items = items;
+    gen->item_capacity = capacity;
+  }
+  gen->items[gen->item_count].kind = kind;
+  gen->items[gen->item_count].offset = offset;
+  gen->items[gen->item_count].count = count;
+  return (long)gen->item_count++;
+}
+
+/**
+ * @brief Parses the subset of an item into a newly allocated array.
+ *
+ * @return The entries (free with free()), or NULL on failure.
+ */
+static DictionaryEntry *CodegenLoadItem(const Codegen *gen,
+                                        const CodegenItem *item,
+                                        size_t *count) {
+  DictionaryEntry *entries = malloc((item->count ? item->count : 1) *
+                                    sizeof(*entries));
+  if (!entries) return NULL;
+  if (!LoadDictionarySubsetIntoBuffer(gen->dict, gen->dict_size, item->offset,
+                                      item->count, entries, count)) {
+    free(entries);
+    return NULL;
+  }
+  return entries;
+}
+
+/**
+ * @brief Registers the subsets referenced by a single dictionary entry.
+ */
+static bool CodegenAddEntry(Codegen *gen, const DictionaryEntry *entry) {
+  switch (entry->format) {
+    case BEJ_FORMAT_SET:
+      return CodegenAddItem(gen, CODEGEN_KIND_SET, entry->offset,
+                            entry->child_count) >= 0;
+    case BEJ_FORMAT_ARRAY:
+      return CodegenAddItem(gen, CODEGEN_KIND_ARRAY, entry->offset,
+                            entry->child_count) >= 0;
+    case BEJ_FORMAT_ENUM:
+      return CodegenAddItem(gen, CODEGEN_KIND_ENUM, entry->offset,
+                            entry->child_count) >= 0;
+    default:
+      return true;
+  }
+}
+
+/**
+ * @brief Walks the dictionary breadth-first and collects every subset.
+ */
+static bool CodegenCollect(Codegen *gen, DictionaryEntry *root) {
+  if (!CodegenAddEntry(gen, root)) return false;
+
+  for (size_t i = 0; i < gen->item_count; ++i) {
+    CodegenItem item = gen->items[i];
+    if (item.kind == CODEGEN_KIND_ENUM) continue;
+    size_t entry_count;
+    DictionaryEntry *entries = CodegenLoadItem(gen, &item, &entry_count);
+    if (!entries) return false;
+    bool ok = true;
+    for (size_t j = 0; ok && j < entry_count; ++j) {
+      ok = CodegenAddEntry(gen, &entries[j]);
+    }
+    free(entries);
+    if (!ok) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Writes a C string literal, escaping anything that is not printable.
+ */
+static void CodegenWriteLiteral(FILE *out, const char *prefix,
+                                const char *text, const char *suffix) {
+  fputc('"', out);
+  fputs(prefix, out);
+  for (const unsigned char *p = (const unsigned char *)text; *p; ++p) {
+    if (*p == '"' || *p == '\\') {
+      fprintf(out, "\\%c", *p);
+    } else if (*p < 0x20 || *p > 0x7E) {
+      fprintf(out, "\\%03o", *p);
+    } else {
+      fputc(*p, out);
+    }
+  }
+  fputs(suffix, out);
+  fputc('"', out);
+}
+
+/**
+ * @brief Writes the identifier used for an item's function or table.
+ */
+static void CodegenWriteName(FILE *out, const CodegenItem *item) {
+  static const char *const kPrefixes[] = {"DecodeSet", "DecodeArray",
+                                          "kEnum"};
+  fprintf(out, "%s_%04X_%u", kPrefixes[item->kind], item->offset,
+          item->count);
+}
+
+/**
+ * @brief Emits the statement decoding the value of a tuple described by
+ * `entry`, assigning the result to `ok`.
+ *
+ * @return false if the subset of the entry could not be registered.
+ */
+static bool CodegenEmitValue(Codegen *gen, const DictionaryEntry *entry,
+                             const char *indent, const char *pad) {
+  FILE *out = gen->out;
+  uint8_t kind;
+  const char *format;
+
+  switch (entry->format) {
+    case BEJ_FORMAT_SET:
+      kind = CODEGEN_KIND_SET;
+      format = "BEJ_FORMAT_SET";
+      break;
+    case BEJ_FORMAT_ARRAY:
+      kind = CODEGEN_KIND_ARRAY;
+      format = "BEJ_FORMAT_ARRAY";
+      break;
+    case BEJ_FORMAT_ENUM:
+      kind = CODEGEN_KIND_ENUM;
+      format = "BEJ_FORMAT_ENUM";
+      break;
+    default:
+      fprintf(out, "%sok = DecodeLeaf(out, in, format, length);\n", pad);
+      return true;
+  }
+
+  long index = CodegenAddItem(gen, kind, entry->offset, entry->child_count);
+  if (index < 0) return false;
+  const CodegenItem *item = &gen->items[index];
+  fprintf(out, "%sif (format == %s) {\n", pad, format);
+  if (kind == CODEGEN_KIND_ENUM) {
+    fprintf(out, "%s  ok = DecodeEnum(out, in, ", pad);
+    CodegenWriteName(out, item);
+    fprintf(out, ", sizeof(");
+    CodegenWriteName(out, item);
+    fprintf(out, ") / sizeof(GeneratedText));\n");
+  } else {
+    fprintf(out, "%s  ok = ", pad);
+    CodegenWriteName(out, item);
+    fprintf(out, "(out, in, %s);\n", indent);
+  }
+  fprintf(out, "%s} else {\n", pad);
+  fprintf(out, "%s  ok = DecodeLeaf(out, in, format, length);\n", pad);
+  fprintf(out, "%s}\n", pad);
+  return true;
+}
+
+/**
+ * @brief Emits the function decoding the member list of a SET.
+ */
+static bool CodegenEmitSet(Codegen *gen, const CodegenItem *item) {
+  FILE *out = gen->out;
+  size_t entry_count;
+  DictionaryEntry *entries = CodegenLoadItem(gen, item, &entry_count);
+  if (!entries) return false;
+
+  fprintf(out, "static bool ");
+  CodegenWriteName(out, item);
+  if (entry_count == 0) {
+    fprintf(out,
+            "(OutputStream *out, InputStream *in, int indent) {\n"
+            "  if (BejUnpackNNInt(in) > 0) {\n"
+            "    fprintf(stderr, \"Error: Dictionary entry not found\\n\");\n"
+            "    return false;\n"
+            "  }\n"
+            "  (void)indent;\n"
+            "  OutputStreamWrite(out, \"{}\", 2);\n"
+            "  return true;\n"
+            "}\n\n");
+    free(entries);
+    return true;
+  }
+  fprintf(out,
+          "(OutputStream *out, InputStream *in, int indent) {\n"
+          "  uint64_t count = BejUnpackNNInt(in);\n"
+          "  OutputStreamWrite(out, \"{\", 1);\n"
+          "  for (uint64_t i = 0; i < count; ++i) {\n"
+          "    if (i > 0) OutputStreamWrite(out, \",\", 1);\n"
+          "    if (in->pos >= in->size) continue;\n"
+          "    uint32_t seq = (uint32_t)(BejUnpackNNInt(in) >> 1);\n"
+          "    uint8_t format = (uint8_t)StreamReadInt(in, 1) >> 4;\n"
+          "    uint64_t length = BejUnpackNNInt(in);\n"
+          "    bool ok;\n"
+          "    switch (seq) {\n");
+
+  for (size_t i = 0; i < entry_count; ++i) {
+    const DictionaryEntry *entry = &entries[i];
+    bool duplicate = false;
+    for (size_t j = 0; j < i; ++j) {
+      duplicate |= entries[j].sequence_number == entry->sequence_number;
+    }
+    if (duplicate) continue;
+
+    fprintf(out, "      case %u:\n", entry->sequence_number);
+    fprintf(out, "        JsonWriteIndent(out, indent + 1);\n");
+    if (entry->name && entry->name[0] != '\0') {
+      fprintf(out, "        OutputStreamWrite(out, ");
+      CodegenWriteLiteral(out, "\\\"", entry->name, "\\\": ");
+      fprintf(out, ", %zu);\n", strlen(entry->name) + 4);
+    }
+    if (!CodegenEmitValue(gen, entry, "indent + 1", "        ")) {
+      free(entries);
+      return false;
+    }
+    fprintf(out, "        break;\n");
+  }
+
+  fprintf(out,
+          "      default:\n"
+          "        fprintf(stderr,\n"
+          "                \"Error: Dictionary entry not found for seq %%u\\n\",\n"
+          "                (unsigned int)seq);\n"
+          "        return false;\n"
+          "    }\n"
+          "    if (!ok) return false;\n"
+          "  }\n"
+          "  if (count > 0) JsonWriteIndent(out, indent);\n"
+          "  OutputStreamWrite(out, \"}\", 1);\n"
+          "  return true;\n"
+          "}\n\n");
+  free(entries);
+  return true;
+}
+
+/**
+ * @brief Emits the function decoding the members of an ARRAY.
+ */
+static bool CodegenEmitArray(Codegen *gen, const CodegenItem *item) {
+  FILE *out = gen->out;
+  size_t entry_count;
+  DictionaryEntry *entries = CodegenLoadItem(gen, item, &entry_count);
+  if (!entries) return false;
+
+  const DictionaryEntry *element = NULL;
+  for (size_t i = 0; i < entry_count && !element; ++i) {
+    if (entries[i].sequence_number == 0) element = &entries[i];
+  }
+
+  fprintf(out, "static bool ");
+  CodegenWriteName(out, item);
+  fprintf(out,
+          "(OutputStream *out, InputStream *in, int indent) {\n"
+          "  uint64_t count = BejUnpackNNInt(in);\n"
+          "  OutputStreamWrite(out, \"[\", 1);\n"
+          "  for (uint64_t i = 0; i < count; ++i) {\n"
+          "    if (i > 0) OutputStreamWrite(out, \",\", 1);\n"
+          "    JsonWriteIndent(out, indent + 1);\n"
+          "    if (in->pos >= in->size) continue;\n");
+  if (element) {
+    fprintf(out,
+            "    BejUnpackNNInt(in);\n"
+            "    uint8_t format = (uint8_t)StreamReadInt(in, 1) >> 4;\n"
+            "    uint64_t length = BejUnpackNNInt(in);\n"
+            "    bool ok;\n");
+    if (!CodegenEmitValue(gen, element, "indent + 1", "    ")) {
+      free(entries);
+      return false;
+    }
+    fprintf(out, "    if (!ok) return false;\n");
+  } else {
+    fprintf(out,
+            "    fprintf(stderr, \"Error: Dictionary entry not found for seq "
+            "0\\n\");\n"
+            "    return false;\n");
+  }
+  fprintf(out,
+          "  }\n"
+          "  if (count > 0) JsonWriteIndent(out, indent);\n"
+          "  OutputStreamWrite(out, \"]\", 1);\n"
+          "  return true;\n"
+          "}\n\n");
+  free(entries);
+  return true;
+}
+
+/**
+ * @brief Emits an enum name table indexed by enum value sequence number.
+ */
+static bool CodegenEmitEnum(Codegen *gen, const CodegenItem *item) {
+  FILE *out = gen->out;
+  size_t entry_count;
+  DictionaryEntry *entries = CodegenLoadItem(gen, item, &entry_count);
+  if (!entries) return false;
+
+  uint32_t table_size = 0;
+  for (size_t i = 0; i < entry_count; ++i) {
+    if (entries[i].sequence_number + 1u > table_size) {
+      table_size = entries[i].sequence_number + 1u;
+    }
+  }
+
+  // The first value with each sequence number wins, as in BejDecode().
+  const DictionaryEntry **by_seq =
+      calloc(table_size ? table_size : 1, sizeof(*by_seq));
+  if (!by_seq) {
+    free(entries);
+    return false;
+  }
+  for (size_t i = entry_count; i-- > 0;) {
+    by_seq[entries[i].sequence_number] = &entries[i];
+  }
+
+  fprintf(out, "static const GeneratedText ");
+  CodegenWriteName(out, item);
+  fprintf(out, "[%u] = {\n", table_size ? table_size : 1);
+  for (uint32_t seq = 0; seq < table_size; ++seq) {
+    const DictionaryEntry *value = by_seq[seq];
+    if (value) {
+      fprintf(out, "    {");
+      CodegenWriteLiteral(out, "\\\"", value->name, "\\\"");
+      fprintf(out, ", %zu},\n", strlen(value->name) + 2);
+    } else {
+      fprintf(out, "    {NULL, 0},\n");
+    }
+  }
+  if (table_size == 0) fprintf(out, "    {NULL, 0},\n");
+  fprintf(out, "};\n\n");
+  free(by_seq);
+  free(entries);
+  return true;
+}
+
+/**
+ * @brief Emits the helpers shared by every generated decoder.
+ */
+static void CodegenEmitPrelude(FILE *out, const char *dict_path,
+                               const char *header_name) {
+  fprintf(out,
+          "/* Generated by bej-codegen from %s. Do not edit. */\n"
+          "#include \"%s\"\n"
+          "\n"
+          "#include <inttypes.h>\n"
+          "#include <stdio.h>\n"
+          "\n"
+          "#include \"bej_types.h\"\n"
+          "#include \"decoder.h\"\n"
+          "#include \"json_writer.h\"\n"
+          "\n"
+          "typedef struct {\n"
+          "  const char *text;\n"
+          "  size_t len;\n"
+          "} GeneratedText;\n"
+          "\n"
+          "static bool DecodeLeaf(OutputStream *out, InputStream *in, "
+          "uint8_t format,\n"
+          "                       uint64_t length) {\n"
+          "  switch (format) {\n"
+          "    case BEJ_FORMAT_STRING: {\n"
+          "      const uint8_t *val = StreamReadBytes(in, length);\n"
+          "      if (!val) return false;\n"
+          "      JsonWriteString(out, (const char *)val, length > 0 ? "
+          "length - 1 : 0);\n"
+          "      return true;\n"
+          "    }\n"
+          "    case BEJ_FORMAT_INTEGER: {\n"
+          "      char buffer[32];\n"
+          "      int n = snprintf(buffer, sizeof(buffer), \"%%\" PRId64,\n"
+          "                       stream_read_sint(in, length));\n"
+          "      OutputStreamWrite(out, buffer, n);\n"
+          "      return true;\n"
+          "    }\n"
+          "    case BEJ_FORMAT_BOOLEAN:\n"
+          "      if (StreamReadInt(in, length) == 0x01)\n"
+          "        OutputStreamWrite(out, \"true\", 4);\n"
+          "      else\n"
+          "        OutputStreamWrite(out, \"false\", 5);\n"
+          "      return true;\n"
+          "    case BEJ_FORMAT_NULL:\n"
+          "      OutputStreamWrite(out, \"null\", 4);\n"
+          "      return true;\n"
+          "    default:\n"
+          "      StreamReadBytes(in, length);\n"
+          "      fprintf(stderr,\n"
+          "              \"Error: BEJ format %%02X does not match the "
+          "dictionary.\\n\",\n"
+          "              format);\n"
+          "      return false;\n"
+          "  }\n"
+          "}\n"
+          "\n"
+          "static bool DecodeEnum(OutputStream *out, InputStream *in,\n"
+          "                       const GeneratedText *names, size_t count) {\n"
+          "  uint64_t seq = BejUnpackNNInt(in);\n"
+          "  if (seq < count && names[seq].text) {\n"
+          "    OutputStreamWrite(out, names[seq].text, names[seq].len);\n"
+          "  } else {\n"
+          "    OutputStreamWrite(out, \"null\", 4);\n"
+          "  }\n"
+          "  return true;\n"
+          "}\n\n",
+          dict_path, header_name);
+}
+
+/**
+ * @brief Emits the header declaring the generated entry point.
+ */
+static bool CodegenWriteHeader(const char *path, const char *symbol) {
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    fprintf(stderr, "Error: cannot open %s\n", path);
+    return false;
+  }
+  fprintf(out,
+          "/* Generated by bej-codegen. Do not edit. */\n"
+          "#ifndef BEJ_DECODE_%s_GENERATED_H\n"
+          "#define BEJ_DECODE_%s_GENERATED_H\n"
+          "\n"
+          "#include <stdbool.h>\n"
+          "\n"
+          "#include \"stream_utils.h\"\n"
+          "\n"
+          "/**\n"
+          " * @brief Decodes a BEJ payload encoded against the %s schema.\n"
+          " *\n"
+          " * Produces the same output as BejDecode() with the dictionary "
+          "this file\n"
+          " * was generated from.\n"
+          " *\n"
+          " * @param out Pointer to the output stream for the decoded JSON.\n"
+          " * @param bej_input Pointer to the input stream containing the "
+          "BEJ data.\n"
+          " * @return true if decoding was successful, false otherwise.\n"
+          " */\n"
+          "bool BejDecode%s(OutputStream *out, InputStream *bej_input);\n"
+          "\n"
+          "#endif\n",
+          symbol, symbol, symbol, symbol);
+  bool ok = fclose(out) == 0;
+  return ok;
+}
+
+/**
+ * @brief Returns the last path component of `path`.
+ */
+static const char *BaseName(const char *path) {
+  const char *slash = strrchr(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+/**
+ * @brief Emits the whole decoder source for the dictionary in `gen`.
+ */
+static bool CodegenWriteSource(Codegen *gen, const char *dict_path,
+                               const char *symbol, const char *header_path) {
+  DictionaryEntry root[1];
+  size_t root_count;
+  if (!LoadDictionarySubsetIntoBuffer(gen->dict, gen->dict_size, 0, -1, root,
+                                      &root_count) ||
+      root_count != 1) {
+    fprintf(stderr, "Error: cannot read the dictionary root entry\n");
+    return false;
+  }
+  if (!CodegenCollect(gen, &root[0])) return false;
+
+  FILE *out = gen->out;
+  CodegenEmitPrelude(out, BaseName(dict_path), BaseName(header_path));
+
+  for (size_t i = 0; i < gen->item_count; ++i) {
+    const CodegenItem *item = &gen->items[i];
+    if (item->kind == CODEGEN_KIND_ENUM) {
+      if (!CodegenEmitEnum(gen, item)) return false;
+    }
+  }
+  for (size_t i = 0; i < gen->item_count; ++i) {
+    const CodegenItem *item = &gen->items[i];
+    if (item->kind == CODEGEN_KIND_ENUM) continue;
+    fprintf(out, "static bool ");
+    CodegenWriteName(out, item);
+    fprintf(out, "(OutputStream *out, InputStream *in, int indent);\n");
+  }
+  fprintf(out, "\n");
+
+  for (size_t i = 0; i < gen->item_count; ++i) {
+    CodegenItem item = gen->items[i];
+    bool ok = true;
+    if (item.kind == CODEGEN_KIND_SET) ok = CodegenEmitSet(gen, &item);
+    if (item.kind == CODEGEN_KIND_ARRAY) ok = CodegenEmitArray(gen, &item);
+    if (!ok) return false;
+  }
+
+  fprintf(out,
+          "bool BejDecode%s(OutputStream *out, InputStream *in) {\n"
+          "  if (!BejReadHeader(in)) return false;\n"
+          "  if (in->pos >= in->size) return true;\n"
+          "\n"
+          "  uint32_t seq = (uint32_t)(BejUnpackNNInt(in) >> 1);\n"
+          "  uint8_t format = (uint8_t)StreamReadInt(in, 1) >> 4;\n"
+          "  uint64_t length = BejUnpackNNInt(in);\n"
+          "  if (seq != %u) {\n"
+          "    fprintf(stderr, \"Error: Dictionary entry not found for seq "
+          "%%u\\n\",\n"
+          "            (unsigned int)seq);\n"
+          "    return false;\n"
+          "  }\n"
+          "\n"
+          "  bool ok;\n",
+          symbol, root[0].sequence_number);
+  if (!CodegenEmitValue(gen, &root[0], "0", "  ")) return false;
+  fprintf(out,
+          "  return ok && !out->overflow;\n"
+          "}\n");
+  return true;
+}
+
+/**
+ * @brief Main function of the decoder generator.
+ */
+int main(int argc, char **argv) {
+  if (argc < 5) {
+    fprintf(stderr,
+            "Usage: %s <schema_dict.bin> <symbol> <output.c> <output.h>\n",
+            argv[0]);
+    return 1;
+  }
+
+  const char *dict_path = argv[1];
+  const char *symbol = argv[2];
+  const char *source_path = argv[3];
+  const char *header_path = argv[4];
+
+  Codegen gen = {0};
+  gen.dict = ReadFile(dict_path, &gen.dict_size);
+  if (!gen.dict) return 2;
+
+  gen.out = fopen(source_path, "w");
+  if (!gen.out) {
+    fprintf(stderr, "Error: cannot open %s\n", source_path);
+    free((void *)gen.dict);
+    return 2;
+  }
+
+  bool ok = CodegenWriteSource(&gen, dict_path, symbol, header_path);
+  ok = (fclose(gen.out) == 0) && ok;
+  ok = ok && CodegenWriteHeader(header_path, symbol);
+
+  free(gen.items);
+  free((void *)gen.dict);
+
+  if (!ok) {
+    fprintf(stderr, "Code generation failed\n");
+    remove(source_path);
+    return 3;
+  }
+  printf("Generated %s and %s\n", source_path, header_path);
+  return 0;
+}
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decoder.h"
+#include "dictionary.h"
+#include "prune.h"
+#include "stream_utils.h"
+
+/**
+ * @file bej_dict_prune.c
+ * @brief Shrinks a schema dictionary to the entries a corpus of payloads
+ * uses.
+ *
+ * Every payload is scanned with a BejPruner, the pruned dictionary is built,
+ * and then the corpus is decoded again with both dictionaries, through
+ * BejDecoder and through BejDecode(). The pruned dictionary is only written
+ * when every payload produced identical JSON (or failed with both).
+ */
+
+/**
+ * @brief Reads a file into a dynamically allocated buffer.
+ *
+ * @param filename The name of the file to read.
+ * @param size Pointer to a variable to store the file size.
+ * @return A pointer to the allocated buffer, or NULL on failure.
+ */
+static uint8_t *ReadFile(const char *filename, size_t *size) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    fprintf(stderr, "Error: cannot open %s\n", filename);
+    return NULL;
+  }
+  if (fseek(f, 0, SEEK_END) != 0) {
+    fclose(f);
+    return NULL;
+  }
+  long sz = ftell(f);
+  if (sz < 0) {
+    fclose(f);
+    return NULL;
+  }
+  rewind(f);
+
+  *size = (size_t)sz;
+  uint8_t *buf = malloc(*size ? *size : 1);
+  if (!buf) {
+    fclose(f);
+    return NULL;
+  }
+  size_t read_bytes = fread(buf, 1, *size, f);
+  fclose(f);
+  if (read_bytes != *size) {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+/**
+ * @brief Writes a buffer to a file.
+ */
+static bool WriteFile(const char *filename, const uint8_t *data,
+                      size_t size) {
+  FILE *f = fopen(filename, "wb");
+  if (!f) {
+    fprintf(stderr, "Error: cannot open %s\n", filename);
+    return false;
+  }
+  bool ok = fwrite(data, 1, size, f) == size;
+  return (fclose(f) == 0) && ok;
+}
+
+/**
+ * @brief Decodes one payload with both dictionaries, along both decode
+ * paths, and checks that the results agree.
+ */
+static bool VerifyPayload(BejDecoder *original, BejDecoder *pruned,
+                          const uint8_t *original_dict, size_t original_size,
+                          const uint8_t *pruned_dict, size_t pruned_size,
+                          const uint8_t *payload, size_t size) {
+  const char *expected, *actual;
+  size_t expected_size, actual_size;
+  bool expected_ok = BejDecoderDecode(original, payload, size, &expected,
+                                      &expected_size);
+  bool actual_ok =
+      BejDecoderDecode(pruned, payload, size, &actual, &actual_size);
+  if (expected_ok != actual_ok ||
+      (expected_ok && (expected_size != actual_size ||
+                       memcmp(expected, actual, expected_size) != 0))) {
+    return false;
+  }
+
+  static OutputStream expected_out, actual_out;
+  OutputStreamInit(&expected_out);
+  OutputStreamInit(&actual_out);
+  InputStream expected_in = {payload, size, 0};
+  InputStream actual_in = {payload, size, 0};
+  InputStream expected_dict = {original_dict, original_size, 0};
+  InputStream actual_dict = {pruned_dict, pruned_size, 0};
+  expected_ok = BejDecode(&expected_out, &expected_in, &expected_dict);
+  actual_ok = BejDecode(&actual_out, &actual_in, &actual_dict);
+  return expected_ok == actual_ok &&
+         (!expected_ok || (expected_out.pos == actual_out.pos &&
+                           memcmp(expected_out.data, actual_out.data,
+                                  expected_out.pos) == 0));
+}
+
+/**
+ * @brief Decodes the whole corpus with both dictionaries.
+ *
+ * @return The number of payloads whose output differs, or -1 on error.
+ */
+static long VerifyCorpus(const uint8_t *original_dict, size_t original_size,
+                         const uint8_t *pruned_dict, size_t pruned_size,
+                         char **paths, int count) {
+  BejDecoder *original = BejDecoderCreate(original_dict, original_size);
+  BejDecoder *pruned = BejDecoderCreate(pruned_dict, pruned_size);
+  long mismatches = original && pruned ? 0 : -1;
+  for (int i = 0; mismatches >= 0 && i < count; ++i) {
+    size_t size;
+    uint8_t *payload = ReadFile(paths[i], &size);
+    if (!payload) {
+      mismatches = -1;
+      break;
+    }
+    if (!VerifyPayload(original, pruned, original_dict, original_size,
+                       pruned_dict, pruned_size, payload, size)) {
+      fprintf(stderr, "Error: %s decodes differently\n", paths[i]);
+      mismatches++;
+    }
+    free(payload);
+  }
+  BejDecoderDestroy(original);
+  BejDecoderDestroy(pruned);
+  return mismatches;
+}
+
+/**
+ * @brief Main function of the dictionary pruning tool.
+ */
+int main(int argc, char **argv) {
+  if (argc < 4) {
+    fprintf(stderr,
+            "Usage: %s <schema_dict.bin> <output_dict.bin> <payload.bin>...\n",
+            argv[0]);
+    return 1;
+  }
+
+  size_t dict_size;
+  uint8_t *dict = ReadFile(argv[1], &dict_size);
+  if (!dict) return 2;
+
+  BejPruner pruner;
+  if (!BejPruneInit(&pruner, dict, dict_size)) {
+    fprintf(stderr, "Error: cannot compile %s\n", argv[1]);
+    free(dict);
+    return 2;
+  }
+
+  bool ok = true;
+  for (int i = 3; ok && i < argc; ++i) {
+    size_t size;
+    uint8_t *payload = ReadFile(argv[i], &size);
+    ok = payload != NULL;
+    if (ok && !BejPruneAdd(&pruner, payload, size)) {
+      fprintf(stderr, "Warning: %s cannot be decoded\n", argv[i]);
+    }
+    free(payload);
+  }
+
+  uint8_t *pruned = NULL;
+  size_t pruned_size = 0, kept = 0;
+  ok = ok && BejPruneWrite(&pruner, &pruned, &pruned_size, &kept);
+  long mismatches =
+      ok ? VerifyCorpus(dict, dict_size, pruned, pruned_size, argv + 3,
+                        argc - 3)
+         : -1;
+
+  if (mismatches == 0) {
+    ok = WriteFile(argv[2], pruned, pruned_size);
+  }
+  if (ok && mismatches == 0) {
+    printf("Scanned %zu payloads (%zu could not be decoded)\n",
+           pruner.payloads, pruner.failed);
+    printf("Kept %zu of %zu entries\n", kept, pruner.dictionary.entry_count);
+    printf("Dictionary: %zu -> %zu bytes (%.1f%% smaller)\n", dict_size,
+           pruned_size,
+           dict_size ? 100.0 * ((double)dict_size - (double)pruned_size) /
+                           (double)dict_size
+                     : 0.0);
+    printf("Verified %zu payloads: identical JSON\n", pruner.payloads);
+  }
+
+  BejPruneRelease(&pruner);
+  free(pruned);
+  free(dict);
+
+  if (!ok || mismatches != 0) {
+    fprintf(stderr, "Pruning failed\n");
+    return 3;
+  }
+  return 0;
+}
@@ -0,0 +1,486 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "decoder.h"
+#include "parallel.h"
+#include "stream_utils.h"
+
+/**
+ * @file bej_replay.c
+ * @brief Replays a corpus of payloads against the decoder and reports
+ * latency percentiles, throughput and peak memory.
+ *
+ * The corpus is a text file with one `<dictionary.bin> <payload.bin>` pair
+ * per line; relative paths are resolved against the corpus file's directory
+ * and blank lines and lines starting with `#` are skipped. Each dictionary
+ * is loaded once however many payloads use it.
+ *
+ * Requests cycle through the corpus. In closed-loop mode (the default) every
+ * thread decodes its next request as soon as the previous one is done. With
+ * --rate, request i is due at start + i / rate whatever the progress of the
+ * threads, and its latency is measured from that time, so queueing behind
+ * slow requests shows up in the percentiles instead of lowering the load.
+ */
+
+#define REPLAY_DEFAULT_REQUESTS 100000
+
+/**
+ * @struct ReplayDictionary
+ * @brief A dictionary of the corpus and the path it was loaded from.
+ */
+typedef struct {
+  char *path;
+  uint8_t *data;
+  size_t size;
+} ReplayDictionary;
+
+/**
+ * @struct ReplayPayload
+ * @brief A payload of the corpus and the dictionary it is decoded with.
+ */
+typedef struct {
+  size_t dictionary;
+  uint8_t *data;
+  size_t size;
+} ReplayPayload;
+
+/**
+ * @struct ReplayCorpus
+ * @brief Every (dictionary, payload) pair of a corpus file.
+ */
+typedef struct {
+  ReplayDictionary *dictionaries;
+  size_t dictionary_count;
+  ReplayPayload *payloads;
+  size_t payload_count;
+} ReplayCorpus;
+
+/**
+ * @struct ReplayWorker
+ * @brief Decoding state owned by one thread.
+ *
+ * With the BejDecoder API the worker has one decoder per dictionary; with
+ * BejDecode() it has an output buffer.
+ */
+typedef struct {
+  BejDecoder **decoders;
+  OutputStream *out;
+} ReplayWorker;
+
+/**
+ * @struct ReplayRun
+ * @brief State shared by the threads of a replay.
+ */
+typedef struct {
+  const ReplayCorpus *corpus;
+  ReplayWorker *workers;
+  double rate;
+  size_t requests;
+  atomic_size_t next_request;
+  atomic_size_t failed;
+  struct timespec start;
+  uint64_t *latency_ns;
+  uint64_t *service_ns;
+} ReplayRun;
+
+/**
+ * @brief Reads a file into a dynamically allocated buffer.
+ *
+ * @param filename The name of the file to read.
+ * @param size Pointer to a variable to store the file size.
+ * @return A pointer to the allocated buffer, or NULL on failure.
+ */
+static uint8_t *ReadFile(const char *filename, size_t *size) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    fprintf(stderr, "Error: cannot open %s\n", filename);
+    return NULL;
+  }
+  if (fseek(f, 0, SEEK_END) != 0) {
+    fclose(f);
+    return NULL;
+  }
+  long sz = ftell(f);
+  if (sz < 0) {
+    fclose(f);
+    return NULL;
+  }
+  rewind(f);
+
+  *size = (size_t)sz;
+  uint8_t *buf = malloc(*size ? *size : 1);
+  if (!buf) {
+    fclose(f);
+    return NULL;
+  }
+  size_t read_bytes = fread(buf, 1, *size, f);
+  fclose(f);
+  if (read_bytes != *size) {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+/**
+ * @brief Returns `path` resolved against the directory of `base`.
+ */
+static char *ReplayResolvePath(const char *base, const char *path) {
+  const char *slash = strrchr(base, '/');
+  size_t dir_len = (path[0] == '/' || !slash) ? 0 : (size_t)(slash - base) + 1;
+  size_t size = dir_len + strlen(path) + 1;
+  char *resolved = malloc(size);
+  if (resolved) snprintf(resolved, size, "%.*s%s", (int)dir_len, base, path);
+  return resolved;
+}
+
+/**
+ * @brief Returns the index of the dictionary loaded from `path`, loading it
+ * if it is new, or -1 on error.
+ */
+static long ReplayAddDictionary(ReplayCorpus *corpus, char *path) {
+  for (size_t i = 0; i < corpus->dictionary_count; ++i) {
+    if (strcmp(corpus->dictionaries[i].path, path) == 0) {
+      free(path);
+      return (long)i;
+    }
+  }
+  ReplayDictionary *grown =
+      realloc(corpus->dictionaries,
+              (corpus->dictionary_count + 1) * sizeof(*grown));
+  if (!grown) {
+    free(path);
+    return -1;
+  }
+  corpus->dictionaries = grown;
+  ReplayDictionary *dict = &grown[corpus->dictionary_count];
+  dict->path = path;
+  dict->data = ReadFile(path, &dict->size);
+  if (!dict->data) {
+    free(path);
+    return -1;
+  }
+  return (long)corpus->dictionary_count++;
+}
+
+/**
+ * @brief Frees everything a corpus owns.
+ */
+static void ReplayCorpusRelease(ReplayCorpus *corpus) {
+  for (size_t i = 0; i < corpus->dictionary_count; ++i) {
+    free(corpus->dictionaries[i].path);
+    free(corpus->dictionaries[i].data);
+  }
+  for (size_t i = 0; i < corpus->payload_count; ++i) {
+    free(corpus->payloads[i].data);
+  }
+  free(corpus->dictionaries);
+  free(corpus->payloads);
+  memset(corpus, 0, sizeof(*corpus));
+}
+
+/**
+ * @brief Loads every pair listed in a corpus file.
+ *
+ * @return true on success, false if a line is malformed or a file cannot
+ * be read.
+ */
+static bool ReplayCorpusLoad(ReplayCorpus *corpus, const char *filename) {
+  memset(corpus, 0, sizeof(*corpus));
+  FILE *f = fopen(filename, "r");
+  if (!f) {
+    fprintf(stderr, "Error: cannot open %s\n", filename);
+    return false;
+  }
+
+  char line[4096];
+  bool ok = true;
+  for (int number = 1; ok && fgets(line, sizeof(line), f); ++number) {
+    char dict_path[2048], payload_path[2048];
+    int fields = sscanf(line, "%2047s %2047s", dict_path, payload_path);
+    if (fields <= 0 || dict_path[0] == '#') continue;
+    if (fields != 2) {
+      fprintf(stderr, "Error: %s:%d: expected <dictionary> <payload>\n",
+              filename, number);
+      ok = false;
+      break;
+    }
+
+    char *path = ReplayResolvePath(filename, dict_path);
+    long dictionary = path ? ReplayAddDictionary(corpus, path) : -1;
+    ReplayPayload *grown =
+        realloc(corpus->payloads, (corpus->payload_count + 1) * sizeof(*grown));
+    if (grown) corpus->payloads = grown;
+    if (dictionary < 0 || !grown) {
+      ok = false;
+      break;
+    }
+    ReplayPayload *payload = &grown[corpus->payload_count];
+    payload->dictionary = (size_t)dictionary;
+    path = ReplayResolvePath(filename, payload_path);
+    payload->data = path ? ReadFile(path, &payload->size) : NULL;
+    free(path);
+    ok = payload->data != NULL;
+    if (ok) corpus->payload_count++;
+  }
+  fclose(f);
+
+  if (ok && corpus->payload_count == 0) {
+    fprintf(stderr, "Error: %s lists no payloads\n", filename);
+    ok = false;
+  }
+  if (!ok) ReplayCorpusRelease(corpus);
+  return ok;
+}
+
+/**
+ * @brief Returns the nanoseconds from `from` to `to`.
+ */
+static uint64_t ReplayElapsedNs(const struct timespec *from,
+                                const struct timespec *to) {
+  int64_t ns = (int64_t)(to->tv_sec - from->tv_sec) * 1000000000 +
+               (to->tv_nsec - from->tv_nsec);
+  return ns > 0 ? (uint64_t)ns : 0;
+}
+
+/**
+ * @brief Decodes one payload with the worker's state.
+ */
+static bool ReplayDecode(const ReplayCorpus *corpus, ReplayWorker *worker,
+                         const ReplayPayload *payload) {
+  if (worker->decoders) {
+    const char *json;
+    size_t json_size;
+    return BejDecoderDecode(worker->decoders[payload->dictionary],
+                            payload->data, payload->size, &json, &json_size);
+  }
+  const ReplayDictionary *dict = &corpus->dictionaries[payload->dictionary];
+  InputStream payload_is = {payload->data, payload->size, 0};
+  InputStream dict_is = {dict->data, dict->size, 0};
+  OutputStreamInit(worker->out);
+  return BejDecode(worker->out, &payload_is, &dict_is);
+}
+
+/**
+ * @brief Body of one replay thread: takes requests until all are issued.
+ */
+static void ReplayThread(void *ctx, size_t task, size_t thread) {
+  (void)thread;
+  ReplayRun *run = ctx;
+  ReplayWorker *worker = &run->workers[task];
+  for (;;) {
+    size_t request = atomic_fetch_add(&run->next_request, 1);
+    if (request >= run->requests) break;
+
+    struct timespec due = run->start;
+    if (run->rate > 0) {
+      // Open loop: wait for the request's slot in the schedule.
+      uint64_t offset = (uint64_t)((double)request * 1e9 / run->rate);
+      due.tv_sec += (time_t)(offset / 1000000000);
+      due.tv_nsec += (long)(offset % 1000000000);
+      if (due.tv_nsec >= 1000000000) {
+        due.tv_sec++;
+        due.tv_nsec -= 1000000000;
+      }
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) ==
+             EINTR) {
+      }
+    }
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    const ReplayPayload *payload =
+        &run->corpus->payloads[request % run->corpus->payload_count];
+    if (!ReplayDecode(run->corpus, worker, payload)) {
+      atomic_fetch_add(&run->failed, 1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    run->service_ns[request] = ReplayElapsedNs(&begin, &end);
+    run->latency_ns[request] =
+        run->rate > 0 ? ReplayElapsedNs(&due, &end) : run->service_ns[request];
+  }
+}
+
+static int CompareU64(const void *a, const void *b) {
+  uint64_t lhs = *(const uint64_t *)a;
+  uint64_t rhs = *(const uint64_t *)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+/**
+ * @brief Returns the nearest-rank percentile `p` (0-100) of sorted values.
+ */
+static uint64_t ReplayPercentile(const uint64_t *sorted, size_t count,
+                                 double p) {
+  size_t rank = (size_t)((p / 100.0) * (double)count + 0.999999);
+  if (rank == 0) rank = 1;
+  if (rank > count) rank = count;
+  return sorted[rank - 1];
+}
+
+/**
+ * @brief Sorts `values` and prints their percentiles in microseconds.
+ */
+static void ReplayPrintPercentiles(const char *label, uint64_t *values,
+                                   size_t count) {
+  qsort(values, count, sizeof(*values), CompareU64);
+  printf("%s (us): p50 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n", label,
+         (double)ReplayPercentile(values, count, 50.0) / 1e3,
+         (double)ReplayPercentile(values, count, 99.0) / 1e3,
+         (double)ReplayPercentile(values, count, 99.9) / 1e3,
+         (double)values[count - 1] / 1e3);
+}
+
+/**
+ * @brief Creates the per-thread decoding state.
+ */
+static bool ReplayWorkersCreate(ReplayWorker *workers, size_t count,
+                                const ReplayCorpus *corpus, bool use_decoder) {
+  for (size_t i = 0; i < count; ++i) {
+    if (!use_decoder) {
+      workers[i].out = malloc(sizeof(*workers[i].out));
+      if (!workers[i].out) return false;
+      continue;
+    }
+    workers[i].decoders =
+        calloc(corpus->dictionary_count, sizeof(*workers[i].decoders));
+    if (!workers[i].decoders) return false;
+    for (size_t d = 0; d < corpus->dictionary_count; ++d) {
+      workers[i].decoders[d] = BejDecoderCreate(corpus->dictionaries[d].data,
+                                                corpus->dictionaries[d].size);
+      if (!workers[i].decoders[d]) {
+        fprintf(stderr, "Error: cannot compile %s\n",
+                corpus->dictionaries[d].path);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Frees the per-thread decoding state.
+ */
+static void ReplayWorkersDestroy(ReplayWorker *workers, size_t count,
+                                 const ReplayCorpus *corpus) {
+  for (size_t i = 0; workers && i < count; ++i) {
+    for (size_t d = 0; workers[i].decoders && d < corpus->dictionary_count;
+         ++d) {
+      BejDecoderDestroy(workers[i].decoders[d]);
+    }
+    free(workers[i].decoders);
+    free(workers[i].out);
+  }
+  free(workers);
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [-j threads] [-n requests] [--rate requests_per_s] "
+          "[--api stream|decoder] <corpus.txt>\n",
+          program);
+}
+
+/**
+ * @brief Main function of the replay tool.
+ */
+int main(int argc, char **argv) {
+  size_t threads = 1;
+  size_t requests = REPLAY_DEFAULT_REQUESTS;
+  double rate = 0;
+  bool use_decoder = false;
+  int arg = 1;
+  for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+    const char *value = argv[arg + 1];
+    if (strcmp(argv[arg], "-j") == 0) {
+      threads = (size_t)strtoul(value, NULL, 10);
+    } else if (strcmp(argv[arg], "-n") == 0) {
+      requests = (size_t)strtoull(value, NULL, 10);
+    } else if (strcmp(argv[arg], "--rate") == 0) {
+      rate = strtod(value, NULL);
+    } else if (strcmp(argv[arg], "--api") == 0 &&
+               (strcmp(value, "stream") == 0 ||
+                strcmp(value, "decoder") == 0)) {
+      use_decoder = strcmp(value, "decoder") == 0;
+    } else {
+      fprintf(stderr, "Error: bad option %s %s\n", argv[arg], value);
+      return 1;
+    }
+  }
+  if (argc - arg != 1 || threads == 0 || requests == 0 || rate < 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  ReplayCorpus corpus;
+  if (!ReplayCorpusLoad(&corpus, argv[arg])) return 2;
+
+  ReplayRun run;
+  memset(&run, 0, sizeof(run));
+  run.corpus = &corpus;
+  run.rate = rate;
+  run.requests = requests;
+  atomic_init(&run.next_request, 0);
+  atomic_init(&run.failed, 0);
+  run.latency_ns = malloc(requests * sizeof(*run.latency_ns));
+  run.service_ns = malloc(requests * sizeof(*run.service_ns));
+  run.workers = calloc(threads, sizeof(*run.workers));
+  int rc = run.latency_ns && run.service_ns && run.workers &&
+                   ReplayWorkersCreate(run.workers, threads, &corpus,
+                                       use_decoder)
+               ? 0
+               : 2;
+
+  struct timespec end;
+  if (rc == 0) {
+    clock_gettime(CLOCK_MONOTONIC, &run.start);
+    // One task per thread; each task keeps taking requests until none are
+    // left.
+    if (!ParallelFor(threads, threads, ReplayThread, &run)) rc = 2;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+  }
+
+  if (rc == 0) {
+    double seconds = (double)ReplayElapsedNs(&run.start, &end) / 1e9;
+    size_t bytes = 0;
+    for (size_t i = 0; i < requests; ++i) {
+      bytes += corpus.payloads[i % corpus.payload_count].size;
+    }
+    size_t failed = atomic_load(&run.failed);
+    printf("Replayed %zu requests (%zu failed) over %zu payloads and %zu "
+           "dictionaries\n",
+           requests, failed, corpus.payload_count, corpus.dictionary_count);
+    if (rate > 0) {
+      printf("Mode: open loop at %.0f req/s, %zu threads, %s API\n", rate,
+             threads, use_decoder ? "BejDecoder" : "BejDecode");
+    } else {
+      printf("Mode: closed loop, %zu threads, %s API\n", threads,
+             use_decoder ? "BejDecoder" : "BejDecode");
+    }
+    printf("Throughput: %.0f req/s, %.1f MB/s in %.3f s\n",
+           seconds > 0 ? (double)requests / seconds : 0.0,
+           seconds > 0 ? (double)bytes / seconds / 1e6 : 0.0, seconds);
+    ReplayPrintPercentiles("Latency", run.latency_ns, requests);
+    if (rate > 0) {
+      // Latency includes waiting for a thread; service time does not.
+      ReplayPrintPercentiles("Service time", run.service_ns, requests);
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+      printf("Peak RSS: %.1f MiB\n", (double)usage.ru_maxrss / 1024.0);
+    }
+    if (failed > 0) rc = 3;
+  }
+
+  ReplayWorkersDestroy(run.workers, threads, &corpus);
+  free(run.latency_ns);
+  free(run.service_ns);
+  ReplayCorpusRelease(&corpus);
+  return rc;
+}